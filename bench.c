@@ -0,0 +1,597 @@
+#define _DEFAULT_SOURCE
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+/* make bench-scalar builds it without CSVN_SIMD */
+#ifndef BENCH_SCALAR
+#define CSVN_SIMD
+#define SCANNER "simd"
+#else
+#define SCANNER "scalar"
+#endif
+#define CSVN_INDEX
+#define CSVN_PARALLEL
+#define CSVN_CALLBACKS
+#define CSVN_MMAP
+#include "csvn.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define cycles() ((double)__rdtsc())
+#else
+#define cycles() 0.0
+#endif
+
+/* corpora are parsed in chunks of whole rows, so counts never overflow an int */
+#define CHUNK (16 * 1024 * 1024)
+#define WINDOW (1024 * 1024)
+#define MIN_TIME 0.25
+#define MAX_RUNS 1000
+
+struct corpus {
+
+	const char *name;
+
+	const char *text;
+
+	size_t textlen;
+
+	size_t *chunks;
+
+	size_t num_chunks;
+
+	struct csvn_dialect dialect;
+
+	/* the generated text, or NULL for a mapped file */
+	char *buffer;
+
+	struct csvn_mmap map;
+
+};
+
+struct result {
+
+	double seconds;
+
+	double cycles;
+
+	double fields;
+
+};
+
+static unsigned long seed = 1;
+
+static int threads = 4;
+
+static int json = 0;
+
+static struct csv_t *pool;
+
+static size_t *offsets;
+
+static size_t num_off = CHUNK + 4096;
+
+static unsigned long next_random(void);
+static double now(void);
+static size_t parse_size(const char *arg);
+static size_t make_row(char *row, int shape);
+static int make_corpus(struct corpus *c, const char *name, int shape, size_t size);
+static int load_corpus(struct corpus *c, const char *path);
+static void free_corpus(struct corpus *c);
+static int on_field(void *sink, csvn_off start, csvn_off len, enum csv_tok kind);
+static double run_count(struct corpus *c, const char *text, size_t len);
+static double run_tokens(struct corpus *c, const char *text, size_t len);
+static double run_index(struct corpus *c, const char *text, size_t len);
+static double run_parallel(struct corpus *c, const char *text, size_t len);
+static double run_callbacks(struct corpus *c, const char *text, size_t len);
+static int measure(struct corpus *c, double (*run)(struct corpus *, const char *, size_t),
+		   struct result *best);
+static void report(struct corpus *c, const char *mode, struct result *r);
+static int bench_corpus(struct corpus *c);
+
+static const char *modes[] = {"count", "tokens", "index", "parallel", "callbacks"};
+
+static double (*const runs[])(struct corpus *, const char *, size_t) = {
+	run_count, run_tokens, run_index, run_parallel, run_callbacks
+};
+
+static const char *words[] = {
+	"alpha", "bravo", "charlie", "delta", "echo", "foxtrot", "golf", "hotel"
+};
+
+static unsigned long
+next_random(void)
+{
+
+	seed = seed * 1103515245UL + 12345UL;
+
+	return (seed >> 16) & 0x7fff;
+
+}
+
+static double
+now(void)
+{
+
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+
+}
+
+static size_t
+parse_size(const char *arg)
+{
+
+	char *end;
+	size_t size = (size_t)strtoul(arg, &end, 10);
+
+	switch (*end) {
+	case 'K': case 'k': return size << 10;
+	case 'M': case 'm': return size << 20;
+	case 'G': case 'g': return size << 30;
+	default: return size;
+	}
+
+}
+
+/* writes a single row of the shape into row (never more than 2048 characters) */
+static size_t
+make_row(char *row, int shape)
+{
+
+	size_t len = 0;
+	int i, n;
+
+	switch (shape) {
+
+	/* narrow numeric */
+	case 0:
+	case 4:
+		for (i = 0; i < 8; i++) {
+			len += sprintf(row + len, (i % 2) ? "%lu.%02lu," : "%lu,",
+				       next_random(), next_random() % 100);
+		}
+		break;
+
+	/* wide text */
+	case 1:
+		for (i = 0; i < 64; i++) {
+			len += sprintf(row + len, "%s %s,", words[next_random() % 8],
+				       words[next_random() % 8]);
+		}
+		break;
+
+	/* quote heavy */
+	case 2:
+		for (i = 0; i < 12; i++) {
+			n = (int)(next_random() % 3);
+			len += sprintf(row + len, "\"%s, %s%s\",", words[next_random() % 8],
+				       words[next_random() % 8], (n == 0) ? " \"\"quoted\"\"" : "");
+		}
+		break;
+
+	/* multi-line quoted fields */
+	case 3:
+		for (i = 0; i < 6; i++) {
+			len += sprintf(row + len, (i % 2) ? "\"%s\n%s\n%s\"," : "%s,",
+				       words[next_random() % 8], words[next_random() % 8],
+				       words[next_random() % 8]);
+		}
+		break;
+
+	}
+
+	/* the last delimiter becomes the end of the row */
+	len--;
+	if (shape == 4) {
+		row[len++] = '\r';
+	}
+	row[len++] = '\n';
+
+	return len;
+
+}
+
+static int
+make_corpus(struct corpus *c, const char *name, int shape, size_t size)
+{
+
+	char row[2048];
+	size_t len, last = 0;
+
+	c->name = name;
+	c->buffer = (char *)malloc(size + sizeof(row));
+	c->chunks = (size_t *)malloc((size / CHUNK + 2) * sizeof(size_t));
+	c->text = c->buffer;
+	c->textlen = 0;
+	c->num_chunks = 0;
+	if (c->buffer == NULL || c->chunks == NULL) {
+		free(c->buffer);
+		free(c->chunks);
+		return -1;
+	}
+
+	csvn_dialect_init(&c->dialect);
+	if (shape == 4) {
+		c->dialect.flags |= CSVN_DIALECT_CRLF;
+	}
+
+	seed = 1;
+	while (c->textlen < size) {
+
+		len = make_row(row, shape);
+		memcpy(c->buffer + c->textlen, row, len);
+		c->textlen += len;
+
+		if (c->textlen - last >= CHUNK) {
+			c->chunks[c->num_chunks++] = c->textlen;
+			last = c->textlen;
+		}
+
+	}
+
+	if (last < c->textlen) {
+		c->chunks[c->num_chunks++] = c->textlen;
+	}
+
+	return 0;
+
+}
+
+/*
+	maps the file at path, which is cut into chunks at the first newline 
+	outside quotes (by their parity, as in RFC 4180) after every CHUNK 
+	characters
+*/
+static int
+load_corpus(struct corpus *c, const char *path)
+{
+
+	size_t i, last = 0, longest = 0;
+	int quoted = 0;
+
+	if (csvn_open_mmap(path, &c->map) != 0) {
+		return -1;
+	}
+
+	c->name = path;
+	c->buffer = NULL;
+	c->text = c->map.text;
+	c->textlen = c->map.textlen;
+	c->chunks = (size_t *)malloc((c->textlen / CHUNK + 2) * sizeof(size_t));
+	c->num_chunks = 0;
+	csvn_dialect_init(&c->dialect);
+	if (c->chunks == NULL) {
+		csvn_close_mmap(&c->map);
+		return -1;
+	}
+
+	for (i = 0; i < c->textlen; i++) {
+
+		if (c->text[i] == '\"') {
+			quoted = !quoted;
+		} else if (c->text[i] == '\n' && !quoted && i + 1 - last >= CHUNK) {
+			c->chunks[c->num_chunks++] = i + 1;
+			longest = (i + 1 - last > longest) ? i + 1 - last : longest;
+			last = i + 1;
+		}
+
+	}
+
+	if (last < c->textlen) {
+		c->chunks[c->num_chunks++] = c->textlen;
+		longest = (c->textlen - last > longest) ? c->textlen - last : longest;
+	}
+
+	/* a chunk may hold more structural characters than a generated one */
+	if (longest + 1 > num_off) {
+		free(offsets);
+		num_off = longest + 1;
+		offsets = (size_t *)malloc(num_off * sizeof(size_t));
+		if (offsets == NULL) {
+			free_corpus(c);
+			return -1;
+		}
+	}
+
+	return 0;
+
+}
+
+static void
+free_corpus(struct corpus *c)
+{
+
+	if (c->buffer != NULL) {
+		free(c->buffer);
+	} else {
+		csvn_close_mmap(&c->map);
+	}
+	free(c->chunks);
+
+}
+
+static int
+on_field(void *sink, csvn_off start, csvn_off len, enum csv_tok kind)
+{
+
+	(void)start;
+	(void)len;
+	(void)kind;
+
+	(*(double *)sink)++;
+
+	return 0;
+
+}
+
+/* fields are counted, nothing is stored */
+static double
+run_count(struct corpus *c, const char *text, size_t len)
+{
+
+	struct csv_p parser;
+
+	csvn_init(&parser);
+	parser.dialect = &c->dialect;
+
+	return (double)csvn_parse(text, len, &parser, NULL, 0);
+
+}
+
+/* fields are stored into a token pool, a window of the text at a time */
+static double
+run_tokens(struct corpus *c, const char *text, size_t len)
+{
+
+	struct csv_p parser;
+	double fields = 0;
+	size_t end = 0;
+	int res;
+
+	csvn_init(&parser);
+	parser.dialect = &c->dialect;
+
+	while (end < len) {
+
+		end = (len - end > WINDOW) ? end + WINDOW : len;
+		res = csvn_parse_stream(text, end, &parser, pool, WINDOW + 4096, end == len);
+		if (res < 0) {
+			return -1;
+		}
+
+		fields += res;
+		parser.toknext = 0;
+
+	}
+
+	return fields;
+
+}
+
+static double
+run_index(struct corpus *c, const char *text, size_t len)
+{
+
+	struct csv_p parser;
+	struct csvn_idx idx;
+
+	csvn_init(&parser);
+	parser.dialect = &c->dialect;
+	csvn_index_init(&idx);
+	idx.dialect = &c->dialect;
+
+	if (csvn_index(text, len, &idx, offsets, num_off) < 0) {
+		return -1;
+	}
+
+	return (double)csvn_parse_index(text, len, &idx, offsets, &parser, NULL, 0);
+
+}
+
+static double
+run_parallel(struct corpus *c, const char *text, size_t len)
+{
+
+	struct csv_p parser;
+
+	csvn_init(&parser);
+	parser.dialect = &c->dialect;
+
+	return (double)csvn_parse_parallel(text, len, threads, &parser, NULL, 0);
+
+}
+
+static double
+run_callbacks(struct corpus *c, const char *text, size_t len)
+{
+
+	struct csv_p parser;
+	double fields = 0;
+
+	csvn_init(&parser);
+	parser.dialect = &c->dialect;
+	parser.on_field = on_field;
+	parser.sink = &fields;
+
+	if (csvn_parse(text, len, &parser, NULL, 0) < 0) {
+		return -1;
+	}
+
+	return fields;
+
+}
+
+/* runs the mode over the whole corpus until MIN_TIME has passed, keeping the fastest run */
+static int
+measure(struct corpus *c, double (*run)(struct corpus *, const char *, size_t),
+	struct result *best)
+{
+
+	double start, spent = 0, fields, t, tc;
+	size_t i, begin;
+	int runs;
+
+	best->seconds = 0;
+
+	for (runs = 0; runs < MAX_RUNS && (runs == 0 || spent < MIN_TIME); runs++) {
+
+		fields = 0;
+		start = now();
+		tc = cycles();
+
+		for (i = 0, begin = 0; i < c->num_chunks; begin = c->chunks[i++]) {
+
+			t = run(c, c->text + begin, c->chunks[i] - begin);
+			if (t < 0) {
+				return -1;
+			}
+			fields += t;
+
+		}
+
+		tc = cycles() - tc;
+		t = now() - start;
+		spent += t;
+
+		if (runs == 0 || t < best->seconds) {
+			best->seconds = t;
+			best->cycles = tc;
+			best->fields = fields;
+		}
+
+	}
+
+	return 0;
+
+}
+
+static void
+report(struct corpus *c, const char *mode, struct result *r)
+{
+
+	double gbps = (double)c->textlen / r->seconds / 1e9;
+	double fps = r->fields / r->seconds;
+	double fpc = (r->cycles > 0) ? r->fields / r->cycles : 0;
+
+	if (json) {
+		printf("{\"corpus\":\"%s\",\"size\":%lu,\"mode\":\"%s\",\"scanner\":\"%s\","
+		       "\"threads\":%d,\"fields\":%.0f,\"seconds\":%.6f,\"gb_per_s\":%.4f,"
+		       "\"fields_per_s\":%.0f,\"tokens_per_cycle\":%.5f}\n",
+		       c->name, (unsigned long)c->textlen, mode, SCANNER,
+		       (mode[0] == 'p') ? threads : 1,
+		       r->fields, r->seconds, gbps, fps, fpc);
+	} else {
+		printf("%-10s %12lu  %-10s %8.3f GB/s %10.2f Mfields/s %8.5f tokens/cycle\n",
+		       c->name, (unsigned long)c->textlen, mode, gbps, fps / 1e6, fpc);
+	}
+
+}
+
+/* runs and reports every mode over the corpus */
+static int
+bench_corpus(struct corpus *c)
+{
+
+	struct result r;
+	int k;
+
+	for (k = 0; k < 5; k++) {
+		if (measure(c, runs[k], &r) != 0) {
+			fprintf(stderr, "%s failed on %s\n", modes[k], c->name);
+			return -1;
+		}
+		report(c, modes[k], &r);
+	}
+
+	return 0;
+
+}
+
+int
+main(int argc, char **argv)
+{
+
+	static const char *names[] = {"numeric", "wide", "quoted", "multiline", "crlf"};
+	const char *files[16];
+	size_t sizes[16];
+	int num_sizes = 0, num_files = 0;
+	struct corpus c;
+	int i, j;
+
+	for (i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-j") == 0) {
+			json = 1;
+		} else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+			threads = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "-f") == 0 && i + 1 < argc) {
+			if (num_files < 16) {
+				files[num_files++] = argv[i + 1];
+			}
+			i++;
+		} else if (num_sizes < 16) {
+			sizes[num_sizes++] = parse_size(argv[i]);
+		}
+	}
+
+	/* files alone are not joined by the generated corpora */
+	if (num_sizes == 0 && num_files == 0) {
+		sizes[num_sizes++] = 1 << 10;
+		sizes[num_sizes++] = 1 << 20;
+		sizes[num_sizes++] = 64 << 20;
+	}
+
+	pool = (struct csv_t *)malloc((WINDOW + 4096) * sizeof(struct csv_t));
+	offsets = (size_t *)malloc(num_off * sizeof(size_t));
+	if (pool == NULL || offsets == NULL) {
+		fprintf(stderr, "not enough memory\n");
+		return 1;
+	}
+
+	if (!json) {
+		printf("%s scanner\n", SCANNER);
+	}
+
+	for (i = 0; i < num_files; i++) {
+
+		if (load_corpus(&c, files[i]) != 0) {
+			fprintf(stderr, "can not map %s\n", files[i]);
+			return 1;
+		}
+
+		if (bench_corpus(&c) != 0) {
+			return 1;
+		}
+
+		free_corpus(&c);
+
+	}
+
+	for (i = 0; i < num_sizes; i++) {
+		for (j = 0; j < 5; j++) {
+
+			if (make_corpus(&c, names[j], j, sizes[i]) != 0) {
+				fprintf(stderr, "not enough memory for %lu bytes\n", (unsigned long)sizes[i]);
+				return 1;
+			}
+
+			if (bench_corpus(&c) != 0) {
+				return 1;
+			}
+
+			free_corpus(&c);
+
+		}
+	}
+
+	free(pool);
+	free(offsets);
+
+	return 0;
+
+}
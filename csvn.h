@@ -26,6 +26,7 @@ OTHER DEALINGS IN THE SOFTWARE.
 #define CSVN_H
 
 #include <stddef.h>
+#include <string.h>
 
 #define CSVN_NEWLINE '\n'
 
@@ -38,6 +39,443 @@ OTHER DEALINGS IN THE SOFTWARE.
 */
 #define CSVN_DELIM ','
 
+/*
+	Defining CSVN_LENGTH_ONLY makes textlen authoritative: '\0' is 
+	treated as any other character instead of ending the text, so that 
+	the parser loops are left by a single test against textlen.
+*/
+#ifdef CSVN_LENGTH_ONLY
+#define CSVN_OR_NUL(c) (c) /* the scanners look for c twice instead */
+#else
+#define CSVN_OR_NUL(c) '\0'
+#endif
+
+/*
+	Defining CSVN_PADDING (as a number of at least 64) promises that 
+	that many characters past textlen can be read, whatever their value. 
+	The vectorized scanners then go over the end of the text in whole 
+	vectors instead of finishing byte by byte, and so does the index.
+*/
+#ifdef CSVN_PADDING
+#if CSVN_PADDING < 64
+#error "CSVN_PADDING has to be at least 64"
+#endif
+#define CSVN_SCAN_FITS(pos, width, textlen) ((pos) < (textlen))
+#else
+#define CSVN_SCAN_FITS(pos, width, textlen) ((pos) + (width) <= (textlen))
+#endif
+
+/*
+	The options above (and CSVN_STRICT, CSVN_CONSIDER_NL, 
+	CSVN_SKIP_WHITESPACE, CSVN_NO_EMPTY_FIELD, CSVN_IGNORE_EMPTY_FIELD 
+	and CSVN_CRLF) make up the dialect used by parsers which have not been given one 
+	at runtime (refer to csvn_dialect).
+*/
+#ifdef CSVN_STRICT
+#define CSVN_DEFAULT_STRICT CSVN_DIALECT_STRICT
+#else
+#define CSVN_DEFAULT_STRICT 0
+#endif
+#ifdef CSVN_CONSIDER_NL
+#define CSVN_DEFAULT_CONSIDER_NL CSVN_DIALECT_CONSIDER_NL
+#else
+#define CSVN_DEFAULT_CONSIDER_NL 0
+#endif
+#ifdef CSVN_SKIP_WHITESPACE
+#define CSVN_DEFAULT_SKIP_WHITESPACE CSVN_DIALECT_SKIP_WHITESPACE
+#else
+#define CSVN_DEFAULT_SKIP_WHITESPACE 0
+#endif
+#if defined(CSVN_NO_EMPTY_FIELD)
+#define CSVN_DEFAULT_EMPTY_FIELD CSVN_DIALECT_NO_EMPTY_FIELD
+#elif defined(CSVN_IGNORE_EMPTY_FIELD)
+#define CSVN_DEFAULT_EMPTY_FIELD CSVN_DIALECT_IGNORE_EMPTY_FIELD
+#else
+#define CSVN_DEFAULT_EMPTY_FIELD 0
+#endif
+#ifdef CSVN_CRLF
+#define CSVN_DEFAULT_CRLF CSVN_DIALECT_CRLF
+#else
+#define CSVN_DEFAULT_CRLF 0
+#endif
+#define CSVN_DEFAULT_FLAGS (CSVN_DEFAULT_STRICT | CSVN_DEFAULT_CONSIDER_NL | \
+			    CSVN_DEFAULT_SKIP_WHITESPACE | CSVN_DEFAULT_EMPTY_FIELD | \
+			    CSVN_DEFAULT_CRLF)
+
+/* the second newline character the scanners look for in dialect d */
+#define CSVN_OR_CR(d) (((d)->flags & CSVN_DIALECT_CRLF) ? '\r' : (d)->newline)
+
+/* 
+	Functions which are worth a copy of their own for every common 
+	dialect (refer to csvn_parse_common).
+*/
+#if defined(__GNUC__)
+#define CSVN_INLINE static __inline__ __attribute__((always_inline))
+#else
+#define CSVN_INLINE static
+#endif
+
+/* internal results of partial parsing functions (refer to csvn_parse_text) */
+#define CSVN_NONE 0
+#define CSVN_FIELD 1
+#define CSVN_MORE 2
+
+/*
+	Defining CSVN_SIMD makes the field scanners look for structural 
+	characters (delimiters, newlines and quotes) 16 or 32 bytes at a time 
+	using the widest instruction set enabled at compile time (AVX2, SSE2 
+	or NEON). 
+
+	If none of them is available, the parser silently falls back to the 
+	scalar scanner, which is also used for the tail of the text.
+*/
+#ifdef CSVN_SIMD
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define CSVN_SIMD_AVX2
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define CSVN_SIMD_SSE2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define CSVN_SIMD_NEON
+#endif
+#endif
+
+/*
+	Defining CSVN_INDEX enables the two-stage parser (csvn_index and 
+	csvn_parse_index) which first finds all structural characters of the 
+	text and only then turns them into tokens, as well as csvn_validate, 
+	which only counts the rows and fields found by the first stage.
+*/
+#ifdef CSVN_INDEX
+#include <stdint.h>
+#if defined(CSVN_SIMD) && defined(__PCLMUL__)
+#include <wmmintrin.h>
+#define CSVN_SIMD_PCLMUL
+#endif
+#endif
+
+/*
+	Defining CSVN_ARENA enables csvn_arena, a bump allocator whose blocks 
+	(taken from malloc) are all given back at once. It can serve as the 
+	grow function of a parser (refer to csvn_arena_grow) and holds the 
+	copies of fields made by csvn_copy_field.
+
+	The first block of an arena has CSVN_ARENA_BLOCK characters (unless 
+	its size is given), every following block twice as many as the one 
+	before, up to CSVN_ARENA_MAX_BLOCK.
+*/
+#ifdef CSVN_ARENA
+#include <stdlib.h>
+#ifndef CSVN_ARENA_BLOCK
+#define CSVN_ARENA_BLOCK 65536
+#endif
+#ifndef CSVN_ARENA_MAX_BLOCK
+#define CSVN_ARENA_MAX_BLOCK (16 * 1024 * 1024)
+#endif
+/* every allocation is aligned to 16 characters */
+#define CSVN_ALIGN(n) (((n) + 15) & ~(size_t)15)
+#endif
+
+/*
+	Defining CSVN_BATCH enables csvn_parse_batch which parses many texts 
+	(refer to csvn_job) on a pool of threads stealing work from each 
+	other. Since the texts much larger than the others are split by 
+	csvn_parse_parallel, it enables CSVN_PARALLEL as well.
+*/
+#if defined(CSVN_BATCH) && !defined(CSVN_PARALLEL)
+#define CSVN_PARALLEL
+#endif
+
+/*
+	Defining CSVN_PARALLEL enables csvn_parse_parallel which splits the 
+	text into chunks parsed by separate (POSIX) threads.
+
+	Every thread gets at least CSVN_PARALLEL_MIN characters of text, 
+	shorter texts are simply parsed by the calling thread.
+*/
+#ifdef CSVN_PARALLEL
+#include <pthread.h>
+#include <stdlib.h>
+#ifndef CSVN_PARALLEL_MIN
+#define CSVN_PARALLEL_MIN 65536
+#endif
+#endif
+
+/*
+	Defining CSVN_MMAP enables csvn_open_mmap which maps a whole file 
+	into memory (POSIX), so that it can be parsed without being copied. 
+
+	The kernel is told to read the file sequentially and give back the 
+	pages released by csvn_release_mmap. Since this relies on madvise, 
+	which glibc only declares with _DEFAULT_SOURCE (or _GNU_SOURCE), the 
+	hints are silently left out when it is not available. Additionally 
+	defining CSVN_MMAP_POPULATE reads the whole file in advance.
+*/
+#ifdef CSVN_MMAP
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+/*
+	Defining CSVN_GZIP (with zlib) or CSVN_ZSTD (with libzstd) enables 
+	csvn_start_decoder, a pipeline which decompresses the stream it reads 
+	on its own thread, so they enable CSVN_PIPELINE as well.
+*/
+#if defined(CSVN_GZIP) || defined(CSVN_ZSTD)
+#define CSVN_HAS_CODEC
+#ifndef CSVN_PIPELINE
+#define CSVN_PIPELINE
+#endif
+#endif
+#ifdef CSVN_GZIP
+#include <zlib.h>
+#endif
+#ifdef CSVN_ZSTD
+#include <zstd.h>
+#endif
+
+/*
+	Defining CSVN_PIPELINE enables csvn_start_pipeline which reads a file 
+	descriptor with a separate (POSIX) thread into a ring of buffers, so 
+	that the next reads are in flight while the current buffer is parsed 
+	with csvn_parse_stream.
+
+	A pipeline has at most CSVN_PIPELINE_MAX buffers.
+*/
+#ifdef CSVN_PIPELINE
+#include <pthread.h>
+#include <unistd.h>
+#include <errno.h>
+#ifndef CSVN_PIPELINE_MAX
+#define CSVN_PIPELINE_MAX 8
+#endif
+#endif
+
+/*
+	Defining CSVN_INFER enables csvn_infer_schema, which guesses the type 
+	of every column from a sample of rows (refer to csvn_col_type). Since 
+	the sampled fields are read through on_field and the guess is a 
+	schema of columns, it enables CSVN_COLUMNS and CSVN_CALLBACKS as well.
+*/
+#ifdef CSVN_INFER
+#ifndef CSVN_COLUMNS
+#define CSVN_COLUMNS
+#endif
+#ifndef CSVN_CALLBACKS
+#define CSVN_CALLBACKS
+#endif
+#endif
+
+/*
+	Defining CSVN_COLUMNS lets the parser store the fields in columns 
+	instead of (or along with) tokens (refer to csvn_col). Since typed 
+	columns are converted by them, it enables CSVN_CONVERT as well.
+*/
+#if defined(CSVN_COLUMNS) && !defined(CSVN_CONVERT)
+#define CSVN_CONVERT
+#endif
+#ifdef CSVN_COLUMNS
+#define CSVN_HAS_COLUMNS(csv_p) ((csv_p)->columns != NULL)
+#else
+#define CSVN_HAS_COLUMNS(csv_p) 0
+#endif
+
+/*
+	Defining CSVN_PROJECTION lets the parser skip the fields of the 
+	columns which are not selected by its projection, so that they take 
+	neither a token nor a value of a column.
+*/
+#ifdef CSVN_PROJECTION
+#define CSVN_SELECTED(csv_p, col) ((csv_p)->projection == NULL || \
+	((col) < (csv_p)->num_proj && \
+	 (((csv_p)->projection[(col) / 8] >> ((col) % 8)) & 1)))
+#else
+#define CSVN_SELECTED(csv_p, col) 1
+#endif
+
+/*
+	Defining CSVN_FILTER lets the parser drop the rows which do not 
+	satisfy its predicates (refer to csvn_pred) while they are parsed. 
+	Since numeric ranges are converted by csvn_to_f64, it enables 
+	CSVN_CONVERT as well.
+*/
+#if defined(CSVN_FILTER) && !defined(CSVN_CONVERT)
+#define CSVN_CONVERT
+#endif
+#ifdef CSVN_FILTER
+#define CSVN_HAS_FILTER(csv_p) ((csv_p)->preds != NULL)
+#define CSVN_SKIPPED(csv_p, col) ((csv_p)->rejected || \
+	(!CSVN_SELECTED(csv_p, col) && !csvn_tested(csv_p, col)))
+#else
+#define CSVN_HAS_FILTER(csv_p) 0
+#define CSVN_SKIPPED(csv_p, col) (!CSVN_SELECTED(csv_p, col))
+#endif
+
+/*
+	Defining CSVN_HEADER enables csvn_parse_header, which reads the names 
+	of the columns from the first row and maps them to their indices 
+	(refer to csvn_hdr). Since the row is read through on_field, it 
+	enables CSVN_CALLBACKS as well.
+*/
+#if defined(CSVN_HEADER) && !defined(CSVN_CALLBACKS)
+#define CSVN_CALLBACKS
+#endif
+#ifdef CSVN_HEADER
+#include <stdint.h>
+#endif
+
+/*
+	Defining CSVN_CALLBACKS lets the parser hand every field (and the 
+	end of every row) to functions of the caller as soon as it is 
+	parsed, so that no token pool is needed, and enables csvn_next_field.
+*/
+#ifdef CSVN_CALLBACKS
+#define CSVN_HAS_CALLBACKS(csv_p) ((csv_p)->on_field != NULL || (csv_p)->on_row_end != NULL)
+#else
+#define CSVN_HAS_CALLBACKS(csv_p) 0
+#endif
+
+/* rows are filtered at their end, after on_field has been called with their fields */
+#if defined(CSVN_FILTER) && defined(CSVN_CALLBACKS)
+#define CSVN_FILTERED_CALLBACKS(csv_p) (CSVN_HAS_FILTER(csv_p) && CSVN_HAS_CALLBACKS(csv_p))
+#else
+#define CSVN_FILTERED_CALLBACKS(csv_p) 0
+#endif
+
+/* the parser keeps track of the column it is within (colfield) */
+#if defined(CSVN_COLUMNS) || defined(CSVN_PROJECTION) || defined(CSVN_FILTER) || \
+    defined(CSVN_HEADER)
+#define CSVN_COUNT_COLUMNS
+#endif
+#ifdef CSVN_COUNT_COLUMNS
+#define CSVN_NEXT_COLUMN(csv_p) ((csv_p)->colfield++)
+#else
+#define CSVN_NEXT_COLUMN(csv_p) ((void)0)
+#endif
+
+/* the parser has something to do at the end of every row (csvn_end_row) */
+#if defined(CSVN_FILTER) || defined(CSVN_CALLBACKS)
+#define CSVN_ROW_HOOK
+#define CSVN_NEXT_ROW(csv_p) csvn_next_row(csv_p)
+#elif defined(CSVN_COUNT_COLUMNS)
+#define CSVN_NEXT_ROW(csv_p) ((csv_p)->colfield = 0)
+#else
+#define CSVN_NEXT_ROW(csv_p) ((void)0)
+#endif
+
+/*
+	Defining CSVN_SIDECAR lets the parser record a sparse row index while 
+	it parses, a mark every few rows (refer to csvn_mark), which can be 
+	saved next to the text and loaded later to start parsing at any of 
+	its rows right away (refer to csvn_seek_row).
+*/
+#ifdef CSVN_SIDECAR
+#include <stdio.h>
+#include <stdint.h>
+#define CSVN_HAS_MARKS(csv_p) ((csv_p)->every > 0)
+#define CSVN_MARK_ROW(csv_p, term, line) csvn_mark_row(csv_p, term, line)
+#else
+#define CSVN_HAS_MARKS(csv_p) 0
+#define CSVN_MARK_ROW(csv_p, term, line) 0
+#endif
+
+/*
+	Defining CSVN_STATS lets the parser count what it goes over into the 
+	stats it points to (refer to csvn_stats), to tell where the time of 
+	a text goes. Without it, nothing is counted at all.
+*/
+#ifdef CSVN_STATS
+#define CSVN_STAT(csv_p, expr) 				\
+	do {						\
+		if ((csv_p)->stats != NULL) {		\
+			(csv_p)->stats->expr;		\
+		}					\
+	} while (0)
+#else
+#define CSVN_STAT(csv_p, expr) ((void)0)
+#endif
+
+/*
+	CSVN_TRACE_BEGIN(name) and CSVN_TRACE_END(name) are expanded (as 
+	statements) around every call of the parser (parse, parse_index, 
+	index, validate) and every chunk of csvn_parse_parallel (chunk), e.g. 
+	to fire USDT probes or open profiler zones. Unless defined before 
+	including csvn.h, they expand to nothing.
+*/
+#ifndef CSVN_TRACE_BEGIN
+#define CSVN_TRACE_BEGIN(name) ((void)0)
+#endif
+#ifndef CSVN_TRACE_END
+#define CSVN_TRACE_END(name) ((void)0)
+#endif
+
+/*
+	Defining CSVN_CONVERT enables csvn_to_i64, csvn_to_f64 and 
+	csvn_to_time which convert the field of a token right where it is in 
+	the text, without copying it into a string of its own first.
+*/
+#ifdef CSVN_CONVERT
+#include <stdint.h>
+#include <stdlib.h>
+#include <math.h>
+#endif
+
+/*
+	Defining CSVN_LARGE makes all positions in the text (csvn_off) as 
+	wide as size_t, so that texts larger than 2 GiB can be parsed in one 
+	go. Line numbers and token counts stay int: a call which would 
+	parse (or a parser which would hold) more than 2^31 - 1 fields, 
+	tokens or rows returns OUT_OF_RANGE instead.
+*/
+#ifdef CSVN_LARGE
+typedef ptrdiff_t csvn_off;
+#else
+typedef int csvn_off;
+#endif
+
+/*
+	Defining CSVN_ESCAPED adds escaped to csv_t, telling whether a quoted 
+	field contains escaped quotes, which the parser notices anyway. 
+	Without it, csv_t stays five words and every quoted field is taken 
+	to possibly contain some (refer to CSVN_TOK_ESCAPED). Packed tokens 
+	always have room for the flag.
+*/
+
+/*
+	Defining CSVN_PACKED shrinks csv_t to a single 64-bit word holding 
+	the start of the field (40 bits), its length (21 bits), whether it 
+	contains escaped quotes (1 bit) and its type (2 bits), which is read 
+	with the CSVN_TOK_* macros. 
+
+	Packed tokens do not know their line, which is kept in the row index 
+	instead (refer to csv_r), and fields longer than CSVN_PACKED_MAXLEN 
+	characters make the parser return FIELD_TOO_LONG.
+*/
+#ifdef CSVN_PACKED
+#include <stdint.h>
+#define CSVN_PACKED_MAXLEN ((1L << 21) - 1)
+#define CSVN_TOK_START(t) ((csvn_off)((t).bits & (((uint64_t)1 << 40) - 1)))
+#define CSVN_TOK_SIZE(t) ((csvn_off)(((t).bits >> 40) & CSVN_PACKED_MAXLEN) - 1)
+#define CSVN_TOK_ESCAPED(t) ((int)((t).bits >> 61) & 1)
+#define CSVN_TOK_KIND(t) ((enum csv_tok)((t).bits >> 62))
+#else
+#define CSVN_TOK_START(t) ((t).start)
+#define CSVN_TOK_SIZE(t) ((t).size)
+#ifdef CSVN_ESCAPED
+#define CSVN_TOK_ESCAPED(t) ((t).escaped)
+#else
+#define CSVN_TOK_ESCAPED(t) ((t).token == DQUOTE)
+#endif
+#define CSVN_TOK_KIND(t) ((t).token)
+#define CSVN_TOK_LINE(t) ((t).line)
+#endif
+#define CSVN_TOK_END(t) (CSVN_TOK_START(t) + CSVN_TOK_SIZE(t))
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -49,11 +487,36 @@ extern "C" {
 	INVALID_CHARACTER - an invalid character was encountered
 	                    (check parser position for further analysis)
 
+	FIELD_TOO_LONG - a field does not fit in a packed token 
+	                 (refer to CSVN_PACKED)
+
+	IO_ERROR - a file could not be opened or mapped (check errno)
+
+	OUT_OF_RANGE - a converted field does not fit in its type 
+	               (refer to CSVN_CONVERT), or a count of fields, 
+	               tokens or rows does not fit an int
+
+	INVALID_SETTINGS - the parser has settings which can not be 
+	                   combined, such as predicates and callbacks 
+	                   (refer to csv_p)
+
+	WRONG_FIELD_COUNT - a row does not have the number of fields it 
+	                    has to have (refer to csvn_validate)
+
+	DISCARDED - the text to go back to has already been discarded 
+	            (refer to csvn_seek_row)
+
 */
 enum csv_err {
 	
 	NOT_ENOUGH_MEM = -1,
-	INVALID_CHARACTER = -2
+	INVALID_CHARACTER = -2,
+	FIELD_TOO_LONG = -3,
+	IO_ERROR = -4,
+	OUT_OF_RANGE = -5,
+	INVALID_SETTINGS = -6,
+	WRONG_FIELD_COUNT = -7,
+	DISCARDED = -8
 
 } csv_err;
 
@@ -82,362 +545,7404 @@ enum csv_tok {
 
 /*
 
-	pos - current parser position in the text
+	CSVN_DIALECT_STRICT - quotes are only allowed around whole fields 
+	                      (just like CSVN_STRICT)
 
-	toknext - index of the next token to be allocated
+	CSVN_DIALECT_CONSIDER_NL - the line of a quoted field is the one it 
+	                           ends in (just like CSVN_CONSIDER_NL)
 
-	line - current line of text in which the parser operates
+	CSVN_DIALECT_SKIP_WHITESPACE - spaces after a delimiter are skipped 
+	                               (just like CSVN_SKIP_WHITESPACE)
+
+	CSVN_DIALECT_NO_EMPTY_FIELD - empty fields are invalid 
+	                              (just like CSVN_NO_EMPTY_FIELD)
+
+	CSVN_DIALECT_IGNORE_EMPTY_FIELD - empty fields produce no tokens 
+	                                  (just like CSVN_IGNORE_EMPTY_FIELD)
+
+	CSVN_DIALECT_CRLF - "\r\n" and a lone '\r' end a row as well 
+	                    (just like CSVN_CRLF)
 
 */
-struct csv_p {
+enum csvn_flag {
 
-	int pos;
+	CSVN_DIALECT_STRICT = 1,
 
-	int toknext;
+	CSVN_DIALECT_CONSIDER_NL = 2,
 
-	int line;
+	CSVN_DIALECT_SKIP_WHITESPACE = 4,
 
-} csv_p;
+	CSVN_DIALECT_NO_EMPTY_FIELD = 8,
 
-/*
+	CSVN_DIALECT_IGNORE_EMPTY_FIELD = 16,
 
-	start - starting (inclusive) position of the field
+	CSVN_DIALECT_CRLF = 32
 
-	end - ending (inclusive) position of the field
+};
 
-	line - line in which the field was located
+/*
 
-	size - exact length of the field (end - start)
+	delim - character separating the fields of a row
 
-	token - field type
+	newline - character separating the rows
+
+	quote - character enclosing quoted fields (and escaping itself 
+	        within them)
+
+	flags - any combination of csvn_flag values
 
 */
-struct csv_t {
-	
-	int start;
-	
-	int end;
+struct csvn_dialect {
 
-	int line;
+	char delim;
 
-	int size;
+	char newline;
 
-	enum csv_tok token;
+	char quote;
 
-} csv_t;
+	int flags;
+
+};
 
 /*
 
-	Allocates the next token from the provided token pool and initialises it 
-	to default starting values.
+	IDLE - the parser is between two fields
 
-	Returns a pointer to the allocated token if the allocation was 
-	successful and NULL otherwise.
+	AFTER_DELIM - a delimeter has just been parsed
 
-*/
-static struct csv_t *csvn_allocate_token(struct csv_p *csv_p, 
-		                         struct csv_t *tokens, 
-					 const size_t num_tok);
+	IN_TEXT - the parser is within an unquoted field
 
-/*
+	IN_DQUOTE - the parser is within a quoted field
 
-	Fills the provided (non-NULL) token with the provided data.
+	AFTER_DQUOTE - the closing quote of a field has just been parsed
 
-	Refer to csv_t documentation for a brief explanation of parameters.
+	AFTER_CR - a '\r' ending a row has just been parsed (and a '\n' 
+	           right after it belongs to the same row terminator)
 
 */
-static void csvn_fill_token(struct csv_t *csv_t, 
-		            int start, 
-			    int end, 
-			    int line, 
-			    enum csv_tok token);
+enum csv_state {
 
-static int csvn_parse_quotes(const char *text, 
-		             const size_t textlen, 
-			     struct csv_p *csv_p, 
-			     struct csv_t *tokpool, 
-			     const size_t num_tok);
+	IDLE,
 
-static int csvn_parse_normal(const char *text, 
-		             const size_t textlen, 
-			     struct csv_p *csv_p, 
-			     struct csv_t *tokpool, 
-			     const size_t num_tok);
+	AFTER_DELIM,
 
-/*
+	IN_TEXT,
 
-	Initialises the provided (non-NULL) parser to default starting values.
-	
-	This function should also be used to reset the parser in case of 
-	repeated use.
+	IN_DQUOTE,
 
-*/
-void csvn_init(struct csv_p *csv_p);
+	AFTER_DQUOTE,
 
+	AFTER_CR
+
+};
+
+#ifdef CSVN_COLUMNS
 /*
 
-	Parses the provided text (without exceeding textlen) and stores 
-	the parsed fields in tokens array pointed to by tokpool which contains 
-	at least num_tok tokens.
+	CSVN_COL_SPAN - the position and size of the field in the text
 
-	If tokpool is NULL, it will parse the text, but will not store any 
-	tokens in the tokpool. This is useful when the number of tokens is not 
-	initially known.
+	CSVN_COL_I64 - the field converted by csvn_to_i64
 
-	Returns the number of parsed fields (always greater than or equal to 0) 
-	or a negative value indicating an error (refer to csv_err).
+	CSVN_COL_F64 - the field converted by csvn_to_f64
+
+	CSVN_COL_TIME - the field converted by csvn_to_time
+
+	CSVN_COL_BOOL - the field converted by csvn_to_bool
 
 */
-int csvn_parse(const char *text, 
-	       const size_t textlen, 
-	       struct csv_p *csv_p, 
-	       struct csv_t *tokpool, 
-	       const size_t num_tok);
+enum csvn_col_type {
 
-void
-csvn_init(struct csv_p *csv_p)
-{
+	CSVN_COL_SPAN,
 
-	csv_p->pos = 0;
-	csv_p->toknext = 0;
-	csv_p->line = 1;
-}
+	CSVN_COL_I64,
 
-static struct csv_t *
-csvn_allocate_token(struct csv_p *csv_p, 
-		    struct csv_t *tokens, 
-		    const size_t num_tok) 
-{
+	CSVN_COL_F64,
 
-	if (tokens == NULL) {
-		return NULL;
-	}
+	CSVN_COL_TIME,
 
-	if (csv_p->toknext > num_tok) {
-		return NULL;
-	}
+	CSVN_COL_BOOL
 
-	struct csv_t *token = &tokens[csv_p->toknext++];
-	token->start = token->end = token->line = token->size = 0;
-	token->token = UNASSIGN;
+};
 
-	return token;
+/*
 
-}
+	type - what is stored for every row of the column
 
-static void
-csvn_fill_token(struct csv_t *csv_t, 
-		int start, 
-		int end, 
-		int line, 
-		enum csv_tok token)
-{
+	values - one value for every row: the starting position of the 
+	         field (csvn_off) for CSVN_COL_SPAN, int64_t for CSVN_COL_I64, 
+	         CSVN_COL_TIME and CSVN_COL_BOOL, or double for CSVN_COL_F64
 
-	csv_t->start = start;
-	csv_t->end = end;
-	csv_t->line = line;
-	csv_t->size = (end - start);
-	csv_t->token = token;	
+	sizes - size of the field (end - start) of every row, only used 
+	        for CSVN_COL_SPAN
 
-}
+	valid - validity bitmap, bit i % 8 of byte i / 8 is set if row i 
+	        has a value (empty and missing fields have none)
 
-static int
-csvn_parse_quotes(const char *text, 
-		  const size_t textlen, 
-		  struct csv_p *csv_p, 
-		  struct csv_t *tokpool, 
-		  const size_t num_tok)
-{
-		
-	struct csv_t *token;
-	int start, end;
-	start = csv_p->pos;
-	
-	int line = csv_p->line;
+*/
+struct csvn_col {
 
-	while (text[csv_p->pos] != '\0' && csv_p->pos < textlen) {
-		
-		if (text[csv_p->pos] == '\"' && text[csv_p->pos + 1] == '\"') {
-		
-			csv_p->pos += 2;
-			continue;
+	enum csvn_col_type type;
 
-		}
+	void *values;
 
-		if (text[csv_p->pos] == '\"' && text[csv_p->pos + 1] != '\"') {
+	csvn_off *sizes;
 
-			break;
+	unsigned char *valid;
 
-		}
-		
-		if (text[csv_p->pos] == CSVN_NEWLINE) {
-			#ifdef CSVN_CONSIDER_NL
-			line++
-			#endif
-			csv_p->line++;
-		}
+};
+#endif
 
-		csv_p->pos++;
-		
-	}
+#ifdef CSVN_FILTER
+/*
 
-	end = csv_p->pos - 1; /* curent pos is at the closing quote */
+	CSVN_PRED_EQUALS - the field is the same as the text of the predicate
 
-	if (tokpool != NULL) {
+	CSVN_PRED_PREFIX - the field starts with the text of the predicate
+
+	CSVN_PRED_RANGE - the field converted by csvn_to_f64 lies within min 
+	                  and max (both inclusive)
+
+*/
+enum csvn_pred_type {
+
+	CSVN_PRED_EQUALS,
+
+	CSVN_PRED_PREFIX,
+
+	CSVN_PRED_RANGE
+
+};
+
+/*
+
+	column - index of the column the predicate tests (a row without a 
+	         field in it fails)
+
+	type - how the field is tested
+
+	text - text the field is compared with (for CSVN_PRED_EQUALS and 
+	       CSVN_PRED_PREFIX), as it is in the text of the parser
+
+	len - length of text
+
+	min - least value of the field (for CSVN_PRED_RANGE)
+
+	max - greatest value of the field (for CSVN_PRED_RANGE)
+
+*/
+struct csvn_pred {
+
+	int column;
+
+	enum csvn_pred_type type;
+
+	const char *text;
+
+	size_t len;
+
+	double min;
+
+	double max;
+
+};
+#endif
+
+#ifdef CSVN_STATS
+/*
+
+	bytes - number of characters the parser has gone over
+
+	calls - number of calls of the parser (chunks of csvn_parse_parallel 
+	        excluded)
+
+	fields - number of parsed fields of every type (indexed by csv_tok), 
+	         the skipped ones excluded
+
+	escapes - number of escaped quotes within quoted fields
+
+	multiline - number of newlines within quoted fields
+
+	grown - number of times a pool of the parser has been grown
+
+	exhausted - number of times the token or row pool has run out
+
+*/
+struct csvn_stats {
+
+	size_t bytes;
+
+	size_t calls;
+
+	size_t fields[4];
+
+	size_t escapes;
+
+	size_t multiline;
+
+	size_t grown;
+
+	size_t exhausted;
+
+};
+#endif
+
+/*
+
+	pos - current parser position in the text
+
+	toknext - index of the next token to be allocated
+
+	line - current line of text in which the parser operates
+
+	state - what the parser is in the middle of at pos
+
+	start - starting position of the field the parser is within
+
+	tokline - line of the field the parser is within (or has emitted 
+	          last, which packed tokens do not hold)
+
+	grow - realloc-like function called with ctx to grow the token pool 
+	       when it runs out of tokens (if NULL, the pool does not grow)
+
+	ctx - user context passed to grow
+
+	tokens - token pool the parser has grown (NULL until it does), into 
+	         which the provided one is copied rather than handed to grow
+
+	num_tok - number of tokens in the grown token pool
+
+	rows - row pool which is filled as the rows are parsed (if NULL, 
+	       rows are not recorded), grown by grow just like the token pool
+
+	num_row - number of rows in the row pool
+
+	rownext - index of the next row to be allocated
+
+	ownrows - non-zero once the parser has grown the row pool (until 
+	          then, the pool is the caller's and is copied into the 
+	          first grown one rather than handed to grow)
+
+	linestart - starting position of the current line
+
+	dialect - dialect of the text (if NULL, the one given by the macros)
+
+	escapes - number of escaped quotes in the quoted field the parser 
+	          is within
+
+	unescape - non-zero if escaped quotes are compacted in place 
+	           (refer to csvn_parse_unescape)
+
+	(with CSVN_COLUMNS)
+
+	columns - schema of num_col columns which the fields of every row 
+	          are stored in, in order (if NULL, there are no columns), 
+	          grown by grow just like the token pool
+
+	num_col - number of columns, further fields of a row are dropped
+
+	num_val - number of rows every column has room for
+
+	colnext - index of the next row to be stored in the columns
+
+	colrow - starting position of the row which was stored last
+
+	owncols - number of buffers of the columns (values, sizes and valid 
+	          of every column in turn) the parser has grown, the others 
+	          being the caller's, just like the row pool
+
+	(with CSVN_PROJECTION)
+
+	projection - bitmap of the num_proj columns whose fields are kept, 
+	             bit i % 8 of byte i / 8 selects column i (if NULL, 
+	             every field is kept)
+
+	num_proj - number of columns in the projection, further fields of 
+	           a row are skipped
+
+	(with CSVN_FILTER)
+
+	preds - num_pred predicates every row has to satisfy to be kept 
+	        (if NULL, every row is kept), which can not be combined 
+	        with on_field or on_row_end (as a row is only known to be 
+	        kept at its end, after its fields have been handed out, the 
+	        parser returns INVALID_SETTINGS if it has both)
+
+	num_pred - number of predicates
+
+	rowpass - number of predicates the current row has satisfied
+
+	rowseen - non-zero if the current row has had a field
+
+	rejected - non-zero if the current row failed a predicate, so that 
+	           the rest of its fields are skipped
+
+	rowtok - index of the first token of the current row
+
+	rowfields - number of fields of the current row parsed by the 
+	            current call
+
+	dropped - number of fields parsed by the current call which have 
+	          been dropped along with their rows
+
+	(with CSVN_CALLBACKS)
+
+	on_field - function called with sink for every parsed field, with 
+	           its starting position, length and type, instead of (or 
+	           along with) storing a token (if it returns non-zero, the 
+	           parser stops right after the field)
+
+	on_row_end - function called with sink after the last field of 
+	             every row (which has any)
+
+	sink - user context passed to on_field and on_row_end
+
+	rowopen - non-zero if the current row has had a field
+
+	stopped - non-zero if on_field asked the parser to stop
+
+	(with CSVN_SIDECAR)
+
+	marks - mark pool which a mark is added to every every rows (refer 
+	        to csvn_mark), grown by grow just like the token pool
+
+	num_mark - number of marks in the mark pool
+
+	marknext - number of marks recorded
+
+	ownmarks - non-zero once the parser has grown the mark pool, just 
+	           like the row pool
+
+	every - number of rows between two marks (if 0, no marks are 
+	        recorded)
+
+	rowcount - number of rows (which are not blank) ended so far
+
+	base - number of characters discarded so far (refer to 
+	       csvn_discard), which the offsets of the marks count as well
+
+	(with CSVN_STATS)
+
+	stats - counters which the parser adds to (if NULL, nothing is 
+	        counted)
+
+	(with CSVN_COLUMNS, CSVN_PROJECTION, CSVN_FILTER or CSVN_HEADER)
+
+	colfield - index of the column the parser is within (the number 
+	           of delimiters before pos in the current row)
+
+*/
+struct csv_p {
+
+	csvn_off pos;
+
+	int toknext;
+
+	int line;
+
+	enum csv_state state;
+
+	csvn_off start;
+
+	int tokline;
+
+	void *(*grow)(void *ctx, void *ptr, size_t size);
+
+	void *ctx;
+
+	struct csv_t *tokens;
+
+	size_t num_tok;
+
+	struct csv_r *rows;
+
+	size_t num_row;
+
+	int rownext;
+
+	int ownrows;
+
+	csvn_off linestart;
+
+	const struct csvn_dialect *dialect;
+
+	int escapes;
+
+	int unescape;
+
+#ifdef CSVN_COLUMNS
+
+	struct csvn_col *columns;
+
+	int num_col;
+
+	size_t num_val;
+
+	size_t colnext;
+
+	csvn_off colrow;
+
+	int owncols;
+
+#endif
+
+#ifdef CSVN_PROJECTION
+
+	const unsigned char *projection;
+
+	int num_proj;
+
+#endif
+
+#ifdef CSVN_FILTER
+
+	const struct csvn_pred *preds;
+
+	int num_pred;
+
+	int rowpass;
+
+	int rowseen;
+
+	int rejected;
+
+	int rowtok;
+
+	int rowfields;
+
+	int dropped;
+
+#endif
+
+#ifdef CSVN_CALLBACKS
+
+	int (*on_field)(void *sink, csvn_off start, csvn_off len, enum csv_tok kind);
+
+	void (*on_row_end)(void *sink);
+
+	void *sink;
+
+	int rowopen;
+
+	int stopped;
+
+#endif
+
+#ifdef CSVN_SIDECAR
+
+	struct csvn_mark *marks;
+
+	size_t num_mark;
+
+	int marknext;
+
+	int ownmarks;
+
+	int every;
+
+	int rowcount;
+
+	csvn_off base;
+
+#endif
+
+#ifdef CSVN_STATS
+
+	struct csvn_stats *stats;
+
+#endif
+
+#ifdef CSVN_COUNT_COLUMNS
+
+	int colfield;
+
+#endif
+
+} csv_p;
+
+/*
+
+	start - starting (inclusive) position of the field
+
+	end - ending (inclusive) position of the field
+
+	line - line in which the field was located
+
+	size - exact length of the field (end - start)
+
+	token - field type
+
+	escaped - non-zero if the (quoted) field contains escaped quotes, 
+	          which are still doubled unless it was parsed by 
+	          csvn_parse_unescape (only with CSVN_ESCAPED)
+
+	(with CSVN_PACKED, bits holds start, size + 1, whether the field is 
+	escaped and its type instead)
+
+*/
+struct csv_t {
+#ifdef CSVN_PACKED
+
+	uint64_t bits;
+
+#else
+	
+	csvn_off start;
+	
+	csvn_off end;
+
+	int line;
+
+	csvn_off size;
+
+	enum csv_tok token;
+
+#ifdef CSVN_ESCAPED
+
+	int escaped;
+
+#endif
+#endif
+} csv_t;
+
+/*
+
+	token - index of the first token of the row
+
+	count - number of fields in the row
+
+	offset - starting position of the row
+
+	line - line in which the row starts
+
+*/
+struct csv_r {
+
+	int token;
+
+	int count;
+
+	csvn_off offset;
+
+	int line;
+
+};
+
+#ifdef CSVN_SIDECAR
+/*
+
+	Mark i of the sparse row index is where row (i + 1) * every of the 
+	text starts (rows are counted from 0, blank lines are not rows).
+
+	offset - position right after the end of the row before it (which 
+	         is the '\n' of a "\r\n" ending it)
+
+	line - line at offset
+
+*/
+struct csvn_mark {
+
+	csvn_off offset;
+
+	int line;
+
+};
+#endif
+
+#ifdef CSVN_ARENA
+/*
+
+	A block of an arena, followed by its characters.
+
+	next - block allocated after this one
+
+	size - number of characters of the block
+
+*/
+struct csvn_block {
+
+	struct csvn_block *next;
+
+	size_t size;
+
+};
+
+/*
+
+	first - first block of the arena (NULL until something is allocated)
+
+	block - block allocations are made from
+
+	used - number of characters of the block which have been allocated
+
+	next - size of the next block to allocate
+
+	last - last allocation of csvn_arena_grow, which can grow in place
+
+	allocated - number of characters allocated since the last reset
+
+*/
+struct csvn_arena {
+
+	struct csvn_block *first;
+
+	struct csvn_block *block;
+
+	size_t used;
+
+	size_t next;
+
+	char *last;
+
+	size_t allocated;
+
+};
+#endif
+
+#ifdef CSVN_PARALLEL
+/*
+
+	Part of the text parsed by a single thread of csvn_parse_parallel.
+
+	dialect - dialect of the text (never NULL)
+
+	begin, end - boundaries of the chunk (end is later moved to the 
+	             start of the next chunk)
+
+	nul - position of the first '\0' within the chunk (or end, always 
+	      with CSVN_LENGTH_ONLY)
+
+	quoted - quote parity of the chunk, later the quote state at begin
+
+	start - starting position of the first record within the chunk
+
+	more - non-zero if another chunk follows
+
+	parser - parser state of the chunk, which also grows its token pool
+
+	res - result of parsing the chunk
+
+	out, lines - where the tokens end up and by how many lines they 
+	             have to be moved
+
+	rowout, tokbase - where the rows end up and the index of the first 
+	                  token of the chunk in the final token pool
+
+	arena - arena of the pools of the chunk, if the parser grows its own 
+	        from an arena (refer to csvn_arena_grow)
+
+*/
+struct csvn_chunk {
+
+	const char *text;
+
+	size_t textlen;
+
+	const struct csvn_dialect *dialect;
+
+	size_t begin;
+
+	size_t end;
+
+	size_t nul;
+
+	int quoted;
+
+	size_t start;
+
+	int more;
+
+	struct csv_p parser;
+
+	int res;
+
+	struct csv_t *out;
+
+	int lines;
+
+	struct csv_r *rowout;
+
+	int tokbase;
+
+	int phase;
+
+	int running;
+
+	pthread_t thread;
+
+#ifdef CSVN_STATS
+	struct csvn_stats stats;
+#endif
+
+#ifdef CSVN_ARENA
+	struct csvn_arena arena;
+#endif
+
+};
+#endif
+
+#ifdef CSVN_MMAP
+/*
+
+	text - contents of the mapped file (not terminated by '\0')
+
+	textlen - size of the file
+
+	released - number of characters at the beginning of the text which 
+	           have been given back to the kernel
+
+*/
+struct csvn_mmap {
+
+	const char *text;
+
+	size_t textlen;
+
+	size_t released;
+
+};
+#endif
+
+#ifdef CSVN_HAS_CODEC
+/*
+
+	CSVN_CODEC_UNKNOWN - the stream has not been read yet
+
+	CSVN_CODEC_PLAIN - the stream is not compressed
+
+	CSVN_CODEC_GZIP - the stream is made of gzip members (CSVN_GZIP)
+
+	CSVN_CODEC_ZSTD - the stream is made of zstd frames (CSVN_ZSTD)
+
+*/
+enum csvn_codec {
+
+	CSVN_CODEC_UNKNOWN,
+
+	CSVN_CODEC_PLAIN,
+
+	CSVN_CODEC_GZIP,
+
+	CSVN_CODEC_ZSTD
+
+};
+#endif
+
+#ifdef CSVN_PIPELINE
+/*
+
+	text - current window of the stream, which starts with the characters 
+	       the parser has not discarded, followed by the ones just read
+
+	textlen - size of the window
+
+	last - non-zero if the window is the last part of the stream
+
+	fd - file descriptor the thread reads
+
+	buffer - memory of the buffers, one after another
+
+	buflen - size of every buffer, half of which is read into while the 
+	         other half is left for the characters carried over
+
+	num_buf - number of buffers
+
+	got - number of characters read into every buffer
+
+	state - 0 if the buffer has been read, 1 if the stream has ended 
+	        or an error (refer to csv_err)
+
+	produced - number of buffers read by the thread so far
+
+	consumed - number of buffers taken by csvn_next_window so far
+
+	released - number of buffers given back to the thread so far
+
+	stop - non-zero once csvn_stop_pipeline is called
+
+	finished - non-zero once csvn_next_window has returned 0
+
+	on_ready - function called (once, by the thread) with ready_ctx when 
+	           the next window is available (refer to csvn_notify_window)
+
+	lock, cond, thread - synchronisation with the reading thread
+
+	codec - format of the stream, known once the first window is taken 
+	        (only with CSVN_GZIP or CSVN_ZSTD)
+
+	input - buffer the compressed stream is read into (NULL if the 
+	        stream is not decompressed)
+
+	inlen - size of the input buffer
+
+	inpos, inend - part of the input buffer which is left to decompress
+
+	eof - non-zero once the whole stream has been read
+
+	pending - non-zero if the last gzip member or zstd frame has not 
+	          been decompressed whole yet
+
+	gz, zstd - state of the decompression
+
+*/
+struct csvn_pipeline {
+
+	const char *text;
+
+	size_t textlen;
+
+	int last;
+
+	int fd;
+
+	char *buffer;
+
+	size_t buflen;
+
+	int num_buf;
+
+	size_t got[CSVN_PIPELINE_MAX];
+
+	int state[CSVN_PIPELINE_MAX];
+
+	unsigned long produced;
+
+	unsigned long consumed;
+
+	unsigned long released;
+
+	int stop;
+
+	int finished;
+
+	void (*on_ready)(void *ctx);
+
+	void *ready_ctx;
+
+	pthread_mutex_t lock;
+
+	pthread_cond_t cond;
+
+	pthread_t thread;
+
+#ifdef CSVN_HAS_CODEC
+
+	enum csvn_codec codec;
+
+	char *input;
+
+	size_t inlen;
+
+	size_t inpos;
+
+	size_t inend;
+
+	int eof;
+
+	int pending;
+
+#endif
+
+#ifdef CSVN_GZIP
+
+	z_stream gz;
+
+#endif
+
+#ifdef CSVN_ZSTD
+
+	ZSTD_DCtx *zstd;
+
+#endif
+
+};
+#endif
+
+#ifdef CSVN_BATCH
+/*
+
+	text - text to parse (ignored if it is read from path)
+
+	textlen - size of the text
+
+	path - file to map into text (with CSVN_MMAP) or NULL
+
+	map - mapping of path, which is left open for the tokens to be used 
+	      (refer to csvn_close_mmap)
+
+	parser - parser of the text, initialised (and set up with its 
+	         dialect, grow function, rows...) beforehand
+
+	tokpool, num_tok - token pool of the text (refer to csvn_parse)
+
+	res - result of parsing the text (refer to csvn_parse_parallel) or 
+	      IO_ERROR if path can not be mapped
+
+	split - number of threads the text has been split among
+
+*/
+struct csvn_job {
+
+	const char *text;
+
+	size_t textlen;
+
+#ifdef CSVN_MMAP
+	const char *path;
+
+	struct csvn_mmap map;
+#endif
+
+	struct csv_p parser;
+
+	struct csv_t *tokpool;
+
+	size_t num_tok;
+
+	int res;
+
+	int split;
+
+};
+
+/*
+
+	A job of csvn_parse_batch, sorted by the size of its text.
+
+*/
+struct csvn_task {
+
+	size_t len;
+
+	int job;
+
+};
+
+/*
+
+	A thread of csvn_parse_batch.
+
+	sched - scheduler the worker belongs to
+
+	tasks, head, tail - tasks of the worker, taken from the head by the 
+	                    worker itself and from the tail by the others
+
+	lock - guards head and tail
+
+*/
+struct csvn_worker {
+
+	struct csvn_sched *sched;
+
+	struct csvn_task *tasks;
+
+	int head;
+
+	int tail;
+
+	pthread_mutex_t lock;
+
+	int running;
+
+	pthread_t thread;
+
+};
+
+/*
+
+	State of csvn_parse_batch shared by its workers.
+
+	share - number of characters of every worker if they all got the 
+	        same (the texts larger than that are split)
+
+	busy - number of threads parsing a job (the threads of its split 
+	       included), so that a split only takes the idle ones
+
+	done, delivered - jobs which have been parsed and number of them 
+	                  handed to on_done so far, in order
+
+	delivering - non-zero while a worker hands jobs to on_done, which 
+	             it does without holding lock
+
+	lock - guards busy, done, delivered and delivering
+
+*/
+struct csvn_sched {
+
+	struct csvn_job *jobs;
+
+	int num_jobs;
+
+	struct csvn_worker *workers;
+
+	int num_workers;
+
+	int nthreads;
+
+	size_t share;
+
+	int busy;
+
+	unsigned char *done;
+
+	int delivered;
+
+	int delivering;
+
+	pthread_mutex_t lock;
+
+	void (*on_done)(void *ctx, struct csvn_job *job);
+
+	void *ctx;
+
+};
+#endif
+
+#ifdef CSVN_INDEX
+/*
+
+	pos - position up to which the text has been indexed
+
+	count - number of structural positions found so far
+
+	quoted - non-zero if the text at pos lies within a quoted field
+
+	dialect - dialect of the text (if NULL, the one given by the 
+	          macros), which has to be the one of the parser as well
+
+*/
+struct csvn_idx {
+
+	size_t pos;
+
+	size_t count;
+
+	int quoted;
+
+	const struct csvn_dialect *dialect;
+
+};
+
+/*
+
+	rows - number of rows of the text (blank lines are not rows)
+
+	fields - number of fields every row has to have or 0 if rows may 
+	         have any number of them (the only member set by the caller)
+
+	max_fields - greatest number of fields of a row
+
+	bad_row, bad_offset - index and starting position of the first 
+	                      malformed row (only set on an error)
+
+*/
+struct csvn_shape {
+
+	size_t rows;
+
+	int fields;
+
+	int max_fields;
+
+	size_t bad_row;
+
+	size_t bad_offset;
+
+};
+#endif
+
+#ifdef CSVN_CALLBACKS
+/*
+
+	parser - parser the fields are pulled from (its callbacks belong to 
+	         the iterator, the rest of it may be set up as usual)
+
+	text - text the fields are pulled from
+
+	textlen - size of the text
+
+	row - index of the row the last pulled field belongs to
+
+*/
+struct csvn_iter {
+
+	struct csv_p parser;
+
+	const char *text;
+
+	size_t textlen;
+
+	int row;
+
+};
+#endif
+
+#ifdef CSVN_HEADER
+/*
+
+	names - names of the columns one after another (with their escaped 
+	        quotes unescaped), grown by the grow function of the parser
+
+	num_chars - number of characters names has room for
+
+	ends - end of the name of every column in names, so that the name of 
+	       column i starts at ends[i - 1] (or 0)
+
+	num_ends - number of columns ends has room for
+
+	num_col - number of columns in the header
+
+	slots - open addressed hash table of num_slots (a power of two) 
+	        entries, each holding a column + 1 or 0 if it is empty
+
+	num_slots - number of entries in slots
+
+*/
+struct csvn_hdr {
+
+	char *names;
+
+	size_t num_chars;
+
+	size_t *ends;
+
+	size_t num_ends;
+
+	int num_col;
+
+	int *slots;
+
+	size_t num_slots;
+
+};
+#endif
+
+/*
+
+	Allocates the next token from the provided token pool and initialises it 
+	to default starting values.
+
+	Returns a pointer to the allocated token if the allocation was 
+	successful and NULL otherwise.
+
+*/
+CSVN_INLINE struct csv_t *csvn_allocate_token(struct csv_p *csv_p, 
+		                              struct csv_t *tokens, 
+					      const size_t num_tok);
+
+/*
+
+	Returns a token pool which can hold at least need tokens, which is 
+	either the current one (tokens, or the one grown by csv_p) or the 
+	one grown by the grow function of csv_p.
+
+	Returns NULL if the pool is too small and can not be grown.
+
+*/
+static struct csv_t *csvn_grow_tokens(struct csv_p *csv_p, 
+				      struct csv_t *tokens, 
+				      size_t num_tok, 
+				      const size_t need);
+
+/*
+
+	Grows a pool of the parser to size characters with its grow function. 
+	A pool which is not owned by the parser (provided by the caller) is 
+	never handed to grow: a new one is allocated instead, into which the 
+	first used characters of the old one are copied.
+
+	Returns the grown pool or NULL.
+
+*/
+static void *csvn_grow_pool(struct csv_p *csv_p, 
+			    void *pool, 
+			    int owned, 
+			    size_t used, 
+			    size_t size);
+
+/*
+
+	Fills the provided (non-NULL) token with the provided data.
+
+	Refer to csv_t documentation for a brief explanation of parameters.
+
+*/
+static void csvn_fill_token(struct csv_t *csv_t, 
+		            csvn_off start, 
+			    csvn_off end, 
+			    int line, 
+			    enum csv_tok token, 
+			    int escaped);
+
+/*
+
+	Returns the position of the first character in text (starting at pos 
+	and not exceeding textlen) which is equal to any of a, b, c, d or e.
+
+	If no such character exists, textlen is returned.
+
+*/
+static size_t csvn_scan(const char *text, 
+		        size_t pos, 
+			const size_t textlen, 
+			char a, 
+			char b, 
+			char c, 
+			char d, 
+			char e);
+
+/*
+
+	Allocates and fills the next token if tokpool is not NULL (and stores 
+	the field of the text in the columns of the parser, if it has any), 
+	unless the projection of the parser skips the current column.
+
+	Returns CSVN_FIELD if the field was kept, CSVN_NONE if it was 
+	skipped, NOT_ENOUGH_MEM, FIELD_TOO_LONG or the error of the 
+	conversion of a typed column.
+
+*/
+CSVN_INLINE int csvn_emit_token(const char *text, 
+				struct csv_p *csv_p, 
+				struct csv_t *tokpool, 
+				const size_t num_tok, 
+				csvn_off start, 
+				csvn_off end, 
+				int line, 
+				enum csv_tok token, 
+				int escaped);
+
+/*
+
+	Moves the characters of a quoted field between from (inclusive) and 
+	to (exclusive) over the escaped quotes found before them, if the 
+	parser unescapes in place.
+
+*/
+CSVN_INLINE void csvn_unescape_move(const char *text, 
+				    struct csv_p *csv_p, 
+				    csvn_off from, 
+				    csvn_off to);
+
+/*
+
+	Makes sure that the row pool of the parser can hold at least need 
+	rows, growing it if necessary.
+
+	Returns 0 on success or NOT_ENOUGH_MEM.
+
+*/
+static int csvn_grow_rows(struct csv_p *csv_p, const size_t need);
+
+/*
+
+	Allocates a row for the current line (starting with a field in the 
+	given line) in the row pool of the parser, unless it has already been 
+	allocated.
+
+	Returns 0 on success, NOT_ENOUGH_MEM or OUT_OF_RANGE (if there 
+	are more rows than an int holds).
+
+*/
+static int csvn_open_row(struct csv_p *csv_p, int line);
+
+#ifdef CSVN_COLUMNS
+/*
+
+	Makes sure that every column of the parser can hold at least need 
+	rows, growing them if necessary.
+
+	Returns 0 on success or NOT_ENOUGH_MEM.
+
+*/
+static int csvn_grow_columns(struct csv_p *csv_p, const size_t need);
+
+/*
+
+	Grows the buffer of a column which is the slot-th one of the parser 
+	(refer to owncols) to size characters, keeping the used ones.
+
+	Returns the grown buffer or NULL.
+
+*/
+static void *csvn_grow_column(struct csv_p *csv_p, 
+			      void *buffer, 
+			      int slot, 
+			      size_t used, 
+			      size_t size);
+
+/*
+
+	Starts a new row in the columns of the parser for the current line 
+	(with no values so far), unless it has already been started.
+
+	Returns 0 on success or NOT_ENOUGH_MEM.
+
+*/
+static int csvn_open_column_row(struct csv_p *csv_p);
+
+/*
+
+	Stores the field between start and end (of the given type) in the 
+	current column of the current row.
+
+	Returns 0 on success or the error of the conversion of a typed column.
+
+*/
+static int csvn_store_field(const char *text, 
+			    struct csv_p *csv_p, 
+			    csvn_off start, 
+			    csvn_off end, 
+			    enum csv_tok token);
+
+/*
+
+	Moves the row still being parsed (if any) to the beginning of the 
+	columns after n characters of the text have been discarded.
+
+*/
+static void csvn_discard_columns(struct csv_p *csv_p, size_t n);
+#endif
+
+#ifdef CSVN_FILTER
+/*
+
+	Tests the field between start and end (of the given type) against 
+	the predicate.
+
+	Returns non-zero if the field satisfies the predicate.
+
+*/
+static int csvn_match(const char *text, 
+		      csvn_off start, 
+		      csvn_off end, 
+		      enum csv_tok token, 
+		      const struct csvn_pred *pred);
+
+/*
+
+	Tests the field between start and end (of the given type) against 
+	the predicates of the current column, dropping the current row if it 
+	fails one of them.
+
+	Returns the number of satisfied predicates or -1 if the current row 
+	has been dropped.
+
+*/
+static int csvn_filter_field(const char *text, 
+			     struct csv_p *csv_p, 
+			     csvn_off start, 
+			     csvn_off end, 
+			     enum csv_tok token);
+
+/*
+
+	Returns non-zero if one of the predicates of the parser tests the 
+	given column.
+
+*/
+static int csvn_tested(const struct csv_p *csv_p, int col);
+
+/*
+
+	Takes back the tokens, the row and the values of the columns of the 
+	current row, so that the rest of its fields are skipped.
+
+*/
+static void csvn_drop_row(struct csv_p *csv_p);
+#endif
+
+#ifdef CSVN_ROW_HOOK
+/*
+
+	Finishes the current row, which is dropped if it lacks a field one 
+	of the predicates tests, or else handed to on_row_end.
+
+*/
+static void csvn_end_row(struct csv_p *csv_p);
+
+/*
+
+	Finishes the current row and starts the next one at its first column.
+
+*/
+static void csvn_next_row(struct csv_p *csv_p);
+#endif
+
+#ifdef CSVN_CALLBACKS
+/*
+
+	Callbacks of an iterator, which stop the parser after every field 
+	and count the rows.
+
+*/
+static int csvn_iter_field(void *sink, csvn_off start, csvn_off len, enum csv_tok kind);
+
+static void csvn_iter_row(void *sink);
+#endif
+
+#ifdef CSVN_HEADER
+/*
+
+	State of csvn_parse_header shared with its callbacks.
+
+*/
+struct csvn_hdr_ctx {
+
+	struct csvn_hdr *hdr;
+
+	struct csv_p *csv_p;
+
+	struct csv_p *parser;
+
+	const char *text;
+
+	int done;
+
+	int res;
+
+	csvn_off end;
+
+	int line;
+
+};
+
+/*
+
+	Hashes the name of len characters (32-bit FNV-1a).
+
+*/
+static size_t csvn_hash(const char *name, size_t len);
+
+/*
+
+	Callbacks of csvn_parse_header, which add every field of the first 
+	row to the header and stop the parser at the first field after it.
+
+*/
+static int csvn_header_field(void *sink, csvn_off start, csvn_off len, enum csv_tok kind);
+
+static void csvn_header_row(void *sink);
+
+/*
+
+	Appends a column with the name of len characters (escaped quotes are 
+	unescaped if it is quoted) to the header, growing its buffers with 
+	the grow function of the parser.
+
+	Returns 0 on success or NOT_ENOUGH_MEM.
+
+*/
+static int csvn_add_column(struct csvn_hdr *hdr, 
+			   struct csv_p *csv_p, 
+			   const char *name, 
+			   size_t len, 
+			   enum csv_tok kind, 
+			   char quote);
+
+/*
+
+	Builds the hash table of the header from the names of its columns.
+
+	Returns 0 on success or NOT_ENOUGH_MEM.
+
+*/
+static int csvn_hash_columns(struct csvn_hdr *hdr, struct csv_p *csv_p);
+#endif
+
+#ifdef CSVN_SIDECAR
+/*
+
+	Counts the row ending at term (unless it is blank) and, every every 
+	rows, records where the next one starts, which is on the provided 
+	line + 1.
+
+	Returns 0 on success, NOT_ENOUGH_MEM or OUT_OF_RANGE (once the 
+	row count no longer fits an int), and the row is not counted then.
+
+*/
+static int csvn_mark_row(struct csv_p *csv_p, csvn_off term, int line);
+
+/*
+
+	Checksum of the text (64-bit FNV-1a over its length, its first and 
+	last 4 KiB and the 16 characters before every one of the marks).
+
+*/
+static uint64_t csvn_checksum(const char *text, 
+			      const size_t textlen, 
+			      const struct csvn_mark *marks, 
+			      int num_mark);
+
+/*
+
+	Write and read a 64-bit little endian value.
+
+	Return 0 on success or IO_ERROR.
+
+*/
+static int csvn_put64(FILE *file, uint64_t value);
+
+static int csvn_get64(FILE *file, uint64_t *value);
+#endif
+
+#ifdef CSVN_STATS
+#ifdef CSVN_PARALLEL
+/*
+
+	Adds the counters of from (but its calls) to the ones of stats.
+
+*/
+static void csvn_add_stats(struct csvn_stats *stats, const struct csvn_stats *from);
+#endif
+#endif
+
+/*
+
+	The following functions parse (or continue parsing) the part of the 
+	text denoted by the parser state. 
+
+	If more is non-zero, the text may continue past textlen, so instead 
+	of finishing a field they return CSVN_MORE when they run out of text.
+
+	Otherwise, they return CSVN_FIELD if a field was parsed, CSVN_NONE 
+	if it was not or a negative value indicating an error (refer to 
+	csv_err).
+
+*/
+CSVN_INLINE int csvn_parse_quotes(const char *text, 
+			          const size_t textlen, 
+			          struct csv_p *csv_p, 
+			          struct csv_t *tokpool, 
+			          const size_t num_tok, 
+			          const int more, 
+			          const struct csvn_dialect *d);
+
+CSVN_INLINE int csvn_parse_closed(const char *text, 
+			          const size_t textlen, 
+			          struct csv_p *csv_p, 
+			          const int more, 
+			          const struct csvn_dialect *d);
+
+CSVN_INLINE int csvn_parse_normal(const char *text, 
+			          const size_t textlen, 
+			          struct csv_p *csv_p, 
+			          struct csv_t *tokpool, 
+			          const size_t num_tok, 
+			          const int more, 
+			          const struct csvn_dialect *d);
+
+CSVN_INLINE int csvn_parse_delim(const char *text, 
+			         const size_t textlen, 
+			         struct csv_p *csv_p, 
+			         struct csv_t *tokpool, 
+			         const size_t num_tok, 
+			         const int more, 
+			         const struct csvn_dialect *d);
+
+static int csvn_parse_cr(const char *text, 
+			 const size_t textlen, 
+			 struct csv_p *csv_p, 
+			 const int more);
+
+/*
+
+	Parses the text in the given (non-NULL) dialect d, using the 
+	functions above.
+
+*/
+CSVN_INLINE int csvn_parse_dialect(const char *text, 
+			           const size_t textlen, 
+			           struct csv_p *csv_p, 
+			           struct csv_t *tokpool, 
+			           const size_t num_tok, 
+			           const int more, 
+			           const struct csvn_dialect *d);
+
+/*
+
+	Parses the text in the dialect of the parser. Common dialects (the 
+	one given by the macros, or CSV, TSV, pipe and semicolon separated 
+	text with otherwise default options) are parsed by copies of 
+	csvn_parse_dialect of their own, in which the dialect is a constant, 
+	so only other dialects are read at runtime.
+
+*/
+CSVN_INLINE int csvn_parse_common(const char *text, 
+				  const size_t textlen, 
+				  struct csv_p *csv_p, 
+				  struct csv_t *tokpool, 
+				  const size_t num_tok, 
+				  const int more);
+
+/*
+
+	Common implementation of csvn_parse and csvn_parse_stream.
+
+	A whole text (more is 0) gets copies of csvn_parse_common of its 
+	own, which leave out the checks for a field or row continued by a 
+	later call, so csvn_parse runs straight through the fields.
+
+*/
+static int csvn_parse_text(const char *text, 
+		           const size_t textlen, 
+			   struct csv_p *csv_p, 
+			   struct csv_t *tokpool, 
+			   const size_t num_tok, 
+			   const int more);
+
+/*
+
+	Returns the provided dialect or, if it is NULL, the one given by the 
+	macros.
+
+*/
+CSVN_INLINE const struct csvn_dialect *csvn_dialect_of(const struct csvn_dialect *dialect);
+
+/*
+
+	Returns non-zero if both (non-NULL) dialects are the same.
+
+*/
+static int csvn_same_dialect(const struct csvn_dialect *a, 
+			     const struct csvn_dialect *b);
+
+/*
+
+	Initialises the provided (non-NULL) parser to default starting values.
+	
+	The pools a parser has grown are forgotten by it (so they have to be 
+	freed beforehand): to parse another text with the same parser and 
+	pools, reset it with csvn_reset instead.
+
+*/
+void csvn_init(struct csv_p *csv_p);
+
+/*
+
+	Resets the provided (non-NULL) parser to the start of a new text, 
+	keeping its pools (the ones of the caller and the ones it has grown) 
+	and everything set by the caller, such as the grow function, the 
+	dialect, the columns or the callbacks.
+
+*/
+void csvn_reset(struct csv_p *csv_p);
+
+/*
+
+	Initialises the provided (non-NULL) dialect to the one given by the 
+	macros, so that only the differences have to be set.
+
+*/
+void csvn_dialect_init(struct csvn_dialect *dialect);
+
+#ifdef CSVN_PARALLEL
+/*
+
+	The phases of csvn_parse_parallel, each of them done for a single 
+	chunk by csvn_chunk_worker:
+
+	csvn_chunk_quotes - finds the quote parity and the first '\0'
+
+	csvn_chunk_start - finds the start of the first record, given the 
+	                   quote state at the beginning of the chunk
+
+	csvn_chunk_parse - parses the chunk into its own token pool
+
+	csvn_chunk_copy - copies the tokens to the final token pool
+
+*/
+static void csvn_chunk_quotes(struct csvn_chunk *chunk);
+
+static void csvn_chunk_start(struct csvn_chunk *chunk);
+
+static void csvn_chunk_parse(struct csvn_chunk *chunk);
+
+static void *csvn_chunk_grow(void *ctx, void *ptr, size_t size);
+
+static void csvn_chunk_copy(struct csvn_chunk *chunk);
+
+static void *csvn_chunk_worker(void *arg);
+
+/*
+
+	Runs the given phase for all chunks, each in its own thread, and 
+	waits for them to finish.
+
+*/
+static void csvn_run_chunks(struct csvn_chunk *chunks, int nchunks, int phase);
+
+/*
+
+	Parses the provided text just like csvn_parse does, but splits it 
+	into (at most) nthreads chunks which are parsed concurrently.
+
+	The quote state at the beginning of each chunk is derived from the 
+	quote parity of all chunks before it, which is always right for 
+	text following RFC 4180. Should the guess turn out to be wrong, the 
+	rest of the text is parsed sequentially, so the result is always 
+	the same as the one of csvn_parse.
+
+	Returns the number of parsed fields (always greater than or equal to 0) 
+	or a negative value indicating an error (refer to csv_err).
+
+	If tokpool is too small for all the fields (and can not be grown), 
+	NOT_ENOUGH_MEM is returned and the parser is left untouched.
+
+	A parser with columns (refer to CSVN_COLUMNS) parses sequentially.
+
+*/
+int csvn_parse_parallel(const char *text, 
+			const size_t textlen, 
+			int nthreads, 
+			struct csv_p *csv_p, 
+			struct csv_t *tokpool, 
+			const size_t num_tok);
+#endif
+
+#ifdef CSVN_BATCH
+static int csvn_compare_tasks(const void *a, const void *b);
+
+/*
+
+	Takes the next task of the worker or else steals the last one of 
+	another worker. Returns the index of its job or -1 if none is left.
+
+*/
+static int csvn_take_task(struct csvn_worker *worker);
+
+static void *csvn_batch_worker(void *arg);
+
+/*
+
+	Parses the num_jobs provided jobs (refer to csvn_job) with nthreads 
+	threads, the calling one included. The jobs are dealt out to the 
+	threads from the largest to the smallest, and the threads which run 
+	out of jobs steal from the others, so that small and large jobs even 
+	out. A text larger than the share of a thread is split among as many 
+	threads as it has shares (refer to csvn_parse_parallel), but only 
+	among the worker and the threads no other job is using at the time.
+
+	As soon as a job and all the jobs before it are parsed, on_done (if 
+	not NULL) is called with ctx and the job, in the order of the jobs 
+	and one at a time, by any of the threads. No lock is held while it 
+	runs, so a slow on_done only keeps the thread calling it from 
+	parsing.
+
+	Returns 0 once all jobs are parsed (each with its own result) or 
+	NOT_ENOUGH_MEM if the threads can not be set up.
+
+*/
+int csvn_parse_batch(struct csvn_job *jobs, 
+		     int num_jobs, 
+		     int nthreads, 
+		     void (*on_done)(void *ctx, struct csvn_job *job), 
+		     void *ctx);
+#endif
+
+#ifdef CSVN_INDEX
+/*
+
+	Returns x with every bit replaced by the XOR of itself and all 
+	lower bits of x.
+
+*/
+static uint64_t csvn_prefix_xor(uint64_t x);
+
+/*
+
+	Fills quote, delim and nl with masks marking the quotes, delimeters 
+	and newlines (of dialect d) among the 64 characters pointed to by 
+	block.
+
+*/
+static void csvn_index_block(const char *block, 
+			     const struct csvn_dialect *d, 
+			     uint64_t *quote, 
+			     uint64_t *delim, 
+			     uint64_t *nl);
+
+/*
+
+	Turns the text between two structural positions (fs inclusive, se 
+	exclusive) into a token.
+
+	Returns the number of allocated tokens (0 or 1) or a negative value 
+	indicating an error (refer to csv_err).
+
+*/
+static int csvn_index_field(const char *text, 
+			    size_t fs, 
+			    size_t se, 
+			    int after_delim, 
+			    int before_delim, 
+			    int unterminated, 
+			    struct csv_p *csv_p, 
+			    struct csv_t *tokpool, 
+			    const size_t num_tok, 
+			    const struct csvn_dialect *d);
+
+/*
+
+	Initialises the provided (non-NULL) index to default starting values.
+
+*/
+void csvn_index_init(struct csvn_idx *idx);
+
+/*
+
+	Builds the structural index of the provided text (without exceeding 
+	textlen): positions of all delimeters and newlines which are not part 
+	of a quoted field are stored in offsets array which contains at 
+	least num_off elements. 
+
+	If offsets is NULL, the structural positions are only counted.
+
+	The text is processed in blocks of 64 characters and the index can 
+	be resumed with a larger offsets array (or more text) after 
+	NOT_ENOUGH_MEM is returned. Unlike csvn_parse, textlen is 
+	authoritative and '\0' is treated as any other character.
+
+	Returns the number of structural positions found so far or a 
+	negative value indicating an error (refer to csv_err). More than 
+	an int holds give OUT_OF_RANGE, their number is still idx->count.
+
+*/
+int csvn_index(const char *text, 
+	       const size_t textlen, 
+	       struct csvn_idx *idx, 
+	       size_t *offsets, 
+	       const size_t num_off);
+
+/*
+
+	Parses the provided text using the structural index built by 
+	csvn_index over the whole text and stores the parsed fields in 
+	tokens array pointed to by tokpool which contains at least num_tok 
+	tokens.
+
+	For text which follows RFC 4180 quoting the tokens are exactly the 
+	same as the ones produced by csvn_parse. 
+
+	Returns the number of parsed fields (always greater than or equal to 0) 
+	or a negative value indicating an error (refer to csv_err).
+
+*/
+int csvn_parse_index(const char *text, 
+		     const size_t textlen, 
+		     const struct csvn_idx *idx, 
+		     const size_t *offsets, 
+		     struct csv_p *csv_p, 
+		     struct csv_t *tokpool, 
+		     const size_t num_tok);
+
+/*
+
+	Counts the rows of the provided text (without exceeding textlen) and 
+	the fields of every row (the delimiters outside of quoted fields plus 
+	one) into shape, without storing or even scanning any field: only the 
+	structural masks of csvn_index are read. With a strict dialect (refer 
+	to csvn_flag), the quoting of the text is checked as well: quotes may 
+	only open a field, close it right before a delimiter or a newline, or 
+	be escaped, and the last quoted field has to be closed.
+
+	It stops at the first malformed row, whose index and position are 
+	stored in shape. Like csvn_index, '\0' is treated as any other 
+	character.
+
+	Returns 0 if the text is valid (its number of rows being in shape) 
+	or a negative value indicating an error (refer to csv_err), 
+	INVALID_CHARACTER for a row which is not quoted properly or 
+	WRONG_FIELD_COUNT for a row with another number of fields.
+
+*/
+int csvn_validate(const char *text, 
+		  const size_t textlen, 
+		  const struct csvn_dialect *dialect, 
+		  struct csvn_shape *shape);
+#endif
+
+/*
+
+	Parses the provided text (without exceeding textlen) and stores 
+	the parsed fields in tokens array pointed to by tokpool which contains 
+	at least num_tok tokens.
+
+	If tokpool is NULL, it will parse the text, but will not store any 
+	tokens in the tokpool. This is useful when the number of tokens is not 
+	initially known.
+
+	If the parser has a grow function, tokpool is grown (or allocated, 
+	if it is NULL) as soon as it runs out of tokens and the grown pool 
+	is kept in the tokens member of the parser.
+
+	Returns the number of parsed fields (always greater than or equal to 0) 
+	or a negative value indicating an error (refer to csv_err).
+
+*/
+int csvn_parse(const char *text, 
+	       const size_t textlen, 
+	       struct csv_p *csv_p, 
+	       struct csv_t *tokpool, 
+	       const size_t num_tok);
+
+/*
+
+	Parses the provided text just like csvn_parse does, except that the 
+	escaped quotes of every quoted field are compacted in place while it 
+	is scanned, so that the quoted tokens hold their unescaped value 
+	(the characters between the end of such a token and its closing 
+	quote are left undefined).
+
+	Returns the number of parsed fields (always greater than or equal to 0) 
+	or a negative value indicating an error (refer to csv_err).
+
+*/
+int csvn_parse_unescape(char *text, 
+			const size_t textlen, 
+			struct csv_p *csv_p, 
+			struct csv_t *tokpool, 
+			const size_t num_tok);
+
+/*
+
+	Parses the next part of a stream, just like csvn_parse does, except 
+	that a field which may continue past textlen is left pending (without 
+	having to be scanned again) until the next call provides more text. 
+	
+	The text has to start with the characters which have not been 
+	discarded so far (refer to csvn_discard), followed by the new ones. 
+	The last part of the stream has to be parsed with non-zero last.
+
+	Returns the number of fields parsed by this call (always greater than 
+	or equal to 0) or a negative value indicating an error (refer to 
+	csv_err).
+
+*/
+int csvn_parse_stream(const char *text, 
+		      const size_t textlen, 
+		      struct csv_p *csv_p, 
+		      struct csv_t *tokpool, 
+		      const size_t num_tok, 
+		      const int last);
+
+/*
+
+	Returns the number of characters at the beginning of the text which 
+	are no longer needed by the parser and can safely be discarded.
+
+*/
+size_t csvn_discardable(const struct csv_p *csv_p);
+
+/*
+
+	Tells the parser that the first n characters of the text (at most 
+	csvn_discardable) have been discarded, so that the remaining ones 
+	now start at position 0. 
+
+	Since they refer to the old positions, the tokens parsed so far are 
+	invalidated and the token pool is reused from the beginning. So are 
+	the row pool and the columns, except for the row which is still 
+	being parsed. 
+
+*/
+void csvn_discard(struct csv_p *csv_p, size_t n);
+
+#ifdef CSVN_CALLBACKS
+/*
+
+	Initialises the iterator (and its parser) to pull the fields of the 
+	provided text one by one.
+
+*/
+void csvn_iter_init(struct csvn_iter *it, const char *text, const size_t textlen);
+
+/*
+
+	Parses the next field of the text of the iterator into tok, which is 
+	the only token the parser ever needs.
+
+	Returns 1 if a field was parsed, 0 at the end of the text or a 
+	negative value indicating an error (refer to csv_err).
+
+*/
+int csvn_next_field(struct csvn_iter *it, struct csv_t *tok);
+#endif
+
+#ifdef CSVN_HEADER
+/*
+
+	Initialises the header to have no columns (and no buffers).
+
+*/
+void csvn_header_init(struct csvn_hdr *hdr);
+
+/*
+
+	Parses the row at the parser position as the header of the text and 
+	maps the names of its columns to their indices, leaving the parser 
+	right at the row after it. The buffers of the header are grown by the 
+	grow function of the parser (and never freed by it).
+
+	Returns the number of columns (always greater than or equal to 0) or a 
+	negative value indicating an error (refer to csv_err).
+
+*/
+int csvn_parse_header(const char *text, 
+		      const size_t textlen, 
+		      struct csv_p *csv_p, 
+		      struct csvn_hdr *hdr);
+
+/*
+
+	Looks up the column with the provided name (of len characters) in 
+	the header.
+
+	Returns the index of the column (the first one if several share the 
+	name) or -1 if there is none.
+
+*/
+int csvn_column_index(const struct csvn_hdr *hdr, const char *name, size_t len);
+#endif
+
+#ifdef CSVN_INFER
+/*
+
+	State of csvn_infer_schema shared with its callbacks.
+
+	rows, seen - number of rows to sample (from the current position) 
+	             and number of them sampled so far
+
+	num_seen - number of columns the sampled rows have
+
+	typed - non-zero for every column which has had a value (num_col of 
+	        them)
+
+*/
+struct csvn_infer_ctx {
+
+	struct csvn_col *schema;
+
+	int num_col;
+
+	unsigned char *typed;
+
+	struct csv_p *parser;
+
+	const char *text;
+
+	int rows;
+
+	int seen;
+
+	int num_seen;
+
+};
+
+/*
+
+	Returns the most specific type of column the field between start and 
+	end (both included) can be converted to, trying the digits 8 at a 
+	time (SWAR) before any conversion.
+
+*/
+static enum csvn_col_type csvn_classify(const char *text, 
+					csvn_off start, 
+					csvn_off end, 
+					enum csv_tok kind);
+
+/*
+
+	Returns the type of column both a field of type a and one of type b 
+	can be stored in.
+
+*/
+static enum csvn_col_type csvn_join_types(enum csvn_col_type a, enum csvn_col_type b);
+
+static int csvn_infer_field(void *sink, csvn_off start, csvn_off len, enum csv_tok kind);
+
+static void csvn_infer_row(void *sink);
+
+/*
+
+	Guesses the type of the first num_col columns of the text from its 
+	next rows (starting at the position of csv_p, e.g. right after its 
+	header), sampling up to rows of them (all of them if rows is not 
+	positive). With CSVN_SIDECAR, a parser which has marks (recorded or 
+	loaded, refer to csvn_load_marks) samples about as many rows spread 
+	evenly over the marks instead, starting at its position and at every 
+	mark, or at every few marks if there are more marks than rows.
+
+	Every column is given the most specific type (CSVN_COL_I64, 
+	CSVN_COL_F64, CSVN_COL_TIME or CSVN_COL_BOOL) all its sampled fields 
+	can be converted to, integers within floats being stored as 
+	CSVN_COL_F64, or else CSVN_COL_SPAN. Empty fields fit any type. The 
+	values, sizes and valid of every column are set to NULL, so that 
+	schema can be given right away to a parser (refer to CSVN_COLUMNS). 
+	csv_p itself is left untouched.
+
+	Returns the number of columns of the sampled rows (which may be more 
+	than num_col) or a negative value indicating an error (refer to 
+	csv_err).
+
+*/
+int csvn_infer_schema(const char *text, 
+		      const size_t textlen, 
+		      const struct csv_p *csv_p, 
+		      int rows, 
+		      struct csvn_col *schema, 
+		      int num_col);
+#endif
+
+#ifdef CSVN_SIDECAR
+/*
+
+	Saves the marks the parser has recorded for the provided text into a 
+	sidecar file at path, along with the length of the text and a 
+	checksum of it (which samples its first and last 4 KiB and the end of 
+	every marked row, to be cheap even for huge texts).
+
+	Returns 0 on success or IO_ERROR.
+
+*/
+int csvn_save_marks(const char *path, 
+		    const char *text, 
+		    const size_t textlen, 
+		    const struct csv_p *csv_p);
+
+/*
+
+	Loads the marks of the sidecar file at path into the parser (which 
+	grows its mark pool to hold them), provided they belong to the 
+	provided text (the same length and checksum).
+
+	Returns the number of marks (always greater than or equal to 0) or a 
+	negative value indicating an error (refer to csv_err), IO_ERROR if 
+	the file can not be read or belongs to another text.
+
+*/
+int csvn_load_marks(const char *path, 
+		    const char *text, 
+		    const size_t textlen, 
+		    struct csv_p *csv_p);
+
+/*
+
+	Moves the parser to the latest mark at or before the provided row, 
+	so that parsing goes on from there without parsing the text before. 
+	The parser is reset (refer to csvn_reset) except for its marks and 
+	the number of characters discarded, which text starts after.
+
+	Returns the row the parser is at (always less than or equal to row), 
+	so that row minus it rows are left to skip, or DISCARDED if the text 
+	of that mark has already been discarded (refer to csvn_discard).
+
+*/
+int csvn_seek_row(const char *text, 
+		  const size_t textlen, 
+		  struct csv_p *csv_p, 
+		  int row);
+#endif
+
+#ifdef CSVN_STATS
+/*
+
+	Initialises all counters of the stats to 0.
+
+*/
+void csvn_stats_init(struct csvn_stats *stats);
+#endif
+
+#ifdef CSVN_ARENA
+/*
+
+	Initialises the arena to have no blocks, the first one it allocates 
+	having block characters (or CSVN_ARENA_BLOCK if block is 0).
+
+*/
+void csvn_arena_init(struct csvn_arena *arena, size_t block);
+
+/*
+
+	Returns size characters (aligned to 16) of the arena or NULL if no 
+	block can be allocated.
+
+*/
+void *csvn_arena_alloc(struct csvn_arena *arena, size_t size);
+
+/*
+
+	realloc-like function allocating from the arena ctx (which has to be 
+	given as the ctx of the parser). Since an arena only frees its blocks 
+	all at once, a pool which is grown is moved unless it is the last 
+	allocation of the arena, in which case it grows in place. ptr has to 
+	be NULL or allocated by the arena, which holds for every pool a 
+	parser hands to it (one of the caller is copied instead).
+
+*/
+void *csvn_arena_grow(void *ctx, void *ptr, size_t size);
+
+/*
+
+	Copies the field of the provided token into the arena, with its 
+	escaped quotes (of dialect, or of the default one if NULL) unescaped 
+	unless it already is (non-zero unescaped, for the tokens of 
+	csvn_parse_unescape), and terminated by '\0'.
+
+	Returns the copy or NULL if no block can be allocated.
+
+*/
+char *csvn_copy_field(struct csvn_arena *arena, 
+		      const char *text, 
+		      const struct csv_t *token, 
+		      const struct csvn_dialect *dialect, 
+		      int unescaped);
+
+/*
+
+	Makes all blocks of the arena available again, invalidating all 
+	allocations (so the parsers growing from it have to be initialised 
+	again) without giving any block back.
+
+*/
+void csvn_arena_reset(struct csvn_arena *arena);
+
+/*
+
+	Gives all blocks of the arena back (to free).
+
+*/
+void csvn_arena_free(struct csvn_arena *arena);
+#endif
+
+#ifdef CSVN_MMAP
+/*
+
+	Maps the file at path into memory (read-only) and stores its contents 
+	in the provided (non-NULL) map. An empty file is "mapped" as an empty 
+	text.
+
+	Returns 0 on success or IO_ERROR.
+
+*/
+int csvn_open_mmap(const char *path, struct csvn_mmap *map);
+
+/*
+
+	Gives the pages before position n (usually csvn_discardable) back to 
+	the kernel. The text remains mapped and the tokens parsed so far stay 
+	valid, reading them again merely reads the file again.
+
+*/
+void csvn_release_mmap(struct csvn_mmap *map, size_t n);
+
+/*
+
+	Unmaps the file, after which its text (and its tokens) can no longer 
+	be used.
+
+*/
+void csvn_close_mmap(struct csvn_mmap *map);
+#endif
+
+#ifdef CSVN_PIPELINE
+/*
+
+	Starts a thread reading fd into num_buf (2 to CSVN_PIPELINE_MAX) 
+	buffers of buflen / num_buf characters each, carved out of the 
+	provided buffer. Every read fills at most half of a buffer, the other 
+	half has to hold the characters the parser still needs, i.e. the 
+	longest field.
+
+	Returns 0 on success, OUT_OF_RANGE if the buffers are too few or too 
+	small or IO_ERROR if the thread cannot be started.
+
+*/
+int csvn_start_pipeline(struct csvn_pipeline *pl, int fd, char *buffer, size_t buflen, int num_buf);
+
+#ifdef CSVN_HAS_CODEC
+/*
+
+	Starts a pipeline just like csvn_start_pipeline, whose thread 
+	decompresses the stream it reads block by block: gzip (with 
+	CSVN_GZIP) or zstd (with CSVN_ZSTD), as told by the magic number at 
+	its start, any other stream being passed through as it is. The 
+	provided buffer is split into num_buf + 1 parts, the last one holding 
+	the compressed stream, so the memory of the pipeline stays the same 
+	however long the stream is (besides the state of the decompressor, 
+	allocated by its library).
+
+	A stream which can not be decompressed (or ends within a gzip member 
+	or a zstd frame) fails with IO_ERROR and one whose decompressor can 
+	not be allocated with NOT_ENOUGH_MEM (refer to csvn_next_window).
+
+	Returns 0 on success, OUT_OF_RANGE if the buffers are too few or too 
+	small or IO_ERROR if the thread cannot be started.
+
+*/
+int csvn_start_decoder(struct csvn_pipeline *pl, int fd, char *buffer, size_t buflen, int num_buf);
+#endif
+
+/*
+
+	Waits for the next buffer, into which the characters of the current 
+	window which the parser still needs (refer to csvn_discardable) are 
+	carried, and makes it the window of the pipeline. The parser is told 
+	of the discarded characters and the buffer of the previous window is 
+	given back to the thread to be read into again, so that the tokens of 
+	the previous window are invalidated.
+
+	The window has to be parsed up to its end (with csvn_parse_stream and 
+	the last of the pipeline) before the next one is taken.
+
+	Returns 1 if a window is available, 0 once the last one has been 
+	parsed (and on any later call), FIELD_TOO_LONG if the characters to 
+	carry do not fit in half of a buffer or IO_ERROR if the stream cannot 
+	be read (or another error of the decompressor, refer to 
+	csvn_start_decoder).
+
+*/
+int csvn_next_window(struct csvn_pipeline *pl, struct csv_p *csv_p);
+
+/*
+
+	Returns 1 if csvn_next_window would not wait. Otherwise, returns 0 and 
+	has the thread call on_ready with ctx, once, as soon as the next 
+	window is available (without holding any lock, on the thread). Once 
+	the last window has been taken, csvn_next_window does not wait, so 1 
+	is returned.
+
+*/
+int csvn_notify_window(struct csvn_pipeline *pl, void (*on_ready)(void *), void *ctx);
+
+/*
+
+	Stops the thread and waits for it to finish the read it is blocked 
+	in, if any, and frees the state of its decompressor. The buffer of 
+	the pipeline can be freed afterwards.
+
+*/
+void csvn_stop_pipeline(struct csvn_pipeline *pl);
+#endif
+
+#ifdef CSVN_CONVERT
+/*
+
+	Converts the field of the provided token (an optional sign followed 
+	by decimal digits) to a 64-bit integer stored in out. 
+
+	Runs of 8 digits are converted at once, within a single 64-bit word.
+
+	Returns 0 on success, INVALID_CHARACTER or OUT_OF_RANGE.
+
+*/
+int csvn_to_i64(const char *text, const struct csv_t *token, int64_t *out);
+
+/*
+
+	Converts the field of the provided token (an optional sign, decimal 
+	digits with an optional fraction and an optional exponent) to a 
+	double stored in out.
+
+	Fields of at most 19 significant digits with small exponents, which 
+	are exactly representable, are converted by a multiplication or a 
+	division only. Others are handed to strtod (so the C locale is 
+	expected) and may not be longer than 63 characters.
+
+	Returns 0 on success, INVALID_CHARACTER, OUT_OF_RANGE or 
+	FIELD_TOO_LONG.
+
+*/
+int csvn_to_f64(const char *text, const struct csv_t *token, double *out);
+
+/*
+
+	Converts the field of the provided token, an ISO 8601 date 
+	(YYYY-MM-DD) optionally followed by a time (T or a space, then 
+	hh:mm, :ss and a fraction of a second being optional) and a time 
+	zone (Z, +hh, +hh:mm or +hhmm, or the same with -), to the number 
+	of microseconds since 1970-01-01T00:00:00Z stored in out. Times 
+	without a zone are taken as UTC.
+
+	Returns 0 on success or INVALID_CHARACTER.
+
+*/
+int csvn_to_time(const char *text, const struct csv_t *token, int64_t *out);
+
+/*
+
+	Converts the field of the provided token, true or false (in any 
+	case), to 1 or 0 stored in out.
+
+	Returns 0 on success or INVALID_CHARACTER.
+
+*/
+int csvn_to_bool(const char *text, const struct csv_t *token, int64_t *out);
+
+/*
+
+	Stores the length of the field of the provided token in len and 
+	returns a pointer to its first character, or NULL if the token holds 
+	no field.
+
+*/
+static const char *csvn_span(const char *text, 
+			     const struct csv_t *token, 
+			     size_t *len);
+
+/*
+
+	Converts the 8 decimal digits pointed to by p into value.
+
+	Returns non-zero on success, or 0 if any of the characters is not a 
+	digit.
+
+*/
+static int csvn_eight_digits(const char *p, uint32_t *value);
+
+/*
+
+	Returns the value of the n decimal digits pointed to by p, or -1 if 
+	any of the characters is not a digit.
+
+*/
+static int csvn_digits(const char *p, int n);
+
+/*
+
+	Returns the number of days between 1970-01-01 and the provided date 
+	of the proleptic Gregorian calendar.
+
+*/
+static int64_t csvn_days(int year, int month, int day);
+#endif
+
+void
+csvn_init(struct csv_p *csv_p)
+{
+
+	csv_p->grow = NULL;
+	csv_p->ctx = NULL;
+	csv_p->tokens = NULL;
+	csv_p->num_tok = 0;
+	csv_p->rows = NULL;
+	csv_p->num_row = 0;
+	csv_p->ownrows = 0;
+	csv_p->dialect = NULL;
+	csv_p->unescape = 0;
+#ifdef CSVN_COLUMNS
+	csv_p->columns = NULL;
+	csv_p->num_col = 0;
+	csv_p->num_val = 0;
+	csv_p->owncols = 0;
+#endif
+#ifdef CSVN_PROJECTION
+	csv_p->projection = NULL;
+	csv_p->num_proj = 0;
+#endif
+#ifdef CSVN_FILTER
+	csv_p->preds = NULL;
+	csv_p->num_pred = 0;
+#endif
+#ifdef CSVN_CALLBACKS
+	csv_p->on_field = NULL;
+	csv_p->on_row_end = NULL;
+	csv_p->sink = NULL;
+#endif
+#ifdef CSVN_SIDECAR
+	csv_p->marks = NULL;
+	csv_p->num_mark = 0;
+	csv_p->ownmarks = 0;
+	csv_p->every = 0;
+#endif
+#ifdef CSVN_STATS
+	csv_p->stats = NULL;
+#endif
+
+	csvn_reset(csv_p);
+
+}
+
+void
+csvn_reset(struct csv_p *csv_p)
+{
+
+	csv_p->pos = 0;
+	csv_p->toknext = 0;
+	csv_p->line = 1;
+	csv_p->state = IDLE;
+	csv_p->start = 0;
+	csv_p->tokline = 1;
+	csv_p->rownext = 0;
+	csv_p->linestart = 0;
+	csv_p->escapes = 0;
+#ifdef CSVN_COLUMNS
+	csv_p->colnext = 0;
+	csv_p->colrow = 0;
+#endif
+#ifdef CSVN_FILTER
+	csv_p->rowpass = 0;
+	csv_p->rowseen = 0;
+	csv_p->rejected = 0;
+	csv_p->rowtok = 0;
+	csv_p->rowfields = 0;
+	csv_p->dropped = 0;
+#endif
+#ifdef CSVN_CALLBACKS
+	csv_p->rowopen = 0;
+	csv_p->stopped = 0;
+#endif
+#ifdef CSVN_SIDECAR
+	csv_p->marknext = 0;
+	csv_p->rowcount = 0;
+	csv_p->base = 0;
+#endif
+#ifdef CSVN_COUNT_COLUMNS
+	csv_p->colfield = 0;
+#endif
+
+}
+
+CSVN_INLINE struct csv_t *
+csvn_allocate_token(struct csv_p *csv_p, 
+		    struct csv_t *tokens, 
+		    const size_t num_tok) 
+{
+
+	size_t cap = num_tok;
+
+	/* once the pool has been grown, the provided one is no longer used */
+	if (csv_p->tokens != NULL) {
+		tokens = csv_p->tokens;
+		cap = csv_p->num_tok;
+	}
+
+	/* only a full pool goes through csvn_grow_tokens */
+	if (tokens == NULL || (size_t)csv_p->toknext >= cap) {
+		tokens = csvn_grow_tokens(csv_p, tokens, num_tok, (size_t)csv_p->toknext + 1);
+		if (tokens == NULL) {
+			return NULL;
+		}
+	}
+
+	struct csv_t *token = &tokens[csv_p->toknext++];
+#ifdef CSVN_PACKED
+	token->bits = 0;
+#else
+	token->start = token->end = token->size = 0;
+	token->line = 0;
+	token->token = UNASSIGN;
+#ifdef CSVN_ESCAPED
+	token->escaped = 0;
+#endif
+#endif
+
+	return token;
+
+}
+
+static struct csv_t *
+csvn_grow_tokens(struct csv_p *csv_p, 
+		 struct csv_t *tokens, 
+		 size_t num_tok, 
+		 const size_t need)
+{
+
+	struct csv_t *grown;
+
+	if (csv_p->tokens != NULL) {
+		num_tok = csv_p->num_tok;
+	}
+
+	if (tokens != NULL && need <= num_tok) {
+		return tokens;
+	}
+
+	if (csv_p->grow == NULL) {
+		CSVN_STAT(csv_p, exhausted++);
+		return NULL;
+	}
+
+	if (tokens == NULL) {
+		num_tok = 0;
+	}
+
+	num_tok = (num_tok < 32) ? 64 : 2 * num_tok;
+	if (num_tok < need) {
+		num_tok = need;
+	}
+
+	/* only a pool grown before (kept in tokens) belongs to the parser */
+	grown = (struct csv_t *)csvn_grow_pool(csv_p, tokens, csv_p->tokens != NULL, 
+					       (size_t)csv_p->toknext * sizeof(struct csv_t), 
+					       num_tok * sizeof(struct csv_t));
+	if (grown == NULL) {
+		CSVN_STAT(csv_p, exhausted++);
+		return NULL;
+	}
+	CSVN_STAT(csv_p, grown++);
+
+	csv_p->tokens = grown;
+	csv_p->num_tok = num_tok;
+
+	return grown;
+
+}
+
+static void *
+csvn_grow_pool(struct csv_p *csv_p, 
+	       void *pool, 
+	       int owned, 
+	       size_t used, 
+	       size_t size)
+{
+
+	void *grown;
+
+	if (owned || pool == NULL) {
+		return csv_p->grow(csv_p->ctx, pool, size);
+	}
+
+	grown = csv_p->grow(csv_p->ctx, NULL, size);
+	if (grown != NULL && used > 0) {
+		memcpy(grown, pool, (used < size) ? used : size);
+	}
+
+	return grown;
+
+}
+
+static void
+csvn_fill_token(struct csv_t *csv_t, 
+		csvn_off start, 
+		csvn_off end, 
+		int line, 
+		enum csv_tok token, 
+		int escaped)
+{
+
+#ifdef CSVN_PACKED
+	(void)line;
+	csv_t->bits = (uint64_t)start | 
+		      ((uint64_t)(end - start + 1) << 40) | 
+		      ((uint64_t)(escaped != 0) << 61) | 
+		      ((uint64_t)token << 62);
+#else
+	csv_t->start = start;
+	csv_t->end = end;
+	csv_t->line = line;
+	csv_t->size = (end - start);
+	csv_t->token = token;
+#ifdef CSVN_ESCAPED
+	csv_t->escaped = (escaped != 0);
+#else
+	(void)escaped;
+#endif
+#endif
+
+}
+
+static size_t
+csvn_scan(const char *text, 
+	  size_t pos, 
+	  const size_t textlen, 
+	  char a, 
+	  char b, 
+	  char c, 
+	  char d, 
+	  char e)
+{
+
+#if defined(CSVN_SIMD_AVX2)
+	const __m256i va = _mm256_set1_epi8(a);
+	const __m256i vb = _mm256_set1_epi8(b);
+	const __m256i vc = _mm256_set1_epi8(c);
+	const __m256i vd = _mm256_set1_epi8(d);
+	const __m256i ve = _mm256_set1_epi8(e);
+
+	for (; CSVN_SCAN_FITS(pos, 32, textlen); pos += 32) {
+
+		__m256i v = _mm256_loadu_si256((const __m256i *)(text + pos));
+		__m256i m = _mm256_or_si256(_mm256_or_si256(
+			_mm256_or_si256(_mm256_cmpeq_epi8(v, va), _mm256_cmpeq_epi8(v, vb)),
+			_mm256_or_si256(_mm256_cmpeq_epi8(v, vc), _mm256_cmpeq_epi8(v, vd))),
+			_mm256_cmpeq_epi8(v, ve));
+		unsigned int mask = (unsigned int)_mm256_movemask_epi8(m);
+
+		if (mask != 0) {
+			pos += __builtin_ctz(mask);
+			return (pos < textlen) ? pos : textlen;
+		}
+
+	}
+#elif defined(CSVN_SIMD_SSE2)
+	const __m128i va = _mm_set1_epi8(a);
+	const __m128i vb = _mm_set1_epi8(b);
+	const __m128i vc = _mm_set1_epi8(c);
+	const __m128i vd = _mm_set1_epi8(d);
+	const __m128i ve = _mm_set1_epi8(e);
+
+	for (; CSVN_SCAN_FITS(pos, 16, textlen); pos += 16) {
+
+		__m128i v = _mm_loadu_si128((const __m128i *)(text + pos));
+		__m128i m = _mm_or_si128(_mm_or_si128(
+			_mm_or_si128(_mm_cmpeq_epi8(v, va), _mm_cmpeq_epi8(v, vb)),
+			_mm_or_si128(_mm_cmpeq_epi8(v, vc), _mm_cmpeq_epi8(v, vd))),
+			_mm_cmpeq_epi8(v, ve));
+		unsigned int mask = (unsigned int)_mm_movemask_epi8(m);
+
+		if (mask != 0) {
+			pos += __builtin_ctz(mask);
+			return (pos < textlen) ? pos : textlen;
+		}
+
+	}
+#elif defined(CSVN_SIMD_NEON)
+	const uint8x16_t va = vdupq_n_u8((unsigned char)a);
+	const uint8x16_t vb = vdupq_n_u8((unsigned char)b);
+	const uint8x16_t vc = vdupq_n_u8((unsigned char)c);
+	const uint8x16_t vd = vdupq_n_u8((unsigned char)d);
+	const uint8x16_t ve = vdupq_n_u8((unsigned char)e);
+
+	for (; CSVN_SCAN_FITS(pos, 16, textlen); pos += 16) {
+
+		uint8x16_t v = vld1q_u8((const unsigned char *)(text + pos));
+		uint8x16_t m = vorrq_u8(vorrq_u8(
+				vorrq_u8(vceqq_u8(v, va), vceqq_u8(v, vb)),
+				vorrq_u8(vceqq_u8(v, vc), vceqq_u8(v, vd))),
+				vceqq_u8(v, ve));
+
+		/* narrow every matching byte to a nibble of a 64-bit mask */
+		uint64_t mask = vget_lane_u64(vreinterpret_u64_u8(
+				vshrn_n_u16(vreinterpretq_u16_u8(m), 4)), 0);
+
+		if (mask != 0) {
+			pos += __builtin_ctzll(mask) >> 2;
+			return (pos < textlen) ? pos : textlen;
+		}
+
+	}
+#endif
+
+	for (; pos < textlen; pos++) {
+
+		if (text[pos] == a || text[pos] == b || 
+		    text[pos] == c || text[pos] == d || text[pos] == e) {
+			break;
+		}
+
+	}
+
+	/* the last vector may have gone past the end of a padded text */
+	return (pos < textlen) ? pos : textlen;
+
+}
+
+CSVN_INLINE int
+csvn_emit_token(const char *text, 
+		struct csv_p *csv_p, 
+		struct csv_t *tokpool, 
+		const size_t num_tok, 
+		csvn_off start, 
+		csvn_off end, 
+		int line, 
+		enum csv_tok token, 
+		int escaped)
+{
+
+	struct csv_t *tok;
+	int store = (tokpool != NULL && num_tok != 0) || csv_p->grow != NULL;
+	int res;
+#ifdef CSVN_FILTER
+	int pass = 0;
+#endif
+
+	/* the line stays known after the field, even if its token has none */
+	csv_p->tokline = line;
+#ifdef CSVN_FILTER
+
+	if (csv_p->preds != NULL) {
+
+		pass = csvn_filter_field(text, csv_p, start, end, token);
+		if (pass < 0) {
+			return CSVN_NONE;
+		}
+
+	}
+#endif
+
+	if (!CSVN_SELECTED(csv_p, csv_p->colfield)) {
+		#ifdef CSVN_FILTER
+		csv_p->rowpass += pass;
+		#endif
+		return CSVN_NONE;
+	}
+
+#ifdef CSVN_PACKED
+	if (end - start + 1 > CSVN_PACKED_MAXLEN || 
+	    ((uint64_t)start >> 40) != 0) {
+		return FIELD_TOO_LONG;
+	}
+#endif
+
+	/* opening the row first makes a failed allocation safe to retry */
+	if (csv_p->rows != NULL) {
+
+		res = csvn_open_row(csv_p, line);
+		if (res != 0) {
+			return res;
+		}
+
+	}
+
+#ifdef CSVN_COLUMNS
+	if (csv_p->columns != NULL) {
+
+		if (csvn_open_column_row(csv_p) != 0) {
+			return NOT_ENOUGH_MEM;
+		}
+
+		/* the columns replace the tokens, unless a token pool is provided */
+		if (tokpool == NULL && csv_p->tokens == NULL) {
+			store = 0;
+		}
+
+	}
+#else
+	(void)text;
+#endif
+
+	if (store) {
+
+		/* toknext (and the count of tokens returned) is an int */
+		if (csv_p->toknext == 0x7fffffff) {
+			return OUT_OF_RANGE;
+		}
+
+		tok = csvn_allocate_token(csv_p, tokpool, num_tok);
+		if (tok == NULL) {
+			return NOT_ENOUGH_MEM;
+		}
+
+		csvn_fill_token(tok, start, end, line, token, escaped);
+	}
+
+	if (csv_p->rows != NULL) {
+		csv_p->rows[csv_p->rownext - 1].count++;
+	}
+
+#ifdef CSVN_COLUMNS
+	if (csv_p->columns != NULL) {
+
+		res = csvn_store_field(text, csv_p, start, end, token);
+		if (res != 0) {
+			return res;
+		}
+
+	}
+#endif
+
+	/* the predicates only count once the field cannot fail anymore */
+#ifdef CSVN_FILTER
+	csv_p->rowpass += pass;
+	csv_p->rowfields++;
+#endif
+
+	CSVN_STAT(csv_p, fields[token]++);
+	CSVN_STAT(csv_p, escapes += (size_t)escaped);
+
+#ifdef CSVN_CALLBACKS
+	/* an empty field lies right before the delimiter at its end */
+	csv_p->rowopen = 1;
+	if (csv_p->on_field != NULL && 
+	    ((token == EMPTY) ? csv_p->on_field(csv_p->sink, end, 0, token) : 
+	     csv_p->on_field(csv_p->sink, start, end - start + 1, token)) != 0) {
+		csv_p->stopped = 1;
+	}
+#endif
+
+	return CSVN_FIELD;
+
+}
+
+static int
+csvn_grow_rows(struct csv_p *csv_p, const size_t need)
+{
+
+	struct csv_r *grown;
+	size_t num_row;
+
+	if (need <= csv_p->num_row) {
+		return 0;
+	}
+
+	if (csv_p->grow == NULL) {
+		CSVN_STAT(csv_p, exhausted++);
+		return NOT_ENOUGH_MEM;
+	}
+
+	num_row = (csv_p->num_row < 16) ? 32 : 2 * csv_p->num_row;
+	if (num_row < need) {
+		num_row = need;
+	}
+
+	grown = (struct csv_r *)csvn_grow_pool(csv_p, csv_p->rows, csv_p->ownrows, 
+					       (size_t)csv_p->rownext * sizeof(struct csv_r), 
+					       num_row * sizeof(struct csv_r));
+	if (grown == NULL) {
+		CSVN_STAT(csv_p, exhausted++);
+		return NOT_ENOUGH_MEM;
+	}
+	CSVN_STAT(csv_p, grown++);
+
+	csv_p->rows = grown;
+	csv_p->num_row = num_row;
+	csv_p->ownrows = 1;
+
+	return 0;
+
+}
+
+static int
+csvn_open_row(struct csv_p *csv_p, int line)
+{
+
+	struct csv_r *row;
+
+	/* the row of the current line is already open */
+	if (csv_p->rownext > 0 && 
+	    csv_p->rows[csv_p->rownext - 1].offset == csv_p->linestart) {
+		return 0;
+	}
+
+	if (csv_p->rownext == 0x7fffffff) {
+		return OUT_OF_RANGE;
+	}
+
+	if (csvn_grow_rows(csv_p, (size_t)csv_p->rownext + 1) != 0) {
+		return NOT_ENOUGH_MEM;
+	}
+
+	row = &csv_p->rows[csv_p->rownext++];
+	row->token = csv_p->toknext;
+	row->count = 0;
+	row->offset = csv_p->linestart;
+	row->line = line;
+
+	return 0;
+
+}
+
+CSVN_INLINE void
+csvn_unescape_move(const char *text, 
+		   struct csv_p *csv_p, 
+		   csvn_off from, 
+		   csvn_off to)
+{
+
+	/* csvn_parse_unescape has been given a mutable text */
+	if (csv_p->unescape && csv_p->escapes != 0 && to > from) {
+		memmove((char *)text + from - csv_p->escapes, text + from, 
+			(size_t)(to - from));
+	}
+
+}
+
+#ifdef CSVN_COLUMNS
+static int
+csvn_grow_columns(struct csv_p *csv_p, const size_t need)
+{
+
+	struct csvn_col *col;
+	size_t num_val, width;
+	void *grown;
+	int i;
+
+	if (need <= csv_p->num_val) {
+		return 0;
+	}
+
+	if (csv_p->grow == NULL) {
+		return NOT_ENOUGH_MEM;
+	}
+
+	num_val = (csv_p->num_val < 32) ? 64 : 2 * csv_p->num_val;
+	if (num_val < need) {
+		num_val = need;
+	}
+
+	/* a column which has been grown keeps its new buffers even if another one fails */
+	for (i = 0; i < csv_p->num_col; i++) {
+
+		col = &csv_p->columns[i];
+		width = (col->type == CSVN_COL_SPAN) ? sizeof(csvn_off) : 
+			(col->type == CSVN_COL_F64) ? sizeof(double) : sizeof(int64_t);
+
+		grown = csvn_grow_column(csv_p, col->values, 3 * i, 
+					 csv_p->colnext * width, num_val * width);
+		if (grown == NULL) {
+			return NOT_ENOUGH_MEM;
+		}
+		col->values = grown;
+
+		if (col->type == CSVN_COL_SPAN) {
+			grown = csvn_grow_column(csv_p, col->sizes, 3 * i + 1, 
+						 csv_p->colnext * sizeof(csvn_off), 
+						 num_val * sizeof(csvn_off));
+			if (grown == NULL) {
+				return NOT_ENOUGH_MEM;
+			}
+			col->sizes = (csvn_off *)grown;
+		}
+
+		grown = csvn_grow_column(csv_p, col->valid, 3 * i + 2, 
+					 (csv_p->num_val + 7) / 8, (num_val + 7) / 8);
+		if (grown == NULL) {
+			return NOT_ENOUGH_MEM;
+		}
+		col->valid = (unsigned char *)grown;
+
+	}
+
+	csv_p->num_val = num_val;
+	CSVN_STAT(csv_p, grown++);
+
+	return 0;
+
+}
+
+static void *
+csvn_grow_column(struct csv_p *csv_p, 
+		 void *buffer, 
+		 int slot, 
+		 size_t used, 
+		 size_t size)
+{
+
+	void *grown;
+
+	/* the buffers are grown in order, so the ones of the parser come first */
+	grown = csvn_grow_pool(csv_p, buffer, slot < csv_p->owncols, used, size);
+	if (grown != NULL && slot >= csv_p->owncols) {
+		csv_p->owncols = slot + 1;
+	}
+
+	return grown;
+
+}
+
+static int
+csvn_open_column_row(struct csv_p *csv_p)
+{
+
+	size_t row = csv_p->colnext;
+	int i;
+
+	if (row > 0 && csv_p->colrow == csv_p->linestart) {
+		return 0;
+	}
+
+	if (csvn_grow_columns(csv_p, row + 1) != 0) {
+		return NOT_ENOUGH_MEM;
+	}
+
+	/* the row (and the ones after it) has no values until its fields are stored */
+	for (i = 0; i < csv_p->num_col && row % 8 == 0; i++) {
+		csv_p->columns[i].valid[row / 8] = 0;
+	}
+
+	csv_p->colrow = csv_p->linestart;
+	csv_p->colnext++;
+
+	return 0;
+
+}
+
+static int
+csvn_store_field(const char *text, 
+		 struct csv_p *csv_p, 
+		 csvn_off start, 
+		 csvn_off end, 
+		 enum csv_tok token)
+{
+
+	struct csvn_col *col;
+	struct csv_t field;
+	size_t row = csv_p->colnext - 1;
+	int res = 0;
+
+	if (csv_p->colfield >= csv_p->num_col) {
+		return 0;
+	}
+
+	col = &csv_p->columns[csv_p->colfield];
+
+	if (token == EMPTY) {
+		return 0;
+	}
+
+	csvn_fill_token(&field, start, end, 0, token, 0);
+
+	switch (col->type) {
+
+	case CSVN_COL_I64:
+		res = csvn_to_i64(text, &field, (int64_t *)col->values + row);
+		break;
+
+	case CSVN_COL_F64:
+		res = csvn_to_f64(text, &field, (double *)col->values + row);
+		break;
+
+	case CSVN_COL_TIME:
+		res = csvn_to_time(text, &field, (int64_t *)col->values + row);
+		break;
+
+	case CSVN_COL_BOOL:
+		res = csvn_to_bool(text, &field, (int64_t *)col->values + row);
+		break;
+
+	default:
+		((csvn_off *)col->values)[row] = start;
+		col->sizes[row] = end - start;
+		break;
+
+	}
+
+	if (res != 0) {
+		return res;
+	}
+
+	col->valid[row / 8] |= (unsigned char)(1u << (row % 8));
+
+	return 0;
+
+}
+#endif
+
+#ifdef CSVN_FILTER
+static int
+csvn_match(const char *text, 
+	   csvn_off start, 
+	   csvn_off end, 
+	   enum csv_tok token, 
+	   const struct csvn_pred *pred)
+{
+
+	struct csv_t field;
+	double value;
+	size_t len = (token == EMPTY) ? 0 : (size_t)(end - start + 1);
+
+	switch (pred->type) {
+
+	case CSVN_PRED_EQUALS:
+		return len == pred->len && memcmp(text + start, pred->text, len) == 0;
+
+	case CSVN_PRED_PREFIX:
+		return len >= pred->len && memcmp(text + start, pred->text, pred->len) == 0;
+
+	default:
+		/* no number csvn_to_f64 takes is that long */
+		if (token == EMPTY || len > 64) {
+			return 0;
+		}
+
+		csvn_fill_token(&field, start, end, 0, token, 0);
+
+		return csvn_to_f64(text, &field, &value) == 0 && 
+		       value >= pred->min && value <= pred->max;
+
+	}
+
+}
+
+static int
+csvn_filter_field(const char *text, 
+		  struct csv_p *csv_p, 
+		  csvn_off start, 
+		  csvn_off end, 
+		  enum csv_tok token)
+{
+
+	int i, pass = 0;
+
+	if (csv_p->rejected) {
+		return -1;
+	}
+
+	csv_p->rowseen = 1;
+
+	for (i = 0; i < csv_p->num_pred; i++) {
+
+		if (csv_p->preds[i].column != csv_p->colfield) {
+			continue;
+		}
+
+		if (!csvn_match(text, start, end, token, &csv_p->preds[i])) {
+			csvn_drop_row(csv_p);
+			return -1;
+		}
+
+		pass++;
+
+	}
+
+	return pass;
+
+}
+
+static int
+csvn_tested(const struct csv_p *csv_p, int col)
+{
+
+	int i;
+
+	for (i = 0; i < csv_p->num_pred; i++) {
+		if (csv_p->preds[i].column == col) {
+			return 1;
+		}
+	}
+
+	return 0;
+
+}
+
+static void
+csvn_drop_row(struct csv_p *csv_p)
+{
+
+#ifdef CSVN_COLUMNS
+	size_t row;
+	int i;
+#endif
+
+	/* tokens returned by an earlier call of csvn_parse_stream are kept */
+	csv_p->rejected = 1;
+	csv_p->toknext = csv_p->rowtok;
+	csv_p->dropped += csv_p->rowfields;
+	csv_p->rowfields = 0;
+
+	if (csv_p->rows != NULL && csv_p->rownext > 0 && 
+	    csv_p->rows[csv_p->rownext - 1].offset == csv_p->linestart) {
+		csv_p->rownext--;
+	}
+
+#ifdef CSVN_COLUMNS
+	if (csv_p->columns != NULL && csv_p->colnext > 0 && 
+	    csv_p->colrow == csv_p->linestart) {
+
+		row = --csv_p->colnext;
+		for (i = 0; i < csv_p->num_col; i++) {
+			csv_p->columns[i].valid[row / 8] &= (unsigned char)~(1u << (row % 8));
+		}
+		csv_p->colrow = -1;
+
+	}
+#endif
+
+}
+
+#endif
+
+#ifdef CSVN_ROW_HOOK
+static void
+csvn_end_row(struct csv_p *csv_p)
+{
+
+#ifdef CSVN_FILTER
+	if (csv_p->rowseen && !csv_p->rejected && csv_p->rowpass < csv_p->num_pred) {
+		csvn_drop_row(csv_p);
+	}
+#endif
+
+#ifdef CSVN_CALLBACKS
+	/* a dropped row has been taken back, so its end is not reported */
+	#ifdef CSVN_FILTER
+	if (csv_p->rejected) {
+		csv_p->rowopen = 0;
+	}
+	#endif
+	if (csv_p->rowopen && csv_p->on_row_end != NULL) {
+		csv_p->on_row_end(csv_p->sink);
+	}
+	csv_p->rowopen = 0;
+#endif
+
+#ifdef CSVN_FILTER
+	csv_p->rowpass = 0;
+	csv_p->rowseen = 0;
+	csv_p->rejected = 0;
+	csv_p->rowfields = 0;
+	csv_p->rowtok = csv_p->toknext;
+#endif
+
+}
+
+static void
+csvn_next_row(struct csv_p *csv_p)
+{
+
+	csvn_end_row(csv_p);
+	#ifdef CSVN_COUNT_COLUMNS
+	csv_p->colfield = 0;
+	#endif
+
+}
+#endif
+
+CSVN_INLINE int
+csvn_parse_quotes(const char *text, 
+		  const size_t textlen, 
+		  struct csv_p *csv_p, 
+		  struct csv_t *tokpool, 
+		  const size_t num_tok, 
+		  const int more, 
+		  const struct csvn_dialect *d)
+{
+		
+	int res;
+	csvn_off from = csv_p->pos;
+
+	for (;;) {
+
+		/* only quotes and newlines (for line counting) are of interest here */
+		csv_p->pos = csvn_scan(text, csv_p->pos, textlen, 
+				       d->quote, d->newline, CSVN_OR_CR(d), 
+				       CSVN_OR_NUL(d->quote), CSVN_OR_NUL(d->quote));
+
+		if ((size_t)csv_p->pos >= textlen) {
+
+			if (more) {
+				csvn_unescape_move(text, csv_p, from, csv_p->pos);
+				return CSVN_MORE;
+			}
+			break;
+
+		}
+
+		#ifndef CSVN_LENGTH_ONLY
+		if (text[csv_p->pos] == '\0') {
+			break;
+		}
+		#endif
+
+		if (text[csv_p->pos] == d->quote) {
+
+			/* whether the quote is escaped depends on the next character */
+			if ((size_t)csv_p->pos + 1 >= textlen && more) {
+				csvn_unescape_move(text, csv_p, from, csv_p->pos);
+				return CSVN_MORE;
+			}
+
+			if ((size_t)csv_p->pos + 1 < textlen && text[csv_p->pos + 1] == d->quote) {
+				/* the first quote of the pair is kept, the second one dropped */
+				csvn_unescape_move(text, csv_p, from, csv_p->pos + 1);
+				csv_p->escapes++;
+				csv_p->pos += 2;
+				from = csv_p->pos;
+				continue;
+			}
+
+			break;
+
+		}
+		
+		/* newline ("\r\n" counts once, so a trailing '\r' waits for more) */
+		if ((d->flags & CSVN_DIALECT_CRLF) && text[csv_p->pos] == '\r') {
+
+			if ((size_t)csv_p->pos + 1 >= textlen && more) {
+				csvn_unescape_move(text, csv_p, from, csv_p->pos);
+				return CSVN_MORE;
+			}
+
+			if ((size_t)csv_p->pos + 1 < textlen && text[csv_p->pos + 1] == '\n') {
+				csv_p->pos++;
+			}
+
+		}
+
+		if (d->flags & CSVN_DIALECT_CONSIDER_NL) {
+			csv_p->tokline++;
+		}
+		csv_p->line++;
+		CSVN_STAT(csv_p, multiline++);
+
+		csv_p->pos++;
+		
+	}
+
+	/* curent pos is at the closing quote */
+	csvn_unescape_move(text, csv_p, from, csv_p->pos);
+	res = csvn_emit_token(text, csv_p, tokpool, num_tok, csv_p->start, 
+			      csv_p->pos - 1 - (csv_p->unescape ? csv_p->escapes : 0), 
+			      csv_p->tokline, DQUOTE, csv_p->escapes);
+	if (res < 0) {
+		return res;
+	}
+
+	/* skip closing quote (unless the field was never closed) */
+	if ((size_t)csv_p->pos < textlen && text[csv_p->pos] == d->quote) {
+		csv_p->pos++;
+	}
+
+	csv_p->state = (d->flags & CSVN_DIALECT_STRICT) ? AFTER_DQUOTE : IDLE;
+
+	return res;
+
+}
+
+CSVN_INLINE int 
+csvn_parse_closed(const char *text, 
+		  const size_t textlen, 
+		  struct csv_p *csv_p, 
+		  const int more, 
+		  const struct csvn_dialect *d)
+{
+
+	if ((size_t)csv_p->pos >= textlen) {
+
+		if (more) {
+			return CSVN_MORE;
+		}
+
+	} else if (text[csv_p->pos] != d->delim && 
+		   text[csv_p->pos] != d->newline && 
+		   text[csv_p->pos] != CSVN_OR_CR(d) && 
+		   text[csv_p->pos] != CSVN_OR_NUL(d->delim)) {
+
+		/* closing quote has to be followed by a delimiter, newline or end of file */
+		return INVALID_CHARACTER;
+
+	}
+
+	csv_p->state = IDLE;
+
+	return CSVN_NONE;
+
+}
+
+CSVN_INLINE int 
+csvn_parse_normal(const char *text, 
+		  const size_t textlen, 
+		  struct csv_p *csv_p, 
+		  struct csv_t *tokpool, 
+		  const size_t num_tok, 
+		  const int more, 
+		  const struct csvn_dialect *d)
+{
+
+	int res;
+#if defined(CSVN_PROJECTION) || defined(CSVN_FILTER)
+	char c;
+#endif
+
+	for (;;) {
+
+		if (d->flags & CSVN_DIALECT_STRICT) {
+
+			csv_p->pos = csvn_scan(text, csv_p->pos, textlen, 
+					       CSVN_OR_NUL(d->delim), d->newline, d->delim, d->quote, 
+					       CSVN_OR_CR(d));
 		
-		token = csvn_allocate_token(csv_p, tokpool, num_tok);
-		if (token == NULL) {
-			return NOT_ENOUGH_MEM; 
+			if ((size_t)csv_p->pos < textlen && text[csv_p->pos] == d->quote) {
+				return INVALID_CHARACTER;
+			}
+
+		} else {
+
+			csv_p->pos = csvn_scan(text, csv_p->pos, textlen, 
+					       CSVN_OR_NUL(d->delim), d->newline, d->delim, 
+					       CSVN_OR_NUL(d->delim), CSVN_OR_CR(d));
+
+		}
+
+#if defined(CSVN_PROJECTION) || defined(CSVN_FILTER)
+		/* 
+		   a skipped field followed by another unquoted one to be skipped 
+		   (or any field of a dropped row) goes straight on to the next 
+		   delimiter
+		*/
+		if ((size_t)csv_p->pos + 1 < textlen && text[csv_p->pos] == d->delim && 
+		    CSVN_SKIPPED(csv_p, csv_p->colfield) && 
+		    CSVN_SKIPPED(csv_p, csv_p->colfield + 1)) {
+
+			c = text[csv_p->pos + 1];
+			if (c != d->delim && c != d->newline && c != d->quote && 
+			    c != CSVN_OR_CR(d) && c != CSVN_OR_NUL(d->delim) && 
+			    !(c == ' ' && (d->flags & CSVN_DIALECT_SKIP_WHITESPACE))) {
+				csv_p->pos++;
+				CSVN_NEXT_COLUMN(csv_p);
+				continue;
+			}
+
+		}
+#endif
+
+		break;
+
+	}
+
+	if ((size_t)csv_p->pos >= textlen && more) {
+		return CSVN_MORE;
+	}
+
+	/* let the main loop handle whatever ended the field */
+	res = csvn_emit_token(text, csv_p, tokpool, num_tok, 
+			      csv_p->start, csv_p->pos - 1, csv_p->tokline, TEXT, 0);
+	if (res < 0) {
+		return res;
+	}
+
+	csv_p->state = IDLE;
+
+	return res;
+
+}
+
+CSVN_INLINE int
+csvn_parse_delim(const char *text, 
+		 const size_t textlen, 
+		 struct csv_p *csv_p, 
+		 struct csv_t *tokpool, 
+		 const size_t num_tok, 
+		 const int more, 
+		 const struct csvn_dialect *d)
+{
+
+	int res;
+
+	if (d->flags & CSVN_DIALECT_SKIP_WHITESPACE) {
+		while ((size_t)csv_p->pos < textlen && text[csv_p->pos] == ' ') {
+			csv_p->pos++;
+		}
+	}
+
+	if ((size_t)csv_p->pos >= textlen && more) {
+		return CSVN_MORE;
+	}
+
+	csv_p->state = IDLE;
+
+	if ((size_t)csv_p->pos < textlen && text[csv_p->pos] == d->delim) {
+
+		if (d->flags & CSVN_DIALECT_NO_EMPTY_FIELD) {
+			return INVALID_CHARACTER;
+		}
+
+		if (d->flags & CSVN_DIALECT_IGNORE_EMPTY_FIELD) {
+			return CSVN_NONE;
+		}
+
+		res = csvn_emit_token(text, csv_p, tokpool, num_tok, 
+				      csv_p->pos - 1, csv_p->pos, csv_p->line, EMPTY, 0);
+		if (res < 0) {
+			csv_p->state = AFTER_DELIM;
+		}
+
+		return res;
+
+	}
+
+	return CSVN_NONE;
+
+}
+
+static int 
+csvn_parse_cr(const char *text, 
+	      const size_t textlen, 
+	      struct csv_p *csv_p, 
+	      const int more)
+{
+
+	if ((size_t)csv_p->pos >= textlen) {
+
+		if (more) {
+			return CSVN_MORE;
+		}
+
+	} else if (text[csv_p->pos] == '\n') {
+
+		csv_p->pos++;
+		csv_p->linestart = csv_p->pos;
+
+	}
+
+	csv_p->state = IDLE;
+
+	return CSVN_NONE;
+
+}
+
+CSVN_INLINE int
+csvn_parse_dialect(const char *text, 
+		   const size_t textlen, 
+		   struct csv_p *csv_p, 
+		   struct csv_t *tokpool, 
+		   const size_t num_tok, 
+		   const int more, 
+		   const struct csvn_dialect *d)
+{
+
+	int parsed = 0;
+	int res = 0;
+	char c;
+
+	if (CSVN_FILTERED_CALLBACKS(csv_p)) {
+		return INVALID_SETTINGS;
+	}
+
+#ifdef CSVN_FILTER
+	csv_p->rowfields = 0;
+	csv_p->dropped = 0;
+#endif
+
+	for (;;) {
+	
+		switch (csv_p->state) {
+
+		case AFTER_DELIM:
+			res = csvn_parse_delim(text, textlen, csv_p, tokpool, num_tok, more, d);
+			break;
+
+		case IN_TEXT:
+			res = csvn_parse_normal(text, textlen, csv_p, tokpool, num_tok, more, d);
+			break;
+
+		case IN_DQUOTE:
+			res = csvn_parse_quotes(text, textlen, csv_p, tokpool, num_tok, more, d);
+			break;
+
+		case AFTER_DQUOTE:
+			res = csvn_parse_closed(text, textlen, csv_p, more, d);
+			break;
+
+		case AFTER_CR:
+			res = csvn_parse_cr(text, textlen, csv_p, more);
+			break;
+
+		default:
+			#ifdef CSVN_LENGTH_ONLY
+			if ((size_t)csv_p->pos >= textlen) {
+			#else
+			if ((size_t)csv_p->pos >= textlen || text[csv_p->pos] == '\0') {
+			#endif
+				#ifdef CSVN_ROW_HOOK
+				/* the text ends the last row as well */
+				if (!more) {
+					csvn_end_row(csv_p);
+				}
+				#endif
+				#ifdef CSVN_FILTER
+				parsed -= csv_p->dropped;
+				#endif
+				return parsed;
+			}
+
+			c = text[csv_p->pos];
+
+			/* the mark comes first, so that a failed one is safe to retry */
+			if (((d->flags & CSVN_DIALECT_CRLF) && c == '\r') || c == d->newline) {
+				res = CSVN_MARK_ROW(csv_p, csv_p->pos, csv_p->line);
+				if (res != 0) {
+					return res;
+				}
+			}
+
+			if ((d->flags & CSVN_DIALECT_CRLF) && c == '\r') {
+
+				CSVN_NEXT_ROW(csv_p);
+				csv_p->line++;
+				csv_p->pos++;
+				csv_p->linestart = csv_p->pos;
+				csv_p->state = AFTER_CR;
+
+			} else if (c == d->newline) {
+
+				CSVN_NEXT_ROW(csv_p);
+				csv_p->line++;
+				csv_p->pos++;
+				csv_p->linestart = csv_p->pos;
+
+			} else if (c == d->delim) {
+
+				csv_p->pos++;
+				csv_p->state = AFTER_DELIM;
+				CSVN_NEXT_COLUMN(csv_p);
+
+			} else if (c == d->quote) {
+
+				csv_p->pos++; /* skip opening quote */
+				csv_p->start = csv_p->pos;
+				csv_p->escapes = 0;
+				csv_p->tokline = csv_p->line;
+				csv_p->state = IN_DQUOTE;
+
+			} else {
+
+				csv_p->start = csv_p->pos;
+				csv_p->tokline = csv_p->line;
+				csv_p->state = IN_TEXT;
+
+			}
+			continue;
+
+		}
+
+		if (res < 0) {
+			return res;
+		}
+
+		if (res == CSVN_MORE) {
+			#ifdef CSVN_FILTER
+			parsed -= csv_p->dropped;
+			#endif
+			return parsed;
+		}
+
+		if (res == CSVN_FIELD) {
+			/* the number of fields is returned as an int */
+			if (parsed == 0x7fffffff) {
+				return OUT_OF_RANGE;
+			}
+			parsed++;
+		}
+
+		#ifdef CSVN_CALLBACKS
+		if (csv_p->stopped) {
+			csv_p->stopped = 0;
+			#ifdef CSVN_FILTER
+			parsed -= csv_p->dropped;
+			#endif
+			return parsed;
+		}
+		#endif
+
+	}
+
+}
+
+CSVN_INLINE int
+csvn_parse_common(const char *text, 
+		  const size_t textlen, 
+		  struct csv_p *csv_p, 
+		  struct csv_t *tokpool, 
+		  const size_t num_tok, 
+		  const int more)
+{
+
+	static const struct csvn_dialect csv = { ',', CSVN_NEWLINE, '\"', CSVN_DEFAULT_FLAGS };
+	static const struct csvn_dialect tsv = { '\t', CSVN_NEWLINE, '\"', CSVN_DEFAULT_FLAGS };
+	static const struct csvn_dialect psv = { '|', CSVN_NEWLINE, '\"', CSVN_DEFAULT_FLAGS };
+	static const struct csvn_dialect ssv = { ';', CSVN_NEWLINE, '\"', CSVN_DEFAULT_FLAGS };
+
+	const struct csvn_dialect *d = csv_p->dialect;
+
+	if (d == NULL) {
+		return csvn_parse_dialect(text, textlen, csv_p, tokpool, num_tok, more, 
+					  csvn_dialect_of(NULL));
+	} else if (csvn_same_dialect(d, &csv)) {
+		return csvn_parse_dialect(text, textlen, csv_p, tokpool, num_tok, more, &csv);
+	} else if (csvn_same_dialect(d, &tsv)) {
+		return csvn_parse_dialect(text, textlen, csv_p, tokpool, num_tok, more, &tsv);
+	} else if (csvn_same_dialect(d, &psv)) {
+		return csvn_parse_dialect(text, textlen, csv_p, tokpool, num_tok, more, &psv);
+	} else if (csvn_same_dialect(d, &ssv)) {
+		return csvn_parse_dialect(text, textlen, csv_p, tokpool, num_tok, more, &ssv);
+	}
+
+	return csvn_parse_dialect(text, textlen, csv_p, tokpool, num_tok, more, d);
+
+}
+
+static int
+csvn_parse_text(const char *text, 
+		const size_t textlen, 
+		struct csv_p *csv_p, 
+		struct csv_t *tokpool, 
+		const size_t num_tok, 
+		const int more)
+{
+
+#ifdef CSVN_STATS
+	csvn_off from = csv_p->pos;
+#endif
+	int res;
+
+	CSVN_TRACE_BEGIN(parse);
+
+	if (more) {
+		res = csvn_parse_common(text, textlen, csv_p, tokpool, num_tok, 1);
+	} else {
+		res = csvn_parse_common(text, textlen, csv_p, tokpool, num_tok, 0);
+	}
+
+	CSVN_STAT(csv_p, calls++);
+	CSVN_STAT(csv_p, bytes += (size_t)(csv_p->pos - from));
+	CSVN_TRACE_END(parse);
+
+	return res;
+
+}
+
+CSVN_INLINE const struct csvn_dialect *
+csvn_dialect_of(const struct csvn_dialect *dialect)
+{
+
+	static const struct csvn_dialect macros = { CSVN_DELIM, CSVN_NEWLINE, '\"', CSVN_DEFAULT_FLAGS };
+
+	return (dialect != NULL) ? dialect : &macros;
+
+}
+
+static int
+csvn_same_dialect(const struct csvn_dialect *a, 
+		  const struct csvn_dialect *b)
+{
+
+	return a->delim == b->delim && a->newline == b->newline && 
+	       a->quote == b->quote && a->flags == b->flags;
+
+}
+
+void
+csvn_dialect_init(struct csvn_dialect *dialect)
+{
+
+	*dialect = *csvn_dialect_of(NULL);
+
+}
+
+int
+csvn_parse(const char *text, 
+	   const size_t textlen, 
+	   struct csv_p *csv_p, 
+	   struct csv_t *tokpool, 
+	   const size_t num_tok)
+{
+
+	return csvn_parse_text(text, textlen, csv_p, tokpool, num_tok, 0);
+
+}
+
+int
+csvn_parse_unescape(char *text, 
+		    const size_t textlen, 
+		    struct csv_p *csv_p, 
+		    struct csv_t *tokpool, 
+		    const size_t num_tok)
+{
+
+	int res;
+
+	csv_p->unescape = 1;
+	res = csvn_parse_text(text, textlen, csv_p, tokpool, num_tok, 0);
+	csv_p->unescape = 0;
+
+	return res;
+
+}
+
+int
+csvn_parse_stream(const char *text, 
+		  const size_t textlen, 
+		  struct csv_p *csv_p, 
+		  struct csv_t *tokpool, 
+		  const size_t num_tok, 
+		  const int last)
+{
+
+#ifdef CSVN_FILTER
+	/* the tokens returned by the calls before are not taken back */
+	csv_p->rowtok = csv_p->toknext;
+#endif
+
+	return csvn_parse_text(text, textlen, csv_p, tokpool, num_tok, !last);
+
+}
+
+#ifdef CSVN_CALLBACKS
+static int
+csvn_iter_field(void *sink, csvn_off start, csvn_off len, enum csv_tok kind)
+{
+
+	(void)sink;
+	(void)start;
+	(void)len;
+	(void)kind;
+
+	return 1;
+
+}
+
+static void
+csvn_iter_row(void *sink)
+{
+
+	((struct csvn_iter *)sink)->row++;
+
+}
+
+void
+csvn_iter_init(struct csvn_iter *it, const char *text, const size_t textlen)
+{
+
+	csvn_init(&it->parser);
+	it->parser.on_field = csvn_iter_field;
+	it->parser.on_row_end = csvn_iter_row;
+	it->parser.sink = it;
+	it->text = text;
+	it->textlen = textlen;
+	it->row = 0;
+
+}
+
+int
+csvn_next_field(struct csvn_iter *it, struct csv_t *tok)
+{
+
+	/* every field is pulled into the same single token */
+	it->parser.toknext = 0;
+	#ifdef CSVN_FILTER
+	it->parser.rowtok = 0;
+	#endif
+
+	return csvn_parse_text(it->text, it->textlen, &it->parser, tok, 1, 0);
+
+}
+#endif
+
+#ifdef CSVN_HEADER
+void
+csvn_header_init(struct csvn_hdr *hdr)
+{
+
+	hdr->names = NULL;
+	hdr->num_chars = 0;
+	hdr->ends = NULL;
+	hdr->num_ends = 0;
+	hdr->num_col = 0;
+	hdr->slots = NULL;
+	hdr->num_slots = 0;
+
+}
+
+static size_t
+csvn_hash(const char *name, size_t len)
+{
+
+	uint32_t h = 2166136261u;
+	size_t i;
+
+	for (i = 0; i < len; i++) {
+		h ^= (unsigned char)name[i];
+		h *= 16777619u;
+	}
+
+	return (size_t)h;
+
+}
+
+static int
+csvn_add_column(struct csvn_hdr *hdr, 
+		struct csv_p *csv_p, 
+		const char *name, 
+		size_t len, 
+		enum csv_tok kind, 
+		char quote)
+{
+
+	size_t used = (hdr->num_col > 0) ? hdr->ends[hdr->num_col - 1] : 0;
+	size_t size, i;
+	void *grown;
+
+	if ((size_t)hdr->num_col >= hdr->num_ends) {
+		size = (hdr->num_ends > 0) ? hdr->num_ends * 2 : 16;
+		grown = csv_p->grow(csv_p->ctx, hdr->ends, size * sizeof(size_t));
+		if (grown == NULL) {
+			return NOT_ENOUGH_MEM;
+		}
+		hdr->ends = (size_t *)grown;
+		hdr->num_ends = size;
+	}
+
+	if (used + len > hdr->num_chars) {
+		size = (hdr->num_chars > 0) ? hdr->num_chars : 64;
+		while (size < used + len) {
+			size *= 2;
+		}
+		grown = csv_p->grow(csv_p->ctx, hdr->names, size);
+		if (grown == NULL) {
+			return NOT_ENOUGH_MEM;
+		}
+		hdr->names = (char *)grown;
+		hdr->num_chars = size;
+	}
+
+	/* every escaped quote (only quoted names have any) is stored as a single one */
+	for (i = 0; i < len; i++) {
+		hdr->names[used++] = name[i];
+		if (kind == DQUOTE && name[i] == quote && i + 1 < len && name[i + 1] == quote) {
+			i++;
+		}
+	}
+
+	hdr->ends[hdr->num_col++] = used;
+
+	return 0;
+
+}
+
+static int
+csvn_hash_columns(struct csvn_hdr *hdr, struct csv_p *csv_p)
+{
+
+	size_t size = 8, from, len, slot;
+	void *grown;
+	int i;
+
+	/* at most half of the slots are used, which keeps the probes short */
+	while (size < (size_t)hdr->num_col * 2) {
+		size *= 2;
+	}
+
+	if (size > hdr->num_slots) {
+		grown = csv_p->grow(csv_p->ctx, hdr->slots, size * sizeof(int));
+		if (grown == NULL) {
+			return NOT_ENOUGH_MEM;
+		}
+		hdr->slots = (int *)grown;
+		hdr->num_slots = size;
+	}
+	memset(hdr->slots, 0, hdr->num_slots * sizeof(int));
+
+	for (i = 0; i < hdr->num_col; i++) {
+
+		from = (i > 0) ? hdr->ends[i - 1] : 0;
+		len = hdr->ends[i] - from;
+
+		/* a duplicate name keeps mapping to its first column */
+		if (csvn_column_index(hdr, hdr->names + from, len) >= 0) {
+			continue;
+		}
+
+		slot = csvn_hash(hdr->names + from, len) & (hdr->num_slots - 1);
+		while (hdr->slots[slot] != 0) {
+			slot = (slot + 1) & (hdr->num_slots - 1);
+		}
+		hdr->slots[slot] = i + 1;
+
+	}
+
+	return 0;
+
+}
+
+static int
+csvn_header_field(void *sink, csvn_off start, csvn_off len, enum csv_tok kind)
+{
+
+	struct csvn_hdr_ctx *ctx = (struct csvn_hdr_ctx *)sink;
+	const struct csvn_dialect *d = csvn_dialect_of(ctx->parser->dialect);
+	int res;
+
+	/* the first field after the header is left to the caller */
+	if (ctx->done) {
+		return 1;
+	}
+
+	/* an empty field at the start of the row has no token of its own */
+	while (ctx->hdr->num_col < ctx->parser->colfield) {
+		res = csvn_add_column(ctx->hdr, ctx->csv_p, NULL, 0, EMPTY, d->quote);
+		if (res < 0) {
+			ctx->res = res;
+			return 1;
+		}
+	}
+
+	res = csvn_add_column(ctx->hdr, ctx->csv_p, ctx->text + start, (size_t)len, kind, d->quote);
+	if (res < 0) {
+		ctx->res = res;
+		return 1;
+	}
+
+	return 0;
+
+}
+
+static void
+csvn_header_row(void *sink)
+{
+
+	struct csvn_hdr_ctx *ctx = (struct csvn_hdr_ctx *)sink;
+
+	/* the parser is still at the end of the header when it ends */
+	if (!ctx->done) {
+		ctx->done = 1;
+		ctx->end = ctx->parser->pos;
+		ctx->line = ctx->parser->line;
+	}
+
+}
+
+int
+csvn_parse_header(const char *text, 
+		  const size_t textlen, 
+		  struct csv_p *csv_p, 
+		  struct csvn_hdr *hdr)
+{
+
+	struct csvn_hdr_ctx ctx;
+	struct csv_p parser;
+	const struct csvn_dialect *d;
+	int res;
+
+	if (csv_p->grow == NULL) {
+		return NOT_ENOUGH_MEM;
+	}
+
+	/* the header is not stored, projected or filtered like the rows */
+	csvn_init(&parser);
+	parser.dialect = csv_p->dialect;
+	parser.pos = csv_p->pos;
+	parser.line = csv_p->line;
+	parser.linestart = csv_p->linestart;
+	parser.on_field = csvn_header_field;
+	parser.on_row_end = csvn_header_row;
+	parser.sink = &ctx;
+	d = csvn_dialect_of(csv_p->dialect);
+
+	hdr->num_col = 0;
+	ctx.hdr = hdr;
+	ctx.csv_p = csv_p;
+	ctx.parser = &parser;
+	ctx.text = text;
+	ctx.done = 0;
+	ctx.res = 0;
+	ctx.end = parser.pos;
+	ctx.line = parser.line;
+
+	res = csvn_parse_text(text, textlen, &parser, NULL, 0, 0);
+	if (res < 0) {
+		return res;
+	}
+	if (ctx.res < 0) {
+		return ctx.res;
+	}
+
+	csv_p->state = IDLE;
+	if (ctx.done) {
+
+		csv_p->pos = ctx.end;
+		csv_p->line = ctx.line;
+
+		/* skip the end of the header as the parser would */
+		#ifdef CSVN_LENGTH_ONLY
+		if ((size_t)csv_p->pos < textlen) {
+		#else
+		if ((size_t)csv_p->pos < textlen && text[csv_p->pos] != '\0') {
+		#endif
+			if ((d->flags & CSVN_DIALECT_CRLF) && text[csv_p->pos] == '\r') {
+				csv_p->state = AFTER_CR;
+			}
+			csv_p->line++;
+			csv_p->pos++;
+			csv_p->linestart = csv_p->pos;
+		} else {
+			csv_p->linestart = parser.linestart;
+		}
+
+	} else {
+
+		/* the text has no row at all */
+		csv_p->pos = parser.pos;
+		csv_p->line = parser.line;
+		csv_p->linestart = parser.linestart;
+
+	}
+
+	res = csvn_hash_columns(hdr, csv_p);
+	if (res < 0) {
+		return res;
+	}
+
+	return hdr->num_col;
+
+}
+
+int
+csvn_column_index(const struct csvn_hdr *hdr, const char *name, size_t len)
+{
+
+	size_t slot, from;
+	int col;
+
+	if (hdr->num_slots == 0) {
+		return -1;
+	}
+
+	slot = csvn_hash(name, len) & (hdr->num_slots - 1);
+	while ((col = hdr->slots[slot]) != 0) {
+
+		col--;
+		from = (col > 0) ? hdr->ends[col - 1] : 0;
+		if (hdr->ends[col] - from == len && memcmp(hdr->names + from, name, len) == 0) {
+			return col;
+		}
+
+		slot = (slot + 1) & (hdr->num_slots - 1);
+
+	}
+
+	return -1;
+
+}
+#endif
+
+#ifdef CSVN_INFER
+static int
+csvn_all_digits(const char *p, size_t len)
+{
+
+	const uint64_t ones = ~(uint64_t)0 / 0xFF;
+	uint64_t w;
+	size_t i = 0;
+	int j;
+
+	for (; i + 8 <= len; i += 8) {
+
+		w = 0;
+		for (j = 7; j >= 0; j--) {
+			w = (w << 8) | (unsigned char)p[i + j];
+		}
+
+		/* just like in csvn_eight_digits */
+		if ((w & (0xF0 * ones)) != 0x30 * ones || 
+		    ((w + 0x06 * ones) & (0xF0 * ones)) != 0x30 * ones) {
+			return 0;
+		}
+
+	}
+
+	for (; i < len; i++) {
+		if (p[i] < '0' || p[i] > '9') {
+			return 0;
+		}
+	}
+
+	return 1;
+
+}
+
+static enum csvn_col_type
+csvn_classify(const char *text, 
+	      csvn_off start, 
+	      csvn_off end, 
+	      enum csv_tok kind)
+{
+
+	const char *p = text + start;
+	size_t len = (size_t)(end - start + 1), sign;
+	struct csv_t field;
+	int64_t i64;
+	double f64;
+
+	csvn_fill_token(&field, start, end, 0, kind, 0);
+
+	/* integers of up to 18 digits cannot overflow */
+	sign = (*p == '-' || *p == '+');
+	if (len > sign && csvn_all_digits(p + sign, len - sign)) {
+		if (len - sign <= 18 || csvn_to_i64(text, &field, &i64) == 0) {
+			return CSVN_COL_I64;
+		}
+		return CSVN_COL_F64;
+	}
+
+	if ((*p == '-' || *p == '+' || *p == '.' || (*p >= '0' && *p <= '9')) && 
+	    csvn_to_f64(text, &field, &f64) == 0) {
+		return CSVN_COL_F64;
+	}
+
+	if (len >= 10 && p[4] == '-' && p[7] == '-' && csvn_to_time(text, &field, &i64) == 0) {
+		return CSVN_COL_TIME;
+	}
+
+	if ((len == 4 || len == 5) && csvn_to_bool(text, &field, &i64) == 0) {
+		return CSVN_COL_BOOL;
+	}
+
+	return CSVN_COL_SPAN;
+
+}
+
+static enum csvn_col_type
+csvn_join_types(enum csvn_col_type a, enum csvn_col_type b)
+{
+
+	if (a == b) {
+		return a;
+	}
+
+	if ((a == CSVN_COL_I64 && b == CSVN_COL_F64) || (a == CSVN_COL_F64 && b == CSVN_COL_I64)) {
+		return CSVN_COL_F64;
+	}
+
+	return CSVN_COL_SPAN;
+
+}
+
+static int
+csvn_infer_field(void *sink, csvn_off start, csvn_off len, enum csv_tok kind)
+{
+
+	struct csvn_infer_ctx *ctx = (struct csvn_infer_ctx *)sink;
+	struct csvn_col *col;
+	enum csvn_col_type type;
+	int field = ctx->parser->colfield;
+
+	/* the first field after the sample stops the parser */
+	if (ctx->rows > 0 && ctx->seen >= ctx->rows) {
+		return 1;
+	}
+
+	if (field + 1 > ctx->num_seen) {
+		ctx->num_seen = field + 1;
+	}
+
+	if (field >= ctx->num_col || kind == EMPTY || len == 0) {
+		return 0;
+	}
+
+	col = &ctx->schema[field];
+	type = csvn_classify(ctx->text, start, start + len - 1, kind);
+
+	if (!ctx->typed[field]) {
+		col->type = type;
+		ctx->typed[field] = 1;
+	} else {
+		col->type = csvn_join_types(col->type, type);
+	}
+
+	return 0;
+
+}
+
+static void
+csvn_infer_row(void *sink)
+{
+
+	((struct csvn_infer_ctx *)sink)->seen++;
+
+}
+
+int
+csvn_infer_schema(const char *text, 
+		  const size_t textlen, 
+		  const struct csv_p *csv_p, 
+		  int rows, 
+		  struct csvn_col *schema, 
+		  int num_col)
+{
+
+	struct csvn_infer_ctx ctx;
+	struct csv_p parser;
+	csvn_off pos = csv_p->pos, linestart = csv_p->linestart;
+	int line = csv_p->line, samples = 1, stride = 1, i, res = 0;
+	size_t mark;
+
+	for (i = 0; i < num_col; i++) {
+		schema[i].type = CSVN_COL_SPAN;
+		schema[i].values = NULL;
+		schema[i].sizes = NULL;
+		schema[i].valid = NULL;
+	}
+
+	ctx.schema = schema;
+	ctx.num_col = num_col;
+	ctx.typed = (unsigned char *)calloc((num_col > 0) ? (size_t)num_col : 1, 1);
+	if (ctx.typed == NULL) {
+		return NOT_ENOUGH_MEM;
+	}
+	ctx.parser = &parser;
+	ctx.text = text;
+	ctx.rows = rows;
+	ctx.num_seen = 0;
+
+#ifdef CSVN_SIDECAR
+	/* the position and every stride-th mark after it, about rows rows in all */
+	if (csv_p->marknext > 0 && rows > 0) {
+		stride = (csv_p->marknext + rows) / rows;
+		samples = (csv_p->marknext + stride) / stride;
+		ctx.rows = (rows > samples) ? rows / samples : 1;
+	}
+#endif
+
+	for (i = 0; i < samples && res >= 0; i++) {
+
+#ifdef CSVN_SIDECAR
+		/* every sample but the first starts at a mark */
+		if (i > 0) {
+			mark = (size_t)i * (size_t)stride - 1;
+			pos = linestart = csv_p->marks[mark].offset - csv_p->base;
+			line = csv_p->marks[mark].line;
+			if (pos < csv_p->pos || (size_t)pos >= textlen) {
+				continue;
+			}
+		}
+#endif
+
+		/* the sampled rows are not stored, projected or filtered */
+		csvn_init(&parser);
+		parser.dialect = csv_p->dialect;
+		parser.pos = pos;
+		parser.line = line;
+		parser.linestart = linestart;
+		if (i == 0) {
+			parser.state = csv_p->state;
+		}
+		parser.on_field = csvn_infer_field;
+		parser.on_row_end = csvn_infer_row;
+		parser.sink = &ctx;
+
+		ctx.seen = 0;
+		res = csvn_parse_text(text, textlen, &parser, NULL, 0, 0);
+
+	}
+
+	free(ctx.typed);
+
+	return (res < 0) ? res : ctx.num_seen;
+
+}
+#endif
+
+#ifdef CSVN_SIDECAR
+static int
+csvn_mark_row(struct csv_p *csv_p, csvn_off term, int line)
+{
+
+	struct csvn_mark *grown;
+	size_t num_mark;
+	int mark;
+
+	if (term <= csv_p->linestart || csv_p->every <= 0) {
+		return 0;
+	}
+
+	if (csv_p->rowcount == 0x7fffffff) {
+		return OUT_OF_RANGE;
+	}
+
+	/* a mark which has been loaded (or recorded before a seek) is kept */
+	mark = (csv_p->rowcount + 1) / csv_p->every - 1;
+	if ((csv_p->rowcount + 1) % csv_p->every == 0 && mark == csv_p->marknext) {
+
+		if ((size_t)mark >= csv_p->num_mark) {
+
+			if (csv_p->grow == NULL) {
+				return NOT_ENOUGH_MEM;
+			}
+
+			num_mark = (csv_p->num_mark < 16) ? 32 : 2 * csv_p->num_mark;
+			grown = (struct csvn_mark *)csvn_grow_pool(csv_p, csv_p->marks, csv_p->ownmarks, 
+								   (size_t)csv_p->marknext * sizeof(struct csvn_mark), 
+								   num_mark * sizeof(struct csvn_mark));
+			if (grown == NULL) {
+				return NOT_ENOUGH_MEM;
+			}
+
+			csv_p->marks = grown;
+			csv_p->num_mark = num_mark;
+			csv_p->ownmarks = 1;
+			CSVN_STAT(csv_p, grown++);
+
+		}
+
+		csv_p->marks[mark].offset = csv_p->base + term + 1;
+		csv_p->marks[mark].line = line + 1;
+		csv_p->marknext++;
+
+	}
+
+	csv_p->rowcount++;
+
+	return 0;
+
+}
+
+static uint64_t
+csvn_checksum(const char *text, 
+	      const size_t textlen, 
+	      const struct csvn_mark *marks, 
+	      int num_mark)
+{
+
+	uint64_t h = ((uint64_t)0xcbf29ce4 << 32) | 0x84222325;
+	const uint64_t prime = ((uint64_t)0x100 << 32) | 0x1b3;
+	size_t from, to, i;
+	int m = -2;
+
+	for (i = 0; i < 8; i++) {
+		h ^= (uint64_t)((textlen >> (8 * i)) & 0xff);
+		h *= prime;
+	}
+
+	/* m = -2 and m = -1 stand for the first and last 4 KiB */
+	for (; m < num_mark; m++) {
+
+		if (m == -2) {
+			from = 0;
+			to = (textlen < 4096) ? textlen : 4096;
+		} else if (m == -1) {
+			from = (textlen < 4096) ? 0 : textlen - 4096;
+			to = textlen;
+		} else {
+			to = (size_t)marks[m].offset;
+			from = (to < 16) ? 0 : to - 16;
+		}
+
+		for (i = from; i < to; i++) {
+			h ^= (unsigned char)text[i];
+			h *= prime;
+		}
+
+	}
+
+	return h;
+
+}
+
+static int
+csvn_put64(FILE *file, uint64_t value)
+{
+
+	int i;
+
+	for (i = 0; i < 8; i++) {
+		if (fputc((int)((value >> (8 * i)) & 0xff), file) == EOF) {
+			return IO_ERROR;
+		}
+	}
+
+	return 0;
+
+}
+
+static int
+csvn_get64(FILE *file, uint64_t *value)
+{
+
+	int i, c;
+
+	*value = 0;
+	for (i = 0; i < 8; i++) {
+		c = fgetc(file);
+		if (c == EOF) {
+			return IO_ERROR;
+		}
+		*value |= (uint64_t)c << (8 * i);
+	}
+
+	return 0;
+
+}
+
+int
+csvn_save_marks(const char *path, 
+		const char *text, 
+		const size_t textlen, 
+		const struct csv_p *csv_p)
+{
+
+	FILE *file;
+	int i, res;
+
+	file = fopen(path, "wb");
+	if (file == NULL) {
+		return IO_ERROR;
+	}
+
+	res = (fwrite("CSVNMRK1", 1, 8, file) == 8) ? 0 : IO_ERROR;
+	res |= csvn_put64(file, (uint64_t)csv_p->every);
+	res |= csvn_put64(file, (uint64_t)csv_p->marknext);
+	res |= csvn_put64(file, (uint64_t)textlen);
+	res |= csvn_put64(file, csvn_checksum(text, textlen, csv_p->marks, csv_p->marknext));
+
+	for (i = 0; i < csv_p->marknext && res == 0; i++) {
+		res |= csvn_put64(file, (uint64_t)csv_p->marks[i].offset);
+		res |= csvn_put64(file, (uint64_t)csv_p->marks[i].line);
+	}
+
+	if (fclose(file) != 0 || res != 0) {
+		return IO_ERROR;
+	}
+
+	return 0;
+
+}
+
+int
+csvn_load_marks(const char *path, 
+		const char *text, 
+		const size_t textlen, 
+		struct csv_p *csv_p)
+{
+
+	FILE *file;
+	struct csvn_mark *grown;
+	char magic[8];
+	uint64_t every, count, length, sum, offset, line;
+	size_t i;
+	int res = 0;
+
+	file = fopen(path, "rb");
+	if (file == NULL) {
+		return IO_ERROR;
+	}
+
+	if (fread(magic, 1, 8, file) != 8 || memcmp(magic, "CSVNMRK1", 8) != 0 || 
+	    csvn_get64(file, &every) != 0 || csvn_get64(file, &count) != 0 || 
+	    csvn_get64(file, &length) != 0 || csvn_get64(file, &sum) != 0 || 
+	    every == 0 || every > 0x7fffffff || count > 0x7fffffff / every || 
+	    length != (uint64_t)textlen) {
+		fclose(file);
+		return IO_ERROR;
+	}
+
+	if (count > csv_p->num_mark) {
+
+		grown = NULL;
+		if (csv_p->grow != NULL) {
+			/* every mark is read again, so none has to be kept */
+			grown = (struct csvn_mark *)csvn_grow_pool(csv_p, csv_p->marks, csv_p->ownmarks, 0, 
+								   (size_t)count * sizeof(struct csvn_mark));
+		}
+		if (grown == NULL) {
+			fclose(file);
+			return NOT_ENOUGH_MEM;
+		}
+
+		csv_p->marks = grown;
+		csv_p->num_mark = (size_t)count;
+		csv_p->ownmarks = 1;
+
+	}
+
+	/* every mark lies after the one before, right after the end of a row */
+	for (i = 0; i < (size_t)count && res == 0; i++) {
+
+		if (csvn_get64(file, &offset) != 0 || csvn_get64(file, &line) != 0 || 
+		    offset == 0 || offset > length || 
+		    (i > 0 && offset <= (uint64_t)csv_p->marks[i - 1].offset) || 
+		    line < 2 || line > 0x7fffffff) {
+			res = IO_ERROR;
+			break;
+		}
+
+		csv_p->marks[i].offset = (csvn_off)offset;
+		csv_p->marks[i].line = (int)line;
+
+	}
+
+	fclose(file);
+
+	if (res != 0 || csvn_checksum(text, textlen, csv_p->marks, (int)count) != sum) {
+		csv_p->marknext = 0;
+		return IO_ERROR;
+	}
+
+	csv_p->every = (int)every;
+	csv_p->marknext = (int)count;
+
+	return (int)count;
+
+}
+
+int
+csvn_seek_row(const char *text, 
+	      const size_t textlen, 
+	      struct csv_p *csv_p, 
+	      int row)
+{
+
+	const struct csvn_dialect *d = csvn_dialect_of(csv_p->dialect);
+	int mark = (csv_p->every > 0) ? row / csv_p->every - 1 : -1;
+	int marknext = csv_p->marknext;
+	csvn_off base = csv_p->base;
+	csvn_off offset;
+
+	if (mark >= marknext) {
+		mark = marknext - 1;
+	}
+
+	/* the text of the row may have been discarded already */
+	offset = (mark < 0) ? 0 : csv_p->marks[mark].offset;
+	if (offset < base) {
+		return DISCARDED;
+	}
+
+	/* the marks and the characters discarded before are all that is kept */
+	csvn_reset(csv_p);
+	csv_p->marknext = marknext;
+	csv_p->base = base;
+
+	csv_p->pos = offset - base;
+	if (mark >= 0) {
+
+		csv_p->line = csv_p->marks[mark].line;
+		csv_p->rowcount = (mark + 1) * csv_p->every;
+
+		/* a row ended by "\r\n" is marked right after its '\r' */
+		if ((d->flags & CSVN_DIALECT_CRLF) && csv_p->pos > 0 && 
+		    (size_t)csv_p->pos < textlen && 
+		    text[csv_p->pos - 1] == '\r' && text[csv_p->pos] == '\n') {
+			csv_p->pos++;
+		}
+
+	}
+
+	csv_p->linestart = csv_p->pos;
+
+	return csv_p->rowcount;
+
+}
+#endif
+
+#ifdef CSVN_ARENA
+void
+csvn_arena_init(struct csvn_arena *arena, size_t block)
+{
+
+	arena->first = NULL;
+	arena->block = NULL;
+	arena->used = 0;
+	arena->next = (block > 0) ? block : CSVN_ARENA_BLOCK;
+	arena->last = NULL;
+	arena->allocated = 0;
+
+}
+
+void *
+csvn_arena_alloc(struct csvn_arena *arena, size_t size)
+{
+
+	const size_t head = CSVN_ALIGN(sizeof(struct csvn_block));
+	struct csvn_block *block = arena->block;
+	char *ptr;
+
+	size = CSVN_ALIGN(size);
+
+	/* the blocks kept by a reset are used again, one after another */
+	while (block != NULL && arena->used + size > block->size && block->next != NULL) {
+		block = block->next;
+		arena->block = block;
+		arena->used = 0;
+	}
+
+	if (block == NULL || arena->used + size > block->size) {
+
+		while (arena->next < size) {
+			arena->next *= 2;
+		}
+
+		block = (struct csvn_block *)malloc(head + arena->next);
+		if (block == NULL) {
+			return NULL;
+		}
+		block->next = NULL;
+		block->size = arena->next;
+
+		if (arena->block != NULL) {
+			arena->block->next = block;
+		} else {
+			arena->first = block;
+		}
+		arena->block = block;
+		arena->used = 0;
+
+		if (arena->next < CSVN_ARENA_MAX_BLOCK) {
+			arena->next *= 2;
+		}
+
+	}
+
+	ptr = (char *)block + head + arena->used;
+	arena->used += size;
+	arena->allocated += size;
+	arena->last = NULL;
+
+	return ptr;
+
+}
+
+void *
+csvn_arena_grow(void *ctx, void *ptr, size_t size)
+{
+
+	struct csvn_arena *arena = (struct csvn_arena *)ctx;
+	const size_t head = CSVN_ALIGN(sizeof(size_t));
+	char *block, *grown;
+	size_t old = 0;
+
+	/* every grown allocation starts with its size */
+	if (ptr != NULL) {
+
+		old = *(size_t *)((char *)ptr - head);
+		block = (char *)arena->block + CSVN_ALIGN(sizeof(struct csvn_block));
+
+		if (size <= old) {
+			return ptr;
+		}
+
+		if ((char *)ptr == arena->last && 
+		    (size_t)((char *)ptr - block) + CSVN_ALIGN(size) <= arena->block->size) {
+			arena->allocated += CSVN_ALIGN(size) - CSVN_ALIGN(old);
+			arena->used = (size_t)((char *)ptr - block) + CSVN_ALIGN(size);
+			*(size_t *)((char *)ptr - head) = size;
+			return ptr;
+		}
+
+	}
+
+	grown = (char *)csvn_arena_alloc(arena, head + size);
+	if (grown == NULL) {
+		return NULL;
+	}
+
+	grown += head;
+	*(size_t *)(grown - head) = size;
+	if (old > 0) {
+		memcpy(grown, ptr, old);
+	}
+	arena->last = grown;
+
+	return grown;
+
+}
+
+char *
+csvn_copy_field(struct csvn_arena *arena, 
+		const char *text, 
+		const struct csv_t *token, 
+		const struct csvn_dialect *dialect, 
+		int unescaped)
+{
+
+	char quote = csvn_dialect_of(dialect)->quote;
+	enum csv_tok kind = CSVN_TOK_KIND(*token);
+	size_t len = 0, i, n = 0;
+	char *copy;
+
+	if (kind == TEXT || kind == DQUOTE) {
+		len = (size_t)(CSVN_TOK_SIZE(*token) + 1);
+		text += CSVN_TOK_START(*token);
+	}
+
+	copy = (char *)csvn_arena_alloc(arena, len + 1);
+	if (copy == NULL) {
+		return NULL;
+	}
+
+	if (kind != DQUOTE || !CSVN_TOK_ESCAPED(*token) || unescaped) {
+		memcpy(copy, text, len);
+		n = len;
+	} else {
+		for (i = 0; i < len; i++) {
+			copy[n++] = text[i];
+			if (text[i] == quote && i + 1 < len && text[i + 1] == quote) {
+				i++;
+			}
+		}
+	}
+	copy[n] = '\0';
+
+	return copy;
+
+}
+
+void
+csvn_arena_reset(struct csvn_arena *arena)
+{
+
+	arena->block = arena->first;
+	arena->used = 0;
+	arena->last = NULL;
+	arena->allocated = 0;
+
+}
+
+void
+csvn_arena_free(struct csvn_arena *arena)
+{
+
+	struct csvn_block *block = arena->first, *next;
+
+	while (block != NULL) {
+		next = block->next;
+		free(block);
+		block = next;
+	}
+
+	arena->first = NULL;
+	arena->block = NULL;
+	arena->used = 0;
+	arena->last = NULL;
+	arena->allocated = 0;
+
+}
+#endif
+
+#ifdef CSVN_STATS
+void
+csvn_stats_init(struct csvn_stats *stats)
+{
+
+	memset(stats, 0, sizeof(struct csvn_stats));
+
+}
+
+#ifdef CSVN_PARALLEL
+static void
+csvn_add_stats(struct csvn_stats *stats, const struct csvn_stats *from)
+{
+
+	int i;
+
+	stats->bytes += from->bytes;
+	for (i = 0; i < 4; i++) {
+		stats->fields[i] += from->fields[i];
+	}
+	stats->escapes += from->escapes;
+	stats->multiline += from->multiline;
+	stats->grown += from->grown;
+	stats->exhausted += from->exhausted;
+
+}
+#endif
+#endif
+
+size_t
+csvn_discardable(const struct csv_p *csv_p)
+{
+
+	switch (csv_p->state) {
+
+	case IN_TEXT:
+	case IN_DQUOTE:
+		return (size_t)csv_p->start;
+
+	case AFTER_DELIM:
+		/* a possible empty field starts at the character before pos */
+		return (size_t)csv_p->pos - 1;
+
+	default:
+		return (size_t)csv_p->pos;
+
+	}
+
+}
+
+void
+csvn_discard(struct csv_p *csv_p, size_t n)
+{
+
+	csv_p->pos -= (csvn_off)n;
+	csv_p->start -= (csvn_off)n;
+	csv_p->linestart -= (csvn_off)n;
+
+	/* the row still being parsed is the only one kept (with its old fields) */
+	if (csv_p->rows != NULL) {
+
+		if (csv_p->rownext > 0 && 
+		    csv_p->rows[csv_p->rownext - 1].offset == csv_p->linestart + (csvn_off)n) {
+
+			csv_p->rows[0] = csv_p->rows[csv_p->rownext - 1];
+			csv_p->rows[0].token -= csv_p->toknext;
+			csv_p->rows[0].offset -= (csvn_off)n;
+			csv_p->rownext = 1;
+
+		} else {
+			csv_p->rownext = 0;
+		}
+
+	}
+
+	#ifdef CSVN_COLUMNS
+	if (csv_p->columns != NULL) {
+		csvn_discard_columns(csv_p, n);
+	}
+	#endif
+
+	#ifdef CSVN_SIDECAR
+	csv_p->base += (csvn_off)n;
+	#endif
+
+	csv_p->toknext = 0;
+	#ifdef CSVN_FILTER
+	csv_p->rowtok = 0;
+	#endif
+
+}
+
+#ifdef CSVN_COLUMNS
+static void
+csvn_discard_columns(struct csv_p *csv_p, size_t n)
+{
+
+	struct csvn_col *col;
+	size_t last = csv_p->colnext - 1;
+	int i, valid;
+
+	/* just like with the row pool, only the row still being parsed is kept */
+	if (csv_p->colnext == 0 || csv_p->colrow != csv_p->linestart + (csvn_off)n) {
+		csv_p->colnext = 0;
+		return;
+	}
+
+	for (i = 0; i < csv_p->num_col; i++) {
+
+		col = &csv_p->columns[i];
+		valid = (col->valid[last / 8] >> (last % 8)) & 1;
+
+		if (col->type == CSVN_COL_SPAN) {
+			((csvn_off *)col->values)[0] = ((csvn_off *)col->values)[last] - (csvn_off)n;
+			col->sizes[0] = col->sizes[last];
+		} else if (col->type == CSVN_COL_F64) {
+			((double *)col->values)[0] = ((double *)col->values)[last];
+		} else {
+			((int64_t *)col->values)[0] = ((int64_t *)col->values)[last];
+		}
+
+		col->valid[0] = (unsigned char)valid;
+
+	}
+
+	csv_p->colrow -= (csvn_off)n;
+	csv_p->colnext = 1;
+
+}
+#endif
+
+
+#ifdef CSVN_INDEX
+#if defined(__GNUC__)
+#define csvn_ctz64(x) ((size_t)__builtin_ctzll(x))
+#define csvn_popcount64(x) ((size_t)__builtin_popcountll(x))
+#else
+static size_t
+csvn_ctz64(uint64_t x)
+{
+
+	size_t n = 0;
+
+	while ((x & 1) == 0) {
+		x >>= 1;
+		n++;
+	}
+
+	return n;
+
+}
+
+static size_t
+csvn_popcount64(uint64_t x)
+{
+
+	size_t n = 0;
+
+	for (; x != 0; x &= x - 1) {
+		n++;
+	}
+
+	return n;
+
+}
+#endif
+
+static uint64_t
+csvn_prefix_xor(uint64_t x)
+{
+
+#if defined(CSVN_SIMD_PCLMUL)
+	/* carry-less multiplication by all ones is exactly the prefix XOR */
+	__m128i v = _mm_clmulepi64_si128(_mm_set_epi64x(0, (long long)x), 
+					 _mm_set1_epi8(-1), 0);
+	return (uint64_t)_mm_cvtsi128_si64(v);
+#else
+	x ^= x << 1;
+	x ^= x << 2;
+	x ^= x << 4;
+	x ^= x << 8;
+	x ^= x << 16;
+	x ^= x << 32;
+
+	return x;
+#endif
+
+}
+
+#if defined(CSVN_SIMD_NEON) && defined(__aarch64__)
+static uint64_t
+csvn_neon_mask(uint8x16_t m0, uint8x16_t m1, uint8x16_t m2, uint8x16_t m3)
+{
+
+	const uint8x16_t bits = { 1, 2, 4, 8, 16, 32, 64, 128, 
+				  1, 2, 4, 8, 16, 32, 64, 128 };
+	uint8x16_t s0 = vpaddq_u8(vandq_u8(m0, bits), vandq_u8(m1, bits));
+	uint8x16_t s1 = vpaddq_u8(vandq_u8(m2, bits), vandq_u8(m3, bits));
+
+	s0 = vpaddq_u8(s0, s1);
+	s0 = vpaddq_u8(s0, s0);
+
+	return vgetq_lane_u64(vreinterpretq_u64_u8(s0), 0);
+
+}
+#endif
+
+static void
+csvn_index_block(const char *block, 
+		 const struct csvn_dialect *d, 
+		 uint64_t *quote, 
+		 uint64_t *delim, 
+		 uint64_t *nl)
+{
+
+#if defined(CSVN_SIMD_AVX2)
+	const __m256i vq = _mm256_set1_epi8(d->quote);
+	const __m256i vd = _mm256_set1_epi8(d->delim);
+	const __m256i vn = _mm256_set1_epi8(d->newline);
+	const __m256i vr = _mm256_set1_epi8(CSVN_OR_CR(d));
+	__m256i lo = _mm256_loadu_si256((const __m256i *)block);
+	__m256i hi = _mm256_loadu_si256((const __m256i *)(block + 32));
+
+	*quote = (uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(lo, vq)) | 
+		 (uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(hi, vq)) << 32;
+	*delim = (uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(lo, vd)) | 
+		 (uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(hi, vd)) << 32;
+	*nl = (uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_or_si256(
+			_mm256_cmpeq_epi8(lo, vn), _mm256_cmpeq_epi8(lo, vr))) | 
+	      (uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_or_si256(
+			_mm256_cmpeq_epi8(hi, vn), _mm256_cmpeq_epi8(hi, vr))) << 32;
+#elif defined(CSVN_SIMD_SSE2)
+	const __m128i vq = _mm_set1_epi8(d->quote);
+	const __m128i vd = _mm_set1_epi8(d->delim);
+	const __m128i vn = _mm_set1_epi8(d->newline);
+	const __m128i vr = _mm_set1_epi8(CSVN_OR_CR(d));
+	int i;
+
+	*quote = *delim = *nl = 0;
+
+	for (i = 0; i < 4; i++) {
+
+		__m128i v = _mm_loadu_si128((const __m128i *)(block + 16 * i));
+
+		*quote |= (uint64_t)(unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(v, vq)) << (16 * i);
+		*delim |= (uint64_t)(unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(v, vd)) << (16 * i);
+		*nl |= (uint64_t)(unsigned int)_mm_movemask_epi8(_mm_or_si128(
+				_mm_cmpeq_epi8(v, vn), _mm_cmpeq_epi8(v, vr))) << (16 * i);
+
+	}
+#elif defined(CSVN_SIMD_NEON) && defined(__aarch64__)
+	const uint8x16_t vq = vdupq_n_u8((unsigned char)d->quote);
+	const uint8x16_t vd = vdupq_n_u8((unsigned char)d->delim);
+	const uint8x16_t vn = vdupq_n_u8((unsigned char)d->newline);
+	const uint8x16_t vr = vdupq_n_u8((unsigned char)CSVN_OR_CR(d));
+	uint8x16_t v0 = vld1q_u8((const unsigned char *)block);
+	uint8x16_t v1 = vld1q_u8((const unsigned char *)block + 16);
+	uint8x16_t v2 = vld1q_u8((const unsigned char *)block + 32);
+	uint8x16_t v3 = vld1q_u8((const unsigned char *)block + 48);
+
+	*quote = csvn_neon_mask(vceqq_u8(v0, vq), vceqq_u8(v1, vq), 
+				vceqq_u8(v2, vq), vceqq_u8(v3, vq));
+	*delim = csvn_neon_mask(vceqq_u8(v0, vd), vceqq_u8(v1, vd), 
+				vceqq_u8(v2, vd), vceqq_u8(v3, vd));
+	*nl = csvn_neon_mask(vorrq_u8(vceqq_u8(v0, vn), vceqq_u8(v0, vr)), 
+			     vorrq_u8(vceqq_u8(v1, vn), vceqq_u8(v1, vr)), 
+			     vorrq_u8(vceqq_u8(v2, vn), vceqq_u8(v2, vr)), 
+			     vorrq_u8(vceqq_u8(v3, vn), vceqq_u8(v3, vr)));
+#else
+	int i;
+
+	*quote = *delim = *nl = 0;
+
+	for (i = 0; i < 64; i++) {
+
+		uint64_t bit = (uint64_t)1 << i;
+
+		if (block[i] == d->quote) {
+			*quote |= bit;
+		} else if (block[i] == d->delim) {
+			*delim |= bit;
+		} else if (block[i] == d->newline || block[i] == CSVN_OR_CR(d)) {
+			*nl |= bit;
+		}
+
+	}
+#endif
+
+}
+
+void
+csvn_index_init(struct csvn_idx *idx)
+{
+
+	idx->pos = 0;
+	idx->count = 0;
+	idx->quoted = 0;
+	idx->dialect = NULL;
+
+}
+
+int
+csvn_index(const char *text, 
+	   const size_t textlen, 
+	   struct csvn_idx *idx, 
+	   size_t *offsets, 
+	   const size_t num_off)
+{
+
+	char tail[64];
+	const char *block;
+	const struct csvn_dialect *d = csvn_dialect_of(idx->dialect);
+	uint64_t quote, delim, nl, inside, structural;
+	size_t i, n;
+
+	CSVN_TRACE_BEGIN(index);
+
+	while (idx->pos < textlen) {
+
+		n = textlen - idx->pos;
+
+		#ifdef CSVN_PADDING
+		/* the padding after the text lets the last block be read in place */
+		(void)i;
+		(void)tail;
+		block = text + idx->pos;
+		if (n > 64) {
+			n = 64;
+		}
+		#else
+		if (n >= 64) {
+
+			block = text + idx->pos;
+			n = 64;
+
+		} else {
+
+			/* the last partial block is copied so it can be read whole */
+			for (i = 0; i < 64; i++) {
+				tail[i] = (i < n) ? text[idx->pos + i] : '\0';
+			}
+			block = tail;
+
+		}
+		#endif
+
+		csvn_index_block(block, d, &quote, &delim, &nl);
+
+		if (n < 64) {
+			uint64_t valid = ((uint64_t)1 << n) - 1;
+			quote &= valid;
+			delim &= valid;
+			nl &= valid;
+		}
+
+		/* quote parity tells which characters lie within a quoted field */
+		inside = csvn_prefix_xor(quote);
+		if (idx->quoted) {
+			inside = ~inside;
+		}
+
+		structural = (delim | nl) & ~inside;
+
+		if (offsets != NULL) {
+
+			/* a resumed call may be given fewer offsets than were already found */
+			if (idx->count > num_off || 
+			    csvn_popcount64(structural) > num_off - idx->count) {
+				CSVN_TRACE_END(index);
+				return NOT_ENOUGH_MEM;
+			}
+
+			for (; structural != 0; structural &= structural - 1) {
+				offsets[idx->count++] = idx->pos + csvn_ctz64(structural);
+			}
+
+		} else {
+			idx->count += csvn_popcount64(structural);
+		}
+
+		idx->quoted = (int)(inside >> 63);
+		idx->pos += n;
+
+	}
+
+	CSVN_TRACE_END(index);
+
+	/* the offsets stay usable through idx->count */
+	if (idx->count > 0x7fffffff) {
+		return OUT_OF_RANGE;
+	}
+
+	return (int)idx->count;
+
+}
+
+/* stores the malformed row of shape, returning err */
+static int
+csvn_bad_row(struct csvn_shape *shape, size_t offset, int err)
+{
+
+	shape->bad_row = shape->rows;
+	shape->bad_offset = offset;
+
+	return err;
+
+}
+
+int
+csvn_validate(const char *text, 
+	      const size_t textlen, 
+	      const struct csvn_dialect *dialect, 
+	      struct csvn_shape *shape)
+{
+
+	char tail[64];
+	const char *block;
+	const struct csvn_dialect *d = csvn_dialect_of(dialect);
+	const int strict = d->flags & CSVN_DIALECT_STRICT;
+	uint64_t quote, delim, nl, inside, sep, bad, last, low;
+	uint64_t before = 1;
+	size_t pos, n, i, end, start = 0;
+	int quoted = 0, closing = 0, fields = 1;
+
+	CSVN_TRACE_BEGIN(validate);
+
+	shape->rows = 0;
+	shape->max_fields = 0;
+	shape->bad_row = 0;
+	shape->bad_offset = 0;
+
+	for (pos = 0; pos < textlen; pos += n) {
+
+		n = textlen - pos;
+
+		#ifdef CSVN_PADDING
+		(void)i;
+		(void)tail;
+		block = text + pos;
+		if (n > 64) {
+			n = 64;
+		}
+		#else
+		if (n >= 64) {
+
+			block = text + pos;
+			n = 64;
+
+		} else {
+
+			for (i = 0; i < 64; i++) {
+				tail[i] = (i < n) ? text[pos + i] : '\0';
+			}
+			block = tail;
+
+		}
+		#endif
+
+		csvn_index_block(block, d, &quote, &delim, &nl);
+
+		last = (uint64_t)1 << (n - 1);
+		if (n < 64) {
+			quote &= (last << 1) - 1;
+			delim &= (last << 1) - 1;
+			nl &= (last << 1) - 1;
+		}
+
+		inside = csvn_prefix_xor(quote);
+		if (quoted) {
+			inside = ~inside;
+		}
+
+		delim &= ~inside;
+		nl &= ~inside;
+		sep = delim | nl | quote;
+
+		/* 
+		   an opening quote follows a separator (or the closing quote 
+		   it escapes) and a closing one is followed by one, which may 
+		   only be known in the next block
+		*/
+		bad = 0;
+		if (strict) {
+
+			bad = (quote & inside & ~((sep << 1) | before)) | 
+			      (quote & ~inside & ~(sep >> 1) & ~last);
+			if (closing && !(sep & 1)) {
+				bad |= 1;
+			}
+			closing = (quote & ~inside & last) != 0;
+
+		}
+		before = sep >> 63;
+		end = (bad != 0) ? csvn_ctz64(bad) : 64;
+
+		/* a newline right at the start of a row is a blank line (or the LF of a CRLF) */
+		for (; nl != 0 && csvn_ctz64(nl) < end; nl &= nl - 1) {
+
+			i = csvn_ctz64(nl);
+			low = ((uint64_t)1 << i) - 1;
+			fields += (int)csvn_popcount64(delim & low);
+			delim &= ~low;
+
+			if (pos + i > start) {
+
+				if (shape->fields > 0 && fields != shape->fields) {
+					CSVN_TRACE_END(validate);
+					return csvn_bad_row(shape, start, WRONG_FIELD_COUNT);
+				}
+				if (fields > shape->max_fields) {
+					shape->max_fields = fields;
+				}
+				shape->rows++;
+
+			}
+
+			fields = 1;
+			start = pos + i + 1;
+
+		}
+
+		if (end < 64) {
+			CSVN_TRACE_END(validate);
+			return csvn_bad_row(shape, start, INVALID_CHARACTER);
+		}
+
+		fields += (int)csvn_popcount64(delim);
+		quoted = (int)(inside >> 63);
+
+	}
+
+	CSVN_TRACE_END(validate);
+
+	if (strict && quoted) {
+		return csvn_bad_row(shape, start, INVALID_CHARACTER);
+	}
+
+	/* the last row may not end with a newline */
+	if (textlen > start) {
+
+		if (shape->fields > 0 && fields != shape->fields) {
+			return csvn_bad_row(shape, start, WRONG_FIELD_COUNT);
+		}
+		if (fields > shape->max_fields) {
+			shape->max_fields = fields;
+		}
+		shape->rows++;
+
+	}
+
+	return 0;
+
+}
+
+static int
+csvn_index_field(const char *text, 
+		 size_t fs, 
+		 size_t se, 
+		 int after_delim, 
+		 int before_delim, 
+		 int unterminated, 
+		 struct csv_p *csv_p, 
+		 struct csv_t *tokpool, 
+		 const size_t num_tok, 
+		 const struct csvn_dialect *d)
+{
+
+	size_t start, end, pos;
+	enum csv_tok kind;
+	int line = csv_p->line, escapes = 0, res;
+	int strict = d->flags & CSVN_DIALECT_STRICT;
+
+	if ((d->flags & CSVN_DIALECT_SKIP_WHITESPACE) && after_delim) {
+		while (fs < se && text[fs] == ' ') {
+			fs++;
+		}
+	}
+
+	if (fs == se) {
+
+		/* just like csvn_parse, only two adjacent delimeters make an empty field */
+		if (!after_delim || !before_delim) {
+			return 0;
+		}
+
+		if (d->flags & CSVN_DIALECT_NO_EMPTY_FIELD) {
+			return INVALID_CHARACTER;
+		}
+
+		if (d->flags & CSVN_DIALECT_IGNORE_EMPTY_FIELD) {
+			return 0;
+		}
+
+		start = fs - 1;
+		end = fs;
+		kind = EMPTY;
+
+	} else if (text[fs] == d->quote) {
+
+		start = fs + 1;
+
+		if (unterminated) {
+			end = se - 1;
+		} else if (se - fs >= 2 && text[se - 1] == d->quote) {
+			end = se - 2; /* closing quote right before the structural */
+		} else if (strict) {
+			return INVALID_CHARACTER;
+		} else {
+			end = se - 1;
+		}
+
+		/* count the newlines and escapes and, if strict, check that all quotes are escaped */
+		for (pos = start; pos <= end; pos++) {
+
+			pos = csvn_scan(text, pos, end + 1, d->newline, d->quote, 
+					CSVN_OR_CR(d), d->newline, d->newline);
+
+			if (pos > end) {
+				break;
+			}
+
+			if (text[pos] == d->quote) {
+				if (pos < end && text[pos + 1] == d->quote) {
+					escapes++;
+					pos++;
+				} else if (strict) {
+					return INVALID_CHARACTER;
+				}
+				continue;
+			}
+
+			/* "\r\n" counts once */
+			if ((d->flags & CSVN_DIALECT_CRLF) && text[pos] == '\r' && 
+			    pos < end && text[pos + 1] == '\n') {
+				pos++;
+			}
+
+			if (d->flags & CSVN_DIALECT_CONSIDER_NL) {
+				line++;
+			}
+			csv_p->line++;
+			CSVN_STAT(csv_p, multiline++);
+
+		}
+
+		kind = DQUOTE;
+
+	} else {
+
+		if (strict && csvn_scan(text, fs, se, d->quote, d->quote, 
+					d->quote, d->quote, d->quote) < se) {
+			return INVALID_CHARACTER;
+		}
+
+		start = fs;
+		end = se - 1;
+		kind = TEXT;
+
+	}
+
+	res = csvn_emit_token(text, csv_p, tokpool, num_tok, 
+			      (csvn_off)start, (csvn_off)end, line, kind, escapes);
+
+	/* CSVN_FIELD and CSVN_NONE double as the number of parsed fields */
+	return res;
+
+}
+
+int
+csvn_parse_index(const char *text, 
+		 const size_t textlen, 
+		 const struct csvn_idx *idx, 
+		 const size_t *offsets, 
+		 struct csv_p *csv_p, 
+		 struct csv_t *tokpool, 
+		 const size_t num_tok)
+{
+
+	size_t k, fs, se;
+	int after_delim, last, res;
+	int parsed = 0;
+	const struct csvn_dialect *d = csvn_dialect_of(csv_p->dialect);
+#ifdef CSVN_ROW_HOOK
+	int stop = 0;
+#endif
+#ifdef CSVN_STATS
+	csvn_off from = csv_p->pos;
+#endif
+
+	if (CSVN_FILTERED_CALLBACKS(csv_p)) {
+		return INVALID_SETTINGS;
+	}
+
+#ifdef CSVN_FILTER
+	csv_p->rowfields = 0;
+	csv_p->dropped = 0;
+#endif
+
+	CSVN_TRACE_BEGIN(parse_index);
+
+	fs = (size_t)csv_p->pos;
+	after_delim = (fs > 0 && text[fs - 1] == d->delim);
+
+	/* structurals before the parser position have already been parsed */
+	for (k = 0; k < idx->count && offsets[k] < fs; k++) {
+		continue;
+	}
+
+	for (; k <= idx->count; k++) {
+
+		last = (k == idx->count);
+		se = last ? textlen : offsets[k];
+
+		if (last && fs >= se) {
+			break;
+		}
+
+		res = csvn_index_field(text, fs, se, after_delim, 
+				       !last && text[se] == d->delim, 
+				       last && idx->quoted, 
+				       csv_p, tokpool, num_tok, d);
+		if (res > 0 && parsed == 0x7fffffff) {
+			res = OUT_OF_RANGE;
+		}
+		if (res < 0) {
+			CSVN_TRACE_END(parse_index);
+			return res;
+		}
+		parsed += res;
+
+		if (last) {
+			fs = se;
+			break;
+		}
+
+		if (((d->flags & CSVN_DIALECT_CRLF) && text[se] == '\r') || text[se] == d->newline) {
+			res = CSVN_MARK_ROW(csv_p, (csvn_off)se, csv_p->line);
+			if (res != 0) {
+				CSVN_TRACE_END(parse_index);
+				return res;
+			}
+		}
+
+		if ((d->flags & CSVN_DIALECT_CRLF) && text[se] == '\r') {
+
+			CSVN_NEXT_ROW(csv_p);
+
+			/* the '\n' of "\r\n" is a structural of its own unless it is the delimiter */
+			if (se + 1 < textlen && text[se + 1] == '\n') {
+				se++;
+				if (k + 1 < idx->count && offsets[k + 1] == se) {
+					k++;
+				}
+			}
+
+			csv_p->line++;
+			csv_p->linestart = (csvn_off)se + 1;
+			after_delim = 0;
+
+		} else if (text[se] == d->newline) {
+			CSVN_NEXT_ROW(csv_p);
+			csv_p->line++;
+			csv_p->linestart = (csvn_off)se + 1;
+			after_delim = 0;
+		} else {
+			after_delim = 1;
+			CSVN_NEXT_COLUMN(csv_p);
+		}
+
+		fs = se + 1;
+
+		#ifdef CSVN_CALLBACKS
+		if (csv_p->stopped) {
+			break;
+		}
+		#endif
+
+	}
+
+	csv_p->pos = (csvn_off)fs;
+
+#ifdef CSVN_CALLBACKS
+	stop = csv_p->stopped;
+	csv_p->stopped = 0;
+#endif
+#ifdef CSVN_ROW_HOOK
+	/* unless on_field stopped the parser, the text ends the last row */
+	if (!stop) {
+		csvn_end_row(csv_p);
+	}
+#endif
+#ifdef CSVN_FILTER
+	parsed -= csv_p->dropped;
+#endif
+
+	CSVN_STAT(csv_p, calls++);
+	CSVN_STAT(csv_p, bytes += (size_t)(csv_p->pos - from));
+	CSVN_TRACE_END(parse_index);
+
+	return parsed;
+
+}
+#endif
+
+#ifdef CSVN_PARALLEL
+static void
+csvn_chunk_quotes(struct csvn_chunk *chunk)
+{
+
+	size_t pos = chunk->begin;
+
+	chunk->quoted = 0;
+	chunk->nul = chunk->end;
+
+	for (;;) {
+
+		pos = csvn_scan(chunk->text, pos, chunk->end, chunk->dialect->quote, 
+				CSVN_OR_NUL(chunk->dialect->quote), chunk->dialect->quote, 
+				CSVN_OR_NUL(chunk->dialect->quote), chunk->dialect->quote);
+		if (pos >= chunk->end) {
+			break;
+		}
+
+		#ifndef CSVN_LENGTH_ONLY
+		if (chunk->text[pos] == '\0') {
+			chunk->nul = pos;
+			break;
+		}
+		#endif
+
+		chunk->quoted ^= 1;
+		pos++;
+
+	}
+
+}
+
+static void
+csvn_chunk_start(struct csvn_chunk *chunk)
+{
+
+	size_t pos = chunk->begin;
+	int quoted = chunk->quoted;
+
+	/* the first record of a chunk starts right after an unquoted newline */
+	for (;;) {
+
+		pos = csvn_scan(chunk->text, pos, chunk->textlen, 
+				chunk->dialect->quote, chunk->dialect->newline, 
+				chunk->dialect->quote, chunk->dialect->newline, 
+				CSVN_OR_CR(chunk->dialect));
+		if (pos >= chunk->textlen) {
+			break;
+		}
+
+		if (chunk->text[pos] == chunk->dialect->quote) {
+			quoted ^= 1;
+		} else if (!quoted) {
+			/* the record starts after the whole of "\r\n" */
+			if ((chunk->dialect->flags & CSVN_DIALECT_CRLF) && 
+			    chunk->text[pos] == '\r' && pos + 1 < chunk->textlen && 
+			    chunk->text[pos + 1] == '\n') {
+				pos++;
+			}
+			pos++;
+			break;
+		}
+
+		pos++;
+
+	}
+
+	chunk->start = pos;
+
+}
+
+static void *
+csvn_chunk_grow(void *ctx, void *ptr, size_t size)
+{
+
+	(void)ctx;
+
+	return realloc(ptr, size);
+
+}
+
+static void
+csvn_chunk_parse(struct csvn_chunk *chunk)
+{
+
+	CSVN_TRACE_BEGIN(chunk);
+	chunk->res = csvn_parse_text(chunk->text, chunk->end, &chunk->parser, 
+				     NULL, 0, chunk->more);
+	CSVN_TRACE_END(chunk);
+
+}
+
+static void
+csvn_chunk_copy(struct csvn_chunk *chunk)
+{
+
+	int i;
+
+	for (i = 0; chunk->out != NULL && i < chunk->parser.toknext; i++) {
+		chunk->out[i] = chunk->parser.tokens[i];
+#ifndef CSVN_PACKED
+		chunk->out[i].line += chunk->lines;
+#endif
+	}
+
+	for (i = 0; chunk->rowout != NULL && i < chunk->parser.rownext; i++) {
+		chunk->rowout[i] = chunk->parser.rows[i];
+		chunk->rowout[i].token += chunk->tokbase;
+		chunk->rowout[i].line += chunk->lines;
+	}
+
+}
+
+static void *
+csvn_chunk_worker(void *arg)
+{
+
+	struct csvn_chunk *chunk = (struct csvn_chunk *)arg;
+
+	switch (chunk->phase) {
+
+	case 0:
+		csvn_chunk_quotes(chunk);
+		break;
+
+	case 1:
+		csvn_chunk_start(chunk);
+		break;
+
+	case 2:
+		csvn_chunk_parse(chunk);
+		break;
+
+	default:
+		csvn_chunk_copy(chunk);
+		break;
+
+	}
+
+	return NULL;
+
+}
+
+static void
+csvn_run_chunks(struct csvn_chunk *chunks, int nchunks, int phase)
+{
+
+	int i;
+
+	for (i = 0; i < nchunks; i++) {
+
+		chunks[i].phase = phase;
+		chunks[i].running = 0;
+
+		/* the calling thread takes the first chunk itself */
+		if (i > 0 && pthread_create(&chunks[i].thread, NULL, 
+					    csvn_chunk_worker, &chunks[i]) == 0) {
+			chunks[i].running = 1;
+		}
+
+	}
+
+	for (i = nchunks - 1; i >= 0; i--) {
+
+		if (chunks[i].running) {
+			pthread_join(chunks[i].thread, NULL);
+		} else {
+			csvn_chunk_worker(&chunks[i]);
+		}
+
+	}
+
+}
+
+int
+csvn_parse_parallel(const char *text, 
+		    const size_t textlen, 
+		    int nthreads, 
+		    struct csv_p *csv_p, 
+		    struct csv_t *tokpool, 
+		    const size_t num_tok)
+{
+
+	struct csvn_chunk *chunks;
+	struct csv_t *pool = NULL;
+	size_t begin, len, total, rowtotal;
+	int nchunks, valid, i, res, over;
+	int parsed = 0;
+	int store = (tokpool != NULL && num_tok != 0) || csv_p->grow != NULL;
+
+	begin = (size_t)csv_p->pos;
+	len = (begin < textlen) ? textlen - begin : 0;
+
+	if ((size_t)nthreads > len / CSVN_PARALLEL_MIN) {
+		nthreads = (int)(len / CSVN_PARALLEL_MIN);
+	}
+
+	/* chunks start with a new row, so the parser has to be at one too */
+	if (nthreads <= 1 || csv_p->state != IDLE || 
+	    (csv_p->rows != NULL && csv_p->pos != csv_p->linestart) || 
+	    CSVN_HAS_COLUMNS(csv_p) || CSVN_HAS_FILTER(csv_p) || CSVN_HAS_CALLBACKS(csv_p) || 
+	    CSVN_HAS_MARKS(csv_p)) {
+		return csvn_parse(text, textlen, csv_p, tokpool, num_tok);
+	}
+
+	chunks = (struct csvn_chunk *)calloc((size_t)nthreads, sizeof(struct csvn_chunk));
+	if (chunks == NULL) {
+		return NOT_ENOUGH_MEM;
+	}
+
+	for (i = 0; i < nthreads; i++) {
+		chunks[i].text = text;
+		chunks[i].textlen = textlen;
+		chunks[i].dialect = csvn_dialect_of(csv_p->dialect);
+		chunks[i].begin = begin + len / nthreads * i;
+		chunks[i].end = (i == nthreads - 1) ? textlen : begin + len / nthreads * (i + 1);
+	}
+
+	/* 
+	   phase 0: quote parity of every chunk tells the quote state at the 
+	   beginning of the next ones (csvn_parse stops at '\0' so do we, 
+	   unless CSVN_LENGTH_ONLY is defined)
+	*/
+	csvn_run_chunks(chunks, nthreads, 0);
+
+	nchunks = nthreads;
+	for (i = 0; i < nthreads; i++) {
+
+		if (chunks[i].nul != chunks[i].end) {
+			chunks[i].end = chunks[i].textlen = chunks[i].nul;
+			nchunks = i + 1;
+			break;
+		}
+
+	}
+
+	for (i = nchunks - 1; i > 0; i--) {
+		chunks[i].quoted = chunks[i - 1].quoted;
+		chunks[i].textlen = chunks[nchunks - 1].end;
+	}
+	chunks[0].textlen = chunks[nchunks - 1].end;
+	for (i = 2; i < nchunks; i++) {
+		chunks[i].quoted ^= chunks[i - 1].quoted;
+	}
+
+	/* phase 1: find the first record of each chunk */
+	csvn_run_chunks(chunks + 1, nchunks - 1, 1);
+	chunks[0].start = begin;
+
+	for (i = 0; i < nchunks; i++) {
+
+		if (i > 0 && chunks[i].start < chunks[i - 1].start) {
+			chunks[i].start = chunks[i - 1].start;
+		}
+
+		chunks[i].end = (i == nchunks - 1) ? chunks[i].textlen : chunks[i + 1].start;
+		/* only the last chunk knows that nothing follows */
+		chunks[i].more = (i != nchunks - 1);
+
+		csvn_init(&chunks[i].parser);
+		chunks[i].parser.pos = (csvn_off)chunks[i].start;
+
+		chunks[i].parser.linestart = chunks[i].parser.pos;
+		chunks[i].parser.dialect = csv_p->dialect;
+#ifdef CSVN_PROJECTION
+		chunks[i].parser.projection = csv_p->projection;
+		chunks[i].parser.num_proj = csv_p->num_proj;
+#endif
+#ifdef CSVN_STATS
+		if (csv_p->stats != NULL) {
+			chunks[i].parser.stats = &chunks[i].stats;
+		}
+#endif
+
+		/* every chunk parses into a pool of its own */
+		if (store || csv_p->rows != NULL) {
+			chunks[i].parser.grow = csvn_chunk_grow;
+		}
+
+#ifdef CSVN_ARENA
+		/* so does every thread with an arena of its own, freed at once */
+		if (csv_p->grow == csvn_arena_grow) {
+			csvn_arena_init(&chunks[i].arena, 0);
+			chunks[i].parser.grow = csvn_arena_grow;
+			chunks[i].parser.ctx = &chunks[i].arena;
+		}
+#endif
+
+		if (csv_p->rows != NULL) {
+
+			chunks[i].parser.rows = (struct csv_r *)chunks[i].parser.grow(chunks[i].parser.ctx, 
+										       NULL, 32 * sizeof(struct csv_r));
+			if (chunks[i].parser.rows != NULL) {
+				chunks[i].parser.num_row = 32;
+				chunks[i].parser.ownrows = 1;
+			}
+
+		}
+
+	}
+
+	/* phase 2: parse all chunks */
+	csvn_run_chunks(chunks, nchunks, 2);
+
+	/*
+	   a chunk is valid if the previous one ended exactly at its start 
+	   between two fields, which is where csvn_parse would be as well
+	*/
+	total = rowtotal = 0;
+	chunks[0].lines = csv_p->line - 1;
+	res = 0;
+
+	for (valid = 0; valid < nchunks; valid++) {
+
+		struct csvn_chunk *chunk = &chunks[valid];
+
+		if (csv_p->rows != NULL && chunk->parser.rows == NULL) {
+			chunk->res = NOT_ENOUGH_MEM;
+		}
+
+		total += (size_t)chunk->parser.toknext;
+		rowtotal += (size_t)chunk->parser.rownext;
+		if (valid + 1 < nchunks) {
+			chunks[valid + 1].lines = chunk->lines + chunk->parser.line - 1;
+		}
+
+		if (chunk->res > 0x7fffffff - parsed) {
+			chunk->res = OUT_OF_RANGE;
+		}
+
+		if (chunk->res < 0) {
+			valid++;
+			res = chunk->res;
+			break;
+		}
+
+		parsed += chunk->res;
+
+		/* a '\r' not followed by '\n' may end a chunk as well */
+		if (valid + 1 < nchunks && 
+		    ((chunk->parser.state != IDLE && chunk->parser.state != AFTER_CR) || 
+		     chunk->parser.pos != (csvn_off)chunks[valid + 1].start)) {
+			valid++;
+			res = CSVN_MORE;
+			break;
+		}
+
+	}
+
+	/* toknext and rownext are ints */
+	over = total > (size_t)(0x7fffffff - csv_p->toknext) || 
+	       rowtotal > (size_t)(0x7fffffff - csv_p->rownext);
+
+	if (store && !over) {
+		pool = csvn_grow_tokens(csv_p, (csv_p->tokens != NULL) ? csv_p->tokens : tokpool, 
+					num_tok, (size_t)csv_p->toknext + total);
+	}
+
+	if (over) {
+
+		res = OUT_OF_RANGE;
+
+	} else if ((store && pool == NULL) || 
+		   (csv_p->rows != NULL && 
+		    csvn_grow_rows(csv_p, (size_t)csv_p->rownext + rowtotal) != 0)) {
+
+		res = NOT_ENOUGH_MEM;
+
+	} else {
+
+		struct csvn_chunk *last = &chunks[valid - 1];
+		int tokbase = csv_p->toknext, rowbase = csv_p->rownext;
+
+		for (i = 0; i < valid; i++) {
+
+			chunks[i].tokbase = tokbase;
+			if (store) {
+				chunks[i].out = pool + tokbase;
+			}
+			tokbase += chunks[i].parser.toknext;
+
+			if (csv_p->rows != NULL) {
+				chunks[i].rowout = csv_p->rows + rowbase;
+			}
+			rowbase += chunks[i].parser.rownext;
+
+		}
+
+		if (store || csv_p->rows != NULL) {
+			csvn_run_chunks(chunks, valid, 3);
+		}
+
+		#ifdef CSVN_STATS
+		/* the chunks which are not valid are parsed again below */
+		for (i = 0; csv_p->stats != NULL && i < valid; i++) {
+			csvn_add_stats(csv_p->stats, &chunks[i].stats);
+		}
+		#endif
+		CSVN_STAT(csv_p, calls++);
+
+		csv_p->pos = last->parser.pos;
+		csv_p->line = last->parser.line + last->lines;
+		csv_p->state = last->parser.state;
+		csv_p->start = last->parser.start;
+		csv_p->tokline = last->parser.tokline + last->lines;
+		csv_p->escapes = last->parser.escapes;
+		#ifdef CSVN_COUNT_COLUMNS
+		csv_p->colfield = last->parser.colfield;
+		#endif
+		csv_p->toknext += (int)total;
+		csv_p->rownext += (int)rowtotal;
+		csv_p->linestart = last->parser.linestart;
+
+		if (res == CSVN_MORE) {
+
+			/* the guess was wrong (quotes are not RFC 4180), go on sequentially */
+			res = csvn_parse_text(text, chunks[0].textlen, csv_p, 
+					      tokpool, num_tok, 0);
+			if (res > 0x7fffffff - parsed) {
+				res = OUT_OF_RANGE;
+			}
+			if (res >= 0) {
+				parsed += res;
+				res = 0;
+			}
+
+		}
+
+	}
+
+	for (i = 0; i < nchunks; i++) {
+#ifdef CSVN_ARENA
+		if (chunks[i].parser.grow == csvn_arena_grow) {
+			csvn_arena_free(&chunks[i].arena);
+			continue;
+		}
+#endif
+		free(chunks[i].parser.tokens);
+		free(chunks[i].parser.rows);
+	}
+	free(chunks);
+
+	return (res < 0) ? res : parsed;
+
+}
+#endif
+
+#ifdef CSVN_BATCH
+static int
+csvn_compare_tasks(const void *a, const void *b)
+{
+
+	const struct csvn_task *x = (const struct csvn_task *)a;
+	const struct csvn_task *y = (const struct csvn_task *)b;
+
+	if (x->len != y->len) {
+		return (x->len > y->len) ? -1 : 1;
+	}
+
+	return x->job - y->job;
+
+}
+
+static int
+csvn_take_task(struct csvn_worker *worker)
+{
+
+	struct csvn_sched *sched = worker->sched;
+	struct csvn_worker *victim;
+	int job = -1, i;
+
+	pthread_mutex_lock(&worker->lock);
+	if (worker->head < worker->tail) {
+		job = worker->tasks[worker->head++].job;
+	}
+	pthread_mutex_unlock(&worker->lock);
+
+	/* no task is ever added, so once all are gone the batch is done */
+	for (i = 1; job < 0 && i < sched->num_workers; i++) {
+
+		victim = &sched->workers[(worker - sched->workers + i) % sched->num_workers];
+
+		pthread_mutex_lock(&victim->lock);
+		if (victim->head < victim->tail) {
+			job = victim->tasks[--victim->tail].job;
+		}
+		pthread_mutex_unlock(&victim->lock);
+
+	}
+
+	return job;
+
+}
+
+static void *
+csvn_batch_worker(void *arg)
+{
+
+	struct csvn_worker *worker = (struct csvn_worker *)arg;
+	struct csvn_sched *sched = worker->sched;
+	struct csvn_job *job;
+	int i, idle;
+
+	while ((i = csvn_take_task(worker)) >= 0) {
+
+		job = &sched->jobs[i];
+
+		if (job->res == 0) {
+
+			job->split = (sched->share > 0) ? (int)(job->textlen / sched->share) : 1;
+
+			/* the worker itself and the threads no other job is using */
+			pthread_mutex_lock(&sched->lock);
+			idle = sched->nthreads - sched->busy;
+			if (job->split > idle) {
+				job->split = idle;
+			}
+			if (job->split < 1) {
+				job->split = 1;
+			}
+			sched->busy += job->split;
+			pthread_mutex_unlock(&sched->lock);
+
+			job->res = csvn_parse_parallel(job->text, job->textlen, job->split, 
+						       &job->parser, job->tokpool, job->num_tok);
+
+			pthread_mutex_lock(&sched->lock);
+			sched->busy -= job->split;
+			pthread_mutex_unlock(&sched->lock);
+
+		}
+
+		/* one worker at a time delivers, the others leave their jobs to it */
+		pthread_mutex_lock(&sched->lock);
+		sched->done[i] = 1;
+		if (!sched->delivering) {
+
+			sched->delivering = 1;
+			while (sched->delivered < sched->num_jobs && sched->done[sched->delivered]) {
+				job = &sched->jobs[sched->delivered];
+				pthread_mutex_unlock(&sched->lock);
+				if (sched->on_done != NULL) {
+					sched->on_done(sched->ctx, job);
+				}
+				pthread_mutex_lock(&sched->lock);
+				sched->delivered++;
+			}
+			sched->delivering = 0;
+
+		}
+		pthread_mutex_unlock(&sched->lock);
+
+	}
+
+	return NULL;
+
+}
+
+int
+csvn_parse_batch(struct csvn_job *jobs, 
+		 int num_jobs, 
+		 int nthreads, 
+		 void (*on_done)(void *ctx, struct csvn_job *job), 
+		 void *ctx)
+{
+
+	struct csvn_sched sched;
+	struct csvn_task *tasks;
+	size_t total = 0;
+	int i, w, next;
+
+	if (num_jobs <= 0) {
+		return 0;
+	}
+
+	if (nthreads < 1) {
+		nthreads = 1;
+	}
+
+	sched.jobs = jobs;
+	sched.num_jobs = num_jobs;
+	sched.nthreads = nthreads;
+	sched.num_workers = (nthreads < num_jobs) ? nthreads : num_jobs;
+	sched.busy = 0;
+	sched.delivered = 0;
+	sched.delivering = 0;
+	sched.on_done = on_done;
+	sched.ctx = ctx;
+
+	sched.workers = (struct csvn_worker *)calloc((size_t)sched.num_workers, 
+						     sizeof(struct csvn_worker));
+	sched.done = (unsigned char *)calloc((size_t)num_jobs, 1);
+	tasks = (struct csvn_task *)malloc((size_t)num_jobs * 2 * sizeof(struct csvn_task));
+	if (sched.workers == NULL || sched.done == NULL || tasks == NULL) {
+		free(sched.workers);
+		free(sched.done);
+		free(tasks);
+		return NOT_ENOUGH_MEM;
+	}
+
+	for (i = 0; i < num_jobs; i++) {
+
+		jobs[i].res = 0;
+		jobs[i].split = 0;
+
+		/* mapping is cheap, the pages are only read by the workers */
+		#ifdef CSVN_MMAP
+		if (jobs[i].path != NULL) {
+			if (csvn_open_mmap(jobs[i].path, &jobs[i].map) != 0) {
+				jobs[i].res = IO_ERROR;
+			}
+			jobs[i].text = jobs[i].map.text;
+			jobs[i].textlen = jobs[i].map.textlen;
+		}
+		#endif
+
+		tasks[i].len = jobs[i].textlen;
+		tasks[i].job = i;
+		total += jobs[i].textlen;
+
+	}
+
+	sched.share = total / (size_t)nthreads;
+
+	/* the sorted tasks are dealt out, so that every worker starts with its largest */
+	qsort(tasks, (size_t)num_jobs, sizeof(struct csvn_task), csvn_compare_tasks);
+
+	for (w = 0, next = num_jobs; w < sched.num_workers; w++) {
+
+		sched.workers[w].sched = &sched;
+		sched.workers[w].tasks = tasks + next;
+		for (i = w; i < num_jobs; i += sched.num_workers) {
+			tasks[next++] = tasks[i];
+		}
+		sched.workers[w].tail = (int)(tasks + next - sched.workers[w].tasks);
+
+	}
+
+	pthread_mutex_init(&sched.lock, NULL);
+	for (w = 0; w < sched.num_workers; w++) {
+		pthread_mutex_init(&sched.workers[w].lock, NULL);
+	}
+
+	/* the calling thread is the first worker, the others steal its tasks if they cannot start */
+	for (w = 1; w < sched.num_workers; w++) {
+		if (pthread_create(&sched.workers[w].thread, NULL, 
+				   csvn_batch_worker, &sched.workers[w]) == 0) {
+			sched.workers[w].running = 1;
+		}
+	}
+
+	csvn_batch_worker(&sched.workers[0]);
+
+	for (w = 1; w < sched.num_workers; w++) {
+		if (sched.workers[w].running) {
+			pthread_join(sched.workers[w].thread, NULL);
+		}
+	}
+
+	for (w = 0; w < sched.num_workers; w++) {
+		pthread_mutex_destroy(&sched.workers[w].lock);
+	}
+	pthread_mutex_destroy(&sched.lock);
+
+	free(sched.workers);
+	free(sched.done);
+	free(tasks);
+
+	return 0;
+
+}
+#endif
+
+#ifdef CSVN_MMAP
+int
+csvn_open_mmap(const char *path, struct csvn_mmap *map)
+{
+
+	struct stat st;
+	void *addr;
+	int fd, flags = MAP_PRIVATE;
+
+	map->text = "";
+	map->textlen = 0;
+	map->released = 0;
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		return IO_ERROR;
+	}
+
+	if (fstat(fd, &st) != 0 || (off_t)(size_t)st.st_size != st.st_size) {
+		close(fd);
+		return IO_ERROR;
+	}
+
+	if (st.st_size == 0) {
+		close(fd);
+		return 0;
+	}
+
+	#if defined(CSVN_MMAP_POPULATE) && defined(MAP_POPULATE)
+	flags |= MAP_POPULATE;
+	#endif
+
+	/* the mapping outlives the descriptor */
+	addr = mmap(NULL, (size_t)st.st_size, PROT_READ, flags, fd, 0);
+	close(fd);
+
+	if (addr == MAP_FAILED) {
+		return IO_ERROR;
+	}
+
+	#ifdef MADV_SEQUENTIAL
+	madvise(addr, (size_t)st.st_size, MADV_SEQUENTIAL);
+	#endif
+
+	/* only a hint, most file systems do not map files with huge pages */
+	#ifdef MADV_HUGEPAGE
+	madvise(addr, (size_t)st.st_size, MADV_HUGEPAGE);
+	#endif
+
+	map->text = (const char *)addr;
+	map->textlen = (size_t)st.st_size;
+
+	return 0;
+
+}
+
+void
+csvn_release_mmap(struct csvn_mmap *map, size_t n)
+{
+
+	size_t page = (size_t)sysconf(_SC_PAGESIZE);
+
+	if (n > map->textlen) {
+		n = map->textlen;
+	}
+
+	/* only whole pages can be released */
+	n -= n % page;
+	if (n <= map->released) {
+		return;
+	}
+
+	#ifdef MADV_DONTNEED
+	madvise((void *)(map->text + map->released), n - map->released, MADV_DONTNEED);
+	#endif
+
+	map->released = n;
+
+}
+
+void
+csvn_close_mmap(struct csvn_mmap *map)
+{
+
+	if (map->textlen != 0) {
+		munmap((void *)map->text, map->textlen);
+	}
+
+	map->text = "";
+	map->textlen = 0;
+	map->released = 0;
+
+}
+#endif
+
+#ifdef CSVN_PIPELINE
+static ssize_t
+csvn_read_fd(int fd, char *dst, size_t len)
+{
+
+	ssize_t got;
+
+	do {
+		got = read(fd, dst, len);
+	} while (got < 0 && errno == EINTR);
+
+	return (got < 0) ? (ssize_t)IO_ERROR : got;
+
+}
+
+#ifdef CSVN_HAS_CODEC
+/* reads enough of the stream to tell its codec by its magic number */
+static int
+csvn_detect_codec(struct csvn_pipeline *pl)
+{
+
+	const unsigned char *magic = (const unsigned char *)pl->input;
+	ssize_t got;
+
+	while (pl->inend < 4 && !pl->eof) {
+		got = csvn_read_fd(pl->fd, pl->input + pl->inend, pl->inlen - pl->inend);
+		if (got < 0) {
+			return (int)got;
 		}
+		pl->eof = (got == 0);
+		pl->inend += (size_t)got;
+	}
+
+#ifdef CSVN_GZIP
+	if (pl->inend >= 2 && magic[0] == 0x1F && magic[1] == 0x8B) {
+
+		/* gzip members only, not zlib or raw deflate */
+		memset(&pl->gz, 0, sizeof(pl->gz));
+		if (inflateInit2(&pl->gz, 15 + 16) != Z_OK) {
+			return NOT_ENOUGH_MEM;
+		}
+		pl->codec = CSVN_CODEC_GZIP;
+		return 0;
+
+	}
+#endif
+
+#ifdef CSVN_ZSTD
+	if (pl->inend >= 4 && magic[0] == 0x28 && magic[1] == 0xB5 && 
+	    magic[2] == 0x2F && magic[3] == 0xFD) {
+
+		pl->zstd = ZSTD_createDCtx();
+		if (pl->zstd == NULL) {
+			return NOT_ENOUGH_MEM;
+		}
+		pl->codec = CSVN_CODEC_ZSTD;
+		return 0;
+
+	}
+#endif
+
+	(void)magic;
+	pl->codec = CSVN_CODEC_PLAIN;
+
+	return 0;
+
+}
+
+#ifdef CSVN_GZIP
+static int
+csvn_gunzip(struct csvn_pipeline *pl, char *dst, size_t len, size_t *done)
+{
+
+	/* zlib counts in uInt */
+	uInt in = (uInt)(pl->inend - pl->inpos);
+	uInt out = (len - *done > 0x40000000) ? 0x40000000 : (uInt)(len - *done);
+	int res;
+
+	pl->gz.next_in = (Bytef *)pl->input + pl->inpos;
+	pl->gz.avail_in = in;
+	pl->gz.next_out = (Bytef *)dst + *done;
+	pl->gz.avail_out = out;
+
+	res = inflate(&pl->gz, Z_NO_FLUSH);
+
+	pl->inpos += in - pl->gz.avail_in;
+	*done += out - pl->gz.avail_out;
+
+	/* concatenated members make a single stream */
+	if (res == Z_STREAM_END) {
+		inflateReset(&pl->gz);
+		pl->pending = 0;
+	} else if (res == Z_OK) {
+		pl->pending = 1;
+	} else if (res != Z_BUF_ERROR) {
+		return IO_ERROR;
+	}
+
+	return 0;
+
+}
+#endif
+
+#ifdef CSVN_ZSTD
+static int
+csvn_unzstd(struct csvn_pipeline *pl, char *dst, size_t len, size_t *done)
+{
+
+	ZSTD_inBuffer in;
+	ZSTD_outBuffer out;
+	size_t res, inpos = pl->inpos, outpos = *done;
+
+	in.src = pl->input;
+	in.size = pl->inend;
+	in.pos = pl->inpos;
+	out.dst = dst;
+	out.size = len;
+	out.pos = *done;
+
+	res = ZSTD_decompressStream(pl->zstd, &out, &in);
+	if (ZSTD_isError(res)) {
+		return IO_ERROR;
+	}
+
+	/* without any progress, the hint says nothing of the frame */
+	pl->inpos = in.pos;
+	*done = out.pos;
+	if (in.pos != inpos || out.pos != outpos) {
+		pl->pending = (res != 0);
+	}
+
+	return 0;
+
+}
+#endif
+
+/* decompresses the stream into dst until it is full or the stream ends */
+static ssize_t
+csvn_decode(struct csvn_pipeline *pl, char *dst, size_t len)
+{
+
+	size_t done = 0, before, n;
+	ssize_t got;
+	int res = 0;
+
+	if (pl->codec == CSVN_CODEC_UNKNOWN) {
+		res = csvn_detect_codec(pl);
+		if (res < 0) {
+			return res;
+		}
+	}
+
+	/* a plain stream is read right into the buffers, but for its start */
+	if (pl->codec == CSVN_CODEC_PLAIN) {
+
+		if (pl->inpos == pl->inend) {
+			return pl->eof ? 0 : csvn_read_fd(pl->fd, dst, len);
+		}
+
+		n = (pl->inend - pl->inpos < len) ? pl->inend - pl->inpos : len;
+		memcpy(dst, pl->input + pl->inpos, n);
+		pl->inpos += n;
+
+		return (ssize_t)n;
+
+	}
+
+	while (done < len) {
+
+		if (pl->inpos == pl->inend && !pl->eof) {
+			got = csvn_read_fd(pl->fd, pl->input, pl->inlen);
+			if (got < 0) {
+				return got;
+			}
+			pl->eof = (got == 0);
+			pl->inpos = 0;
+			pl->inend = (size_t)got;
+		}
+
+		before = done;
+		#ifdef CSVN_GZIP
+		if (pl->codec == CSVN_CODEC_GZIP) {
+			res = csvn_gunzip(pl, dst, len, &done);
+		}
+		#endif
+		#ifdef CSVN_ZSTD
+		if (pl->codec == CSVN_CODEC_ZSTD) {
+			res = csvn_unzstd(pl, dst, len, &done);
+		}
+		#endif
+		if (res < 0) {
+			return res;
+		}
+
+		/* the decompressor is flushed at the end of the stream */
+		if (done == before && pl->inpos == pl->inend && pl->eof) {
+			if (pl->pending) {
+				return IO_ERROR;
+			}
+			break;
+		}
+
+	}
+
+	return (ssize_t)done;
+
+}
+#endif
+
+static void *
+csvn_pipeline_read(void *arg)
+{
+
+	struct csvn_pipeline *pl = (struct csvn_pipeline *)arg;
+	size_t half = pl->buflen / 2;
+	void (*on_ready)(void *);
+	void *ctx;
+	ssize_t got;
+	int slot;
+
+	for (;;) {
+
+		/* the buffer of the current window is never read into */
+		pthread_mutex_lock(&pl->lock);
+		while (!pl->stop && pl->produced - pl->released >= (unsigned long)pl->num_buf) {
+			pthread_cond_wait(&pl->cond, &pl->lock);
+		}
+		slot = (int)(pl->produced % (unsigned long)pl->num_buf);
+		if (pl->stop) {
+			pthread_mutex_unlock(&pl->lock);
+			return NULL;
+		}
+		pthread_mutex_unlock(&pl->lock);
+
+		#ifdef CSVN_HAS_CODEC
+		if (pl->input != NULL) {
+			got = csvn_decode(pl, pl->buffer + (size_t)slot * pl->buflen + half, 
+					  pl->buflen - half);
+		} else
+		#endif
+		got = csvn_read_fd(pl->fd, pl->buffer + (size_t)slot * pl->buflen + half, 
+				   pl->buflen - half);
+
+		pthread_mutex_lock(&pl->lock);
+		pl->got[slot] = (got > 0) ? (size_t)got : 0;
+		pl->state[slot] = (got > 0) ? 0 : (got == 0) ? 1 : (int)got;
+		pl->produced++;
+		on_ready = pl->on_ready;
+		ctx = pl->ready_ctx;
+		pl->on_ready = NULL;
+		pthread_cond_broadcast(&pl->cond);
+		pthread_mutex_unlock(&pl->lock);
+
+		if (on_ready != NULL) {
+			on_ready(ctx);
+		}
+
+		if (got <= 0) {
+			return NULL;
+		}
+
+	}
+
+}
+
+/* sets up the ring of buffers, up to starting the thread */
+static int
+csvn_setup_pipeline(struct csvn_pipeline *pl, int fd, char *buffer, size_t buflen, int num_buf)
+{
+
+	if (num_buf < 2 || num_buf > CSVN_PIPELINE_MAX || buflen / num_buf < 2) {
+		return OUT_OF_RANGE;
+	}
+
+	pl->text = buffer;
+	pl->textlen = 0;
+	pl->last = 0;
+	pl->fd = fd;
+	pl->buffer = buffer;
+	pl->buflen = buflen / num_buf;
+	pl->num_buf = num_buf;
+	pl->produced = 0;
+	pl->consumed = 0;
+	pl->released = 0;
+	pl->stop = 0;
+	pl->finished = 0;
+	pl->on_ready = NULL;
+	pl->ready_ctx = NULL;
+
+#ifdef CSVN_HAS_CODEC
+	pl->codec = CSVN_CODEC_PLAIN;
+	pl->input = NULL;
+	pl->inlen = 0;
+	pl->inpos = 0;
+	pl->inend = 0;
+	pl->eof = 0;
+	pl->pending = 0;
+#endif
+
+	return 0;
+
+}
+
+static int
+csvn_spawn_pipeline(struct csvn_pipeline *pl)
+{
+
+	if (pthread_mutex_init(&pl->lock, NULL) != 0) {
+		return IO_ERROR;
+	}
+	if (pthread_cond_init(&pl->cond, NULL) != 0) {
+		pthread_mutex_destroy(&pl->lock);
+		return IO_ERROR;
+	}
+	if (pthread_create(&pl->thread, NULL, csvn_pipeline_read, pl) != 0) {
+		pthread_cond_destroy(&pl->cond);
+		pthread_mutex_destroy(&pl->lock);
+		return IO_ERROR;
+	}
+
+	return 0;
+
+}
+
+int
+csvn_start_pipeline(struct csvn_pipeline *pl, int fd, char *buffer, size_t buflen, int num_buf)
+{
+
+	int res = csvn_setup_pipeline(pl, fd, buffer, buflen, num_buf);
+
+	return (res < 0) ? res : csvn_spawn_pipeline(pl);
+
+}
 
-		csvn_fill_token(token, start, end, line, DQUOTE);
+#ifdef CSVN_HAS_CODEC
+int
+csvn_start_decoder(struct csvn_pipeline *pl, int fd, char *buffer, size_t buflen, int num_buf)
+{
+
+	size_t part;
+	int res;
+
+	if (num_buf < 2 || num_buf > CSVN_PIPELINE_MAX) {
+		return OUT_OF_RANGE;
 	}
 
-	return 0;
+	/* the magic number has to fit into the input */
+	part = buflen / (size_t)(num_buf + 1);
+	if (part < 4) {
+		return OUT_OF_RANGE;
+	}
+
+	res = csvn_setup_pipeline(pl, fd, buffer, part * (size_t)num_buf, num_buf);
+	if (res < 0) {
+		return res;
+	}
+
+	pl->codec = CSVN_CODEC_UNKNOWN;
+	pl->input = buffer + part * (size_t)num_buf;
+	pl->inlen = part;
+
+	return csvn_spawn_pipeline(pl);
 
 }
+#endif
 
+int
+csvn_next_window(struct csvn_pipeline *pl, struct csv_p *csv_p)
+{
 
-static int 
-csvn_parse_normal(const char *text, 
-		  const size_t textlen, 
-		  struct csv_p *csv_p, 
-		  struct csv_t *tokpool, 
-		  const size_t num_tok)
+	size_t half = pl->buflen / 2;
+	size_t discard = 0, carry = 0;
+	char *window;
+	int slot, state;
+
+	if (pl->consumed > pl->released) {
+		discard = csvn_discardable(csv_p);
+		carry = pl->textlen - discard;
+	}
+
+	pthread_mutex_lock(&pl->lock);
+
+	/* nothing is left once the last window is given back */
+	if (pl->last || pl->finished) {
+		pl->released = pl->consumed;
+		pl->last = 0;
+		pl->textlen = 0;
+		pl->finished = 1;
+		pthread_cond_broadcast(&pl->cond);
+		pthread_mutex_unlock(&pl->lock);
+		return 0;
+	}
+
+	if (pl->consumed > pl->released && carry > half) {
+		pthread_mutex_unlock(&pl->lock);
+		return FIELD_TOO_LONG;
+	}
+
+	while (pl->produced == pl->consumed) {
+		pthread_cond_wait(&pl->cond, &pl->lock);
+	}
+	slot = (int)(pl->consumed % (unsigned long)pl->num_buf);
+	state = pl->state[slot];
+
+	pthread_mutex_unlock(&pl->lock);
+
+	if (state < 0) {
+		return state;
+	}
+
+	window = pl->buffer + (size_t)slot * pl->buflen + half - carry;
+	if (carry > 0) {
+		memcpy(window, pl->text + discard, carry);
+	}
+	if (pl->consumed > pl->released) {
+		csvn_discard(csv_p, discard);
+	}
+
+	pthread_mutex_lock(&pl->lock);
+	pl->released = pl->consumed;
+	pl->consumed++;
+	pthread_cond_broadcast(&pl->cond);
+	pthread_mutex_unlock(&pl->lock);
+
+	pl->text = window;
+	pl->textlen = carry + pl->got[slot];
+	pl->last = (state == 1);
+
+	return 1;
+
+}
+
+int
+csvn_notify_window(struct csvn_pipeline *pl, void (*on_ready)(void *), void *ctx)
 {
 
-	struct csv_t *token;
-	int start, end;
-	start = csv_p->pos;
+	int ready;
 
-	int line = csv_p->line;
+	pthread_mutex_lock(&pl->lock);
+	ready = pl->last || pl->finished || pl->produced != pl->consumed;
+	if (!ready) {
+		pl->on_ready = on_ready;
+		pl->ready_ctx = ctx;
+	}
+	pthread_mutex_unlock(&pl->lock);
 
-	for (; text[csv_p->pos] != '\0' && 
-	       csv_p->pos < textlen && 
-	       text[csv_p->pos] != CSVN_NEWLINE && 
-	       text[csv_p->pos] != CSVN_DELIM; csv_p->pos++) {
-	
-		#ifdef CSVN_STRICT
-		if (text[csv_p->pos] == '\"') {
-			return INVALID_CHARACTER;
+	return ready;
+
+}
+
+void
+csvn_stop_pipeline(struct csvn_pipeline *pl)
+{
+
+	pthread_mutex_lock(&pl->lock);
+	pl->stop = 1;
+	pthread_cond_broadcast(&pl->cond);
+	pthread_mutex_unlock(&pl->lock);
+
+	pthread_join(pl->thread, NULL);
+	pthread_cond_destroy(&pl->cond);
+	pthread_mutex_destroy(&pl->lock);
+
+#ifdef CSVN_GZIP
+	if (pl->codec == CSVN_CODEC_GZIP) {
+		inflateEnd(&pl->gz);
+	}
+#endif
+#ifdef CSVN_ZSTD
+	if (pl->codec == CSVN_CODEC_ZSTD) {
+		ZSTD_freeDCtx(pl->zstd);
+	}
+#endif
+
+}
+#endif
+
+#ifdef CSVN_CONVERT
+static const char *
+csvn_span(const char *text, 
+	  const struct csv_t *token, 
+	  size_t *len)
+{
+
+	if (CSVN_TOK_KIND(*token) != TEXT && CSVN_TOK_KIND(*token) != DQUOTE) {
+		return NULL;
+	}
+
+	*len = (size_t)(CSVN_TOK_SIZE(*token) + 1);
+
+	return text + CSVN_TOK_START(*token);
+
+}
+
+static int
+csvn_eight_digits(const char *p, uint32_t *value)
+{
+
+	const uint64_t ones = ~(uint64_t)0 / 0xFF;
+	uint64_t w = 0;
+	int i;
+
+	/* the first digit ends up in the lowest byte on any byte order */
+	for (i = 7; i >= 0; i--) {
+		w = (w << 8) | (unsigned char)p[i];
+	}
+
+	/* every byte has to be within '0' and '9' */
+	if ((w & (0xF0 * ones)) != 0x30 * ones || 
+	    ((w + 0x06 * ones) & (0xF0 * ones)) != 0x30 * ones) {
+		return 0;
+	}
+
+	/* combine adjacent digits, then pairs of them, then quadruples */
+	w = ((w & (0x0F * ones)) * (10 * 256 + 1)) >> 8;
+	w = ((w & (~(uint64_t)0 / 0x101)) * (100 * 65536 + 1)) >> 16;
+	w = ((w & (~(uint64_t)0 / 0x10001)) * (((uint64_t)10000 << 32) + 1)) >> 32;
+
+	*value = (uint32_t)w;
+
+	return 1;
+
+}
+
+static int
+csvn_digits(const char *p, int n)
+{
+
+	int value = 0;
+
+	for (; n > 0; n--, p++) {
+
+		if (*p < '0' || *p > '9') {
+			return -1;
 		}
-		#endif
+		value = 10 * value + (*p - '0');
+
+	}
+
+	return value;
+
+}
+
+int
+csvn_to_i64(const char *text, const struct csv_t *token, int64_t *out)
+{
+
+	const uint64_t max = ((uint64_t)1 << 63) - 1;
+	const char *p;
+	uint64_t value = 0;
+	uint32_t eight;
+	size_t len, i;
+	int neg = 0, over = 0;
+
+	p = csvn_span(text, token, &len);
+	if (p == NULL) {
+		return INVALID_CHARACTER;
+	}
+
+	if (*p == '-' || *p == '+') {
+		neg = (*p == '-');
+		p++;
+		len--;
+	}
+
+	if (len == 0) {
+		return INVALID_CHARACTER;
+	}
+
+	/* leading zeros do not count towards the 19 digits which always fit */
+	for (; len > 1 && *p == '0'; p++, len--) {
 		continue;
-	
-	}		
+	}
+
+	for (i = 0; len - i >= 8 && i < 16; i += 8) {
+
+		if (!csvn_eight_digits(p + i, &eight)) {
+			return INVALID_CHARACTER;
+		}
+		value = value * 100000000 + eight;
 
-	/* let the main loop handle newlines and delimeters */
-	if (text[csv_p->pos] == CSVN_NEWLINE || text[csv_p->pos] == CSVN_DELIM) {
-		csv_p->pos--;
 	}
 
-	end = csv_p->pos;
-	
-	if (tokpool != NULL) {
-		
-		token = csvn_allocate_token(csv_p, tokpool, num_tok);
-		if (token == NULL) {
-			return NOT_ENOUGH_MEM; 
+	for (; i < len; i++) {
+
+		if (p[i] < '0' || p[i] > '9') {
+			return INVALID_CHARACTER;
 		}
 
-		csvn_fill_token(token, start, end, line, DQUOTE);
-	}	
-	
+		if (i >= 19) {
+			over = 1;
+		} else {
+			value = 10 * value + (uint64_t)(p[i] - '0');
+		}
+
+	}
+
+	if (over || value > max + (uint64_t)neg) {
+		return OUT_OF_RANGE;
+	}
+
+	/* the most negative value cannot be negated as a positive one */
+	*out = (neg && value != 0) ? -(int64_t)(value - 1) - 1 : (int64_t)value;
+
 	return 0;
 
 }
 
 int
-csvn_parse(const char *text, 
-	   const size_t textlen, 
-	   struct csv_p *csv_p, 
-	   struct csv_t *tokpool, 
-	   const size_t num_tok)
+csvn_to_f64(const char *text, const struct csv_t *token, double *out)
 {
 
-	int parsed = 0;
-	int res = 0;
+	static const double powers[] = {
+		1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 
+		1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+	};
 
-	while(text[csv_p->pos] != '\0' && csv_p->pos < textlen) {
-	
-		switch (text[csv_p->pos]) {
-	
-		case CSVN_NEWLINE:
-			csv_p->line++;
-			csv_p->pos++;
-			break;
+	char copy[64];
+	const char *p;
+	size_t len, i = 0;
+	uint64_t mantissa = 0;
+	int digits = 0, significant = 0, exponent = 0, exp = 0, expneg = 0;
+	int neg = 0, expdigits = 0;
+	double value;
 
-		case CSVN_DELIM:
-			csv_p->pos++;
-			
-			#ifdef CSVN_SKIP_WHITESPACE
-			if (text[csv_p->pos] == ' ') {
-				
-				do {
-					csv_p->pos++;
-				} while (text[csv_p->pos] == ' ');
+	p = csvn_span(text, token, &len);
+	if (p == NULL) {
+		return INVALID_CHARACTER;
+	}
+
+	if (p[i] == '-' || p[i] == '+') {
+		neg = (p[i] == '-');
+		i++;
+	}
+
+	/* digits which do not fit in the mantissa make it take the slow path */
+	for (; i < len && p[i] >= '0' && p[i] <= '9'; i++, digits++) {
+		if (significant > 0 || p[i] != '0') {
+			mantissa = 10 * mantissa + (uint64_t)(p[i] - '0');
+			significant++;
+		}
+	}
 
+	if (i < len && p[i] == '.') {
+		for (i++; i < len && p[i] >= '0' && p[i] <= '9'; i++, digits++) {
+			if (significant > 0 || p[i] != '0') {
+				mantissa = 10 * mantissa + (uint64_t)(p[i] - '0');
+				significant++;
 			}
-			#endif
+			exponent--;
+		}
+	}
+
+	if (digits == 0) {
+		return INVALID_CHARACTER;
+	}
+
+	if (i < len && (p[i] == 'e' || p[i] == 'E')) {
+
+		i++;
+		if (i < len && (p[i] == '-' || p[i] == '+')) {
+			expneg = (p[i] == '-');
+			i++;
+		}
+
+		for (; i < len && p[i] >= '0' && p[i] <= '9'; i++, expdigits++) {
+			if (exp < 100000) {
+				exp = 10 * exp + (p[i] - '0');
+			}
+		}
+
+		if (expdigits == 0) {
+			return INVALID_CHARACTER;
+		}
+		exponent += expneg ? -exp : exp;
+
+	}
+
+	if (i != len) {
+		return INVALID_CHARACTER;
+	}
+
+	/* 
+	   both the mantissa and the power of ten are exact doubles, so a 
+	   single rounding gives the correctly rounded result (unless the 
+	   arithmetic is done with excess precision)
+	*/
+	#if !defined(__FLT_EVAL_METHOD__) || __FLT_EVAL_METHOD__ == 0
+	if (significant <= 19 && mantissa <= ((uint64_t)1 << 53) && 
+	    exponent >= -22 && exponent <= 22) {
+
+		value = (double)mantissa;
+		value = (exponent < 0) ? value / powers[-exponent] : value * powers[exponent];
+		*out = neg ? -value : value;
+
+		return 0;
+
+	}
+	#else
+	(void)powers;
+	#endif
+
+	if (significant == 0) {
+		*out = neg ? -0.0 : 0.0;
+		return 0;
+	}
+
+	if (len >= sizeof(copy)) {
+		return FIELD_TOO_LONG;
+	}
+
+	memcpy(copy, p, len);
+	copy[len] = '\0';
+	value = strtod(copy, NULL);
+
+	if (value == HUGE_VAL || value == -HUGE_VAL) {
+		return OUT_OF_RANGE;
+	}
+
+	*out = value;
+
+	return 0;
+
+}
+
+static int64_t
+csvn_days(int year, int month, int day)
+{
+
+	/* years start in March, so that the leap day is the last one */
+	int64_t era, yoe, doy;
+
+	year -= (month <= 2);
+	era = (year >= 0 ? year : year - 399) / 400;
+	yoe = year - era * 400;
+	doy = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+
+	return era * 146097 + yoe * 365 + yoe / 4 - yoe / 100 + doy - 719468;
+
+}
+
+int
+csvn_to_time(const char *text, const struct csv_t *token, int64_t *out)
+{
+
+	static const int mdays[] = { 31, 29, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+
+	const char *p;
+	size_t len, i;
+	int year, month, day, hour = 0, minute = 0, second = 0, micro = 0;
+	int zone = 0, zh, zm = 0, scale;
+
+	p = csvn_span(text, token, &len);
+	if (p == NULL || len < 10 || p[4] != '-' || p[7] != '-') {
+		return INVALID_CHARACTER;
+	}
+
+	year = csvn_digits(p, 4);
+	month = csvn_digits(p + 5, 2);
+	day = csvn_digits(p + 8, 2);
+
+	if (year < 0 || month < 1 || month > 12 || day < 1 || day > mdays[month - 1] || 
+	    (month == 2 && day == 29 && 
+	     (year % 4 != 0 || (year % 100 == 0 && year % 400 != 0)))) {
+		return INVALID_CHARACTER;
+	}
 
-			if (text[csv_p->pos] == CSVN_DELIM) {
+	i = 10;
 
-			#ifdef CSVN_NO_EMPTY_FIELD
+	if (i < len) {
+
+		if ((p[i] != 'T' && p[i] != ' ') || len - i < 6 || p[i + 3] != ':') {
+			return INVALID_CHARACTER;
+		}
+
+		hour = csvn_digits(p + i + 1, 2);
+		minute = csvn_digits(p + i + 4, 2);
+		i += 6;
+
+		if (i < len && p[i] == ':') {
+
+			if (len - i < 3) {
 				return INVALID_CHARACTER;
-			#elif CSVN_IGNORE_EMPTY_FIELD
-				break;
-			#else
-				if (tokpool != NULL) {
-					struct csv_t *tok;
-					tok = csvn_allocate_token(csv_p, tokpool, num_tok);
-					if (tok == NULL) {
-						return NOT_ENOUGH_MEM;
-					}
-					csvn_fill_token(tok, csv_p->pos - 1, csv_p->pos, csv_p->line, EMPTY);
+			}
+			second = csvn_digits(p + i + 1, 2);
+			i += 3;
+
+			/* only microseconds are kept of the fraction */
+			if (i < len && (p[i] == '.' || p[i] == ',')) {
+
+				for (i++, scale = 100000; i < len && p[i] >= '0' && p[i] <= '9'; i++) {
+					micro += (p[i] - '0') * scale;
+					scale /= 10;
+				}
+
+				if (p[i - 1] == '.' || p[i - 1] == ',') {
+					return INVALID_CHARACTER;
 				}
-				parsed++;
-				break;
-			#endif	
 
 			}
-			break;
 
-		case '\"':
-			csv_p->pos++; /* skip opening quote */
-			res = csvn_parse_quotes(text, textlen, csv_p, tokpool, num_tok);
-			if (res != 0) {
-				return res;
+		}
+
+		if (hour < 0 || hour > 23 || minute < 0 || minute > 59 || 
+		    second < 0 || second > 59) {
+			return INVALID_CHARACTER;
+		}
+
+		if (i < len && p[i] == 'Z') {
+
+			i++;
+
+		} else if (i < len && (p[i] == '+' || p[i] == '-')) {
+
+			if (len - i < 3) {
+				return INVALID_CHARACTER;
 			}
-			csv_p->pos++;
-			#ifdef CSVN_STRICT
-			/* closing quote has to be followed by a delimiter, newline or end of file */
-			if (text[csv_p->pos] == CSVN_DELIM || text[csv_p->pos] == CSVN_NEWLINE) {
-				parsed++;
-				break;
-			} else {
-				if (text[csv_p->pos] != '\0' && csv_p->pos < textlen) {
+			zh = csvn_digits(p + i + 1, 2);
+			zone = (p[i] == '-') ? -1 : 1;
+			i += 3;
+
+			if (i < len) {
+				if (p[i] == ':') {
+					i++;
+				}
+				if (len - i != 2) {
 					return INVALID_CHARACTER;
 				}
+				zm = csvn_digits(p + i, 2);
+				i += 2;
 			}
-			#endif
-			parsed++;
-			break;
-		default:
-			res = csvn_parse_normal(text, textlen, csv_p, tokpool, num_tok);
-			if (res != 0) {
-				return res;
+
+			if (zh < 0 || zh > 23 || zm < 0 || zm > 59) {
+				return INVALID_CHARACTER;
 			}
-			parsed++;
-			csv_p->pos++;
-			break;
+			zone *= 60 * zh + zm;
+
+		}
 
+		if (i != len) {
+			return INVALID_CHARACTER;
 		}
 
 	}
 
-	return parsed;
+	*out = ((csvn_days(year, month, day) * 86400 + 
+		 3600 * hour + 60 * (minute - zone) + second) * 1000000) + micro;
+
+	return 0;
+
+}
+
+int
+csvn_to_bool(const char *text, const struct csv_t *token, int64_t *out)
+{
+
+	const char *p;
+	size_t len, i;
+	char lower[5];
+
+	p = csvn_span(text, token, &len);
+	if (p == NULL || (len != 4 && len != 5)) {
+		return INVALID_CHARACTER;
+	}
+
+	for (i = 0; i < len; i++) {
+		lower[i] = (p[i] >= 'A' && p[i] <= 'Z') ? (char)(p[i] - 'A' + 'a') : p[i];
+	}
+
+	if (len == 4 && memcmp(lower, "true", 4) == 0) {
+		*out = 1;
+	} else if (len == 5 && memcmp(lower, "false", 5) == 0) {
+		*out = 0;
+	} else {
+		return INVALID_CHARACTER;
+	}
+
+	return 0;
 
 }
+#endif
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,649 @@
+#ifndef CSVN_HPP
+#define CSVN_HPP
+
+/*
+	A header-only C++17 wrapper of csvn: fields are std::string_view
+	over the parsed text (nothing is allocated or copied), rows and
+	fields are ranges pulled one field at a time (refer to
+	csvn_next_field) and the dialect is a parameter of the template.
+*/
+
+#ifndef CSVN_CALLBACKS
+#define CSVN_CALLBACKS
+#endif
+#include "csvn.h"
+
+#ifndef CSVN_CALLBACKS
+#error "csvn.hpp needs csvn.h to be included with CSVN_CALLBACKS"
+#endif
+
+#include <charconv>
+#include <cstddef>
+#include <string_view>
+#include <system_error>
+#include <type_traits>
+
+#if defined(CSVN_PIPELINE) && defined(__cpp_impl_coroutine)
+#include <coroutine>
+#define CSVN_COROUTINES
+#endif
+
+namespace csvn {
+
+/*
+
+	text - characters of the field (without its quotes, with escaped
+	       quotes still doubled), right within the parsed text
+
+	kind - type of the field
+
+	escaped - true if the (quoted) field contains escaped quotes (or
+	          may contain some, refer to CSVN_ESCAPED)
+
+	line - line in which the field was located
+
+*/
+struct field {
+
+	std::string_view text;
+
+	enum csv_tok kind = UNASSIGN;
+
+	bool escaped = false;
+
+	int line = 0;
+
+	/*
+
+		Converts the whole field (without skipping any whitespace)
+		into out with std::from_chars.
+
+		Returns std::errc() on success, std::errc::invalid_argument
+		if the field is not a number (or has trailing characters) or
+		std::errc::result_out_of_range.
+
+	*/
+	template <class T>
+	std::errc get(T &out) const noexcept
+	{
+
+		static_assert(std::is_arithmetic_v<T> && !std::is_same_v<T, bool>,
+			      "fields only convert to numbers");
+
+		const char *first = text.data(), *last = first + text.size();
+		std::from_chars_result res = std::from_chars(first, last, out);
+
+		if (res.ec == std::errc() && res.ptr != last) {
+			return std::errc::invalid_argument;
+		}
+
+		return res.ec;
+
+	}
+
+	/*
+
+		Returns the field converted by get or fallback if it can not
+		be converted.
+
+	*/
+	template <class T>
+	T as(T fallback = T()) const noexcept
+	{
+
+		T out;
+
+		return (get(out) == std::errc()) ? out : fallback;
+
+	}
+
+	bool empty() const noexcept
+	{
+
+		return text.empty();
+
+	}
+
+};
+
+/*
+
+	Parser pulling the fields of a text with the dialect given by its
+	template parameters. It does not own the text, which has to
+	outlive it, and can be moved but not copied.
+
+	Every dialect is a constant of its own which the kernel is called
+	with directly (rather than through csvn_parse_text), so that every
+	instance of the template gets a copy of the kernel specialised for
+	its dialect, whether it is one of the common ones or not.
+
+*/
+template <char Delim = CSVN_DELIM,
+	  char Quote = '\"',
+	  bool Crlf = (CSVN_DEFAULT_CRLF != 0),
+	  int Flags = (CSVN_DEFAULT_FLAGS & ~CSVN_DIALECT_CRLF)>
+class parser {
+
+public:
+
+	static constexpr struct csvn_dialect dialect = {
+		Delim, CSVN_NEWLINE, Quote, Flags | (Crlf ? CSVN_DIALECT_CRLF : 0)
+	};
+
+	class row;
+
+	class field_iterator;
+
+	class row_iterator;
+
+	/* the end of every range of the parser */
+	struct sentinel {};
+
+	explicit parser(std::string_view text) noexcept
+	{
+
+		csvn_iter_init(&iter_, text.data(), text.size());
+		iter_.parser.dialect = &dialect;
+		advance();
+
+	}
+
+	parser(parser &&other) noexcept
+		: iter_(other.iter_),
+		  current_(other.current_),
+		  row_(other.row_),
+		  done_(other.done_),
+		  error_(other.error_)
+	{
+
+		/* the callbacks of the iterator have it as their sink */
+		iter_.parser.sink = &iter_;
+
+	}
+
+	parser &operator=(parser &&other) noexcept
+	{
+
+		iter_ = other.iter_;
+		iter_.parser.sink = &iter_;
+		current_ = other.current_;
+		row_ = other.row_;
+		done_ = other.done_;
+		error_ = other.error_;
+
+		return *this;
+
+	}
+
+	parser(const parser &) = delete;
+
+	parser &operator=(const parser &) = delete;
+
+	/*
+
+		Pulls the next field into out.
+
+		Returns false at the end of the text or on an error (refer to
+		error).
+
+	*/
+	bool next(field &out) noexcept
+	{
+
+		if (done_) {
+			return false;
+		}
+
+		out = current_;
+		advance();
+
+		return true;
+
+	}
+
+	/* index of the row of the field which is pulled next */
+	int row_index() const noexcept
+	{
+
+		return row_;
+
+	}
+
+	bool done() const noexcept
+	{
+
+		return done_;
+
+	}
+
+	/* 0 or the error the parser stopped with (refer to csv_err) */
+	int error() const noexcept
+	{
+
+		return error_;
+
+	}
+
+	/* the rows which are left, each a range of its fields */
+	row_iterator begin() noexcept
+	{
+
+		return row_iterator(this);
+
+	}
+
+	sentinel end() const noexcept
+	{
+
+		return sentinel();
+
+	}
+
+	/*
+
+		Row of fields within the parser, which goes over them as they
+		are iterated (and skips the rest once the next row is).
+
+	*/
+	class row {
+
+	public:
+
+		field_iterator begin() const noexcept
+		{
+
+			return field_iterator(parser_, index_);
+
+		}
+
+		sentinel end() const noexcept
+		{
+
+			return sentinel();
+
+		}
+
+		int index() const noexcept
+		{
+
+			return index_;
+
+		}
+
+	private:
+
+		friend class row_iterator;
+
+		row(parser *p, int index) noexcept : parser_(p), index_(index) {}
+
+		parser *parser_;
+
+		int index_;
+
+	};
+
+	class field_iterator {
+
+	public:
+
+		using value_type = field;
+		using reference = const field &;
+		using pointer = const field *;
+		using difference_type = std::ptrdiff_t;
+		using iterator_category = std::input_iterator_tag;
+
+		reference operator*() const noexcept
+		{
+
+			return parser_->current_;
+
+		}
+
+		pointer operator->() const noexcept
+		{
+
+			return &parser_->current_;
+
+		}
+
+		field_iterator &operator++() noexcept
+		{
+
+			parser_->advance();
+
+			return *this;
+
+		}
+
+		void operator++(int) noexcept
+		{
+
+			parser_->advance();
+
+		}
+
+		bool operator==(sentinel) const noexcept
+		{
+
+			return parser_->done_ || parser_->row_ != index_;
+
+		}
+
+		bool operator!=(sentinel s) const noexcept
+		{
+
+			return !(*this == s);
+
+		}
+
+	private:
+
+		friend class row;
+
+		field_iterator(parser *p, int index) noexcept : parser_(p), index_(index) {}
+
+		parser *parser_;
+
+		int index_;
+
+	};
+
+	class row_iterator {
+
+	public:
+
+		using value_type = row;
+		using reference = row;
+		using pointer = void;
+		using difference_type = std::ptrdiff_t;
+		using iterator_category = std::input_iterator_tag;
+
+		row operator*() const noexcept
+		{
+
+			return row(parser_, index_);
+
+		}
+
+		/* the fields of the current row which have not been iterated are skipped */
+		row_iterator &operator++() noexcept
+		{
+
+			while (!parser_->done_ && parser_->row_ == index_) {
+				parser_->advance();
+			}
+			index_ = parser_->row_;
+
+			return *this;
+
+		}
+
+		void operator++(int) noexcept
+		{
+
+			++*this;
+
+		}
+
+		bool operator==(sentinel) const noexcept
+		{
+
+			return parser_->done_;
+
+		}
+
+		bool operator!=(sentinel s) const noexcept
+		{
+
+			return !(*this == s);
+
+		}
+
+	private:
+
+		friend class parser;
+
+		explicit row_iterator(parser *p) noexcept : parser_(p), index_(p->row_) {}
+
+		parser *parser_;
+
+		int index_;
+
+	};
+
+private:
+
+	/* pulls the field after the current one, which is looked ahead at */
+	void advance() noexcept
+	{
+
+		struct csv_t tok;
+		int res;
+
+		if (done_) {
+			return;
+		}
+
+		/* csvn_next_field, without looking the dialect up again */
+		iter_.parser.toknext = 0;
+		#ifdef CSVN_FILTER
+		iter_.parser.rowtok = 0;
+		#endif
+		res = csvn_parse_dialect(iter_.text, iter_.textlen, &iter_.parser, &tok, 1, 0, &dialect);
+		if (res <= 0) {
+			done_ = true;
+			error_ = res;
+			return;
+		}
+
+		current_.kind = CSVN_TOK_KIND(tok);
+		current_.escaped = CSVN_TOK_ESCAPED(tok) != 0;
+		#ifdef CSVN_PACKED
+		current_.line = iter_.parser.tokline;
+		#else
+		current_.line = CSVN_TOK_LINE(tok);
+		#endif
+		if (current_.kind == EMPTY) {
+			current_.text = std::string_view(iter_.text + CSVN_TOK_END(tok), 0);
+		} else {
+			current_.text = std::string_view(iter_.text + CSVN_TOK_START(tok),
+							 (std::size_t)(CSVN_TOK_SIZE(tok) + 1));
+		}
+
+		row_ = iter_.row;
+
+	}
+
+	struct csvn_iter iter_;
+
+	field current_;
+
+	int row_ = 0;
+
+	bool done_ = false;
+
+	int error_ = 0;
+
+};
+
+#ifdef CSVN_PIPELINE
+/*
+
+	Pipeline reading a file descriptor into a ring of buffers with a
+	thread of its own (refer to csvn_start_pipeline), while the windows
+	of the stream are parsed. It neither owns the descriptor nor the
+	buffer, and can be neither copied nor moved, as the thread refers to
+	it.
+
+*/
+class pipeline {
+
+public:
+
+	pipeline(int fd, char *buffer, std::size_t buflen, int num_buf = 3) noexcept
+	{
+
+		error_ = csvn_start_pipeline(&pl_, fd, buffer, buflen, num_buf);
+		started_ = (error_ == 0);
+
+	}
+
+	~pipeline()
+	{
+
+		if (started_) {
+			csvn_stop_pipeline(&pl_);
+		}
+
+	}
+
+	pipeline(const pipeline &) = delete;
+
+	pipeline &operator=(const pipeline &) = delete;
+
+	/*
+
+		Waits for the next window (refer to csvn_next_window), which
+		has to be parsed with csvn_parse_stream and last.
+
+		Returns 1, 0 at the end of the stream or an error.
+
+	*/
+	int next(struct csv_p &parser) noexcept
+	{
+
+		int res;
+
+		if (!started_ || error_ != 0) {
+			return error_;
+		}
+
+		res = csvn_next_window(&pl_, &parser);
+		if (res < 0) {
+			error_ = res;
+		}
+
+		return res;
+
+	}
+
+	std::string_view window() const noexcept
+	{
+
+		return std::string_view(pl_.text, pl_.textlen);
+
+	}
+
+	bool last() const noexcept
+	{
+
+		return pl_.last != 0;
+
+	}
+
+	/* 0 or the error the pipeline stopped with (refer to csv_err) */
+	int error() const noexcept
+	{
+
+		return error_;
+
+	}
+
+	#ifdef CSVN_COROUTINES
+	/*
+
+		Awaitable of the next window: the coroutine goes on right away
+		if it is available, or else is handed to schedule (as a
+		std::coroutine_handle<>) on the reading thread once it is,
+		which should resume it on a thread of its own (e.g. by posting
+		it to an event loop). schedule must not block (nor resume the
+		coroutine itself), as the thread reads nothing until it
+		returns. co_await gives the result of next.
+
+	*/
+	template <class Schedule>
+	class awaitable {
+
+	public:
+
+		bool await_ready() const noexcept
+		{
+
+			return false;
+
+		}
+
+		bool await_suspend(std::coroutine_handle<> handle) noexcept
+		{
+
+			if (!owner_->started_ || owner_->error_ != 0) {
+				return false;
+			}
+
+			handle_ = handle;
+
+			return !csvn_notify_window(&owner_->pl_, ready, this);
+
+		}
+
+		int await_resume() noexcept
+		{
+
+			return owner_->next(*parser_);
+
+		}
+
+	private:
+
+		friend class pipeline;
+
+		awaitable(pipeline *owner, struct csv_p *parser, Schedule schedule) noexcept
+			: owner_(owner), parser_(parser), schedule_(schedule) {}
+
+		static void ready(void *ctx)
+		{
+
+			awaitable *self = static_cast<awaitable *>(ctx);
+
+			self->schedule_(self->handle_);
+
+		}
+
+		pipeline *owner_;
+
+		struct csv_p *parser_;
+
+		Schedule schedule_;
+
+		std::coroutine_handle<> handle_;
+
+	};
+
+	template <class Schedule>
+	awaitable<Schedule> next_async(struct csv_p &parser, Schedule schedule) noexcept
+	{
+
+		return awaitable<Schedule>(this, &parser, schedule);
+
+	}
+	#endif
+
+private:
+
+	struct csvn_pipeline pl_;
+
+	bool started_ = false;
+
+	int error_ = 0;
+
+};
+#endif
+
+/* the common dialects */
+using csv = parser<',', '\"'>;
+
+using tsv = parser<'\t', '\"'>;
+
+} /* namespace csvn */
+
+#endif /* ifndef CSVN_HPP */
@@ -0,0 +1,551 @@
+#define _DEFAULT_SOURCE
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#define CSVN_SIMD
+#define CSVN_ESCAPED
+#define CSVN_INDEX
+#define CSVN_PARALLEL
+#define CSVN_PARALLEL_MIN 16
+#define CSVN_CALLBACKS
+#include "csvn.h"
+
+/*
+	Differential harness: every engine of the parser parses the same
+	input, which has to give exactly the tokens (or the error) of
+	csvn_parse built without CSVN_SIMD in fuzz_ref.c. The first byte of the input picks the dialect, the rest
+	is the text, and a seed taken from the text picks the boundaries of
+	the streamed calls.
+
+	Built with -DCSVN_LIBFUZZER it is a libFuzzer target, otherwise it
+	checks the files it is given (for AFL, e.g. ./csvn_f @@) or, without
+	any, as many random inputs as its -n option says.
+*/
+
+struct field {
+
+	csvn_off start;
+
+	csvn_off end;
+
+	enum csv_tok kind;
+
+};
+
+struct run {
+
+	const char *engine;
+
+	struct csv_t *tokens;
+
+	int count;
+
+	int cap;
+
+	int res;
+
+};
+
+static unsigned long seed = 1;
+
+static struct field *pushed;
+
+static int num_pushed;
+
+static unsigned long next_random(void);
+static void *grow(void *ctx, void *ptr, size_t size);
+static void keep(struct run *run, const struct csv_t *tokens, int n, csvn_off base);
+static void fail(const struct run *run, const char *why, const char *text, size_t len);
+static void compare(const struct run *ref, const struct run *run, const char *text, size_t len);
+static int on_field(void *sink, csvn_off start, csvn_off len, enum csv_tok kind);
+static void run_reference(struct run *run, const char *text, size_t len, const struct csvn_dialect *d);
+static void run_parse(struct run *run, const char *text, size_t len, const struct csvn_dialect *d);
+static void run_stream(struct run *run, const char *text, size_t len, const struct csvn_dialect *d);
+static void run_discard(struct run *run, const char *text, size_t len, const struct csvn_dialect *d);
+static void run_index(struct run *run, const char *text, size_t len, const struct csvn_dialect *d);
+static void run_parallel(struct run *run, const char *text, size_t len, const struct csvn_dialect *d);
+static void run_callbacks(struct run *run, const char *text, size_t len, const struct csvn_dialect *d);
+static int check_input(const unsigned char *data, size_t size);
+
+int fuzz_ref(const char *text, size_t len, const struct csvn_dialect *d,
+	     struct csv_t **tokens, int *count);
+int LLVMFuzzerTestOneInput(const unsigned char *data, size_t size);
+
+static unsigned long
+next_random(void)
+{
+
+	seed = seed * 1103515245UL + 12345UL;
+
+	return (seed >> 16) & 0x7fff;
+
+}
+
+static void *
+grow(void *ctx, void *ptr, size_t size)
+{
+
+	(void)ctx;
+
+	return realloc(ptr, size);
+
+}
+
+/* appends n tokens to the ones of the run, moved by base characters */
+static void
+keep(struct run *run, const struct csv_t *tokens, int n, csvn_off base)
+{
+
+	int i;
+
+	if (run->count + n > run->cap) {
+		run->cap = 2 * (run->count + n) + 16;
+		run->tokens = (struct csv_t *)realloc(run->tokens,
+						      (size_t)run->cap * sizeof(struct csv_t));
+		if (run->tokens == NULL) {
+			abort();
+		}
+	}
+
+	for (i = 0; i < n; i++) {
+		run->tokens[run->count] = tokens[i];
+#ifdef CSVN_PACKED
+		run->tokens[run->count].bits += (uint64_t)base;
+#else
+		run->tokens[run->count].start += base;
+		run->tokens[run->count].end += base;
+#endif
+		run->count++;
+	}
+
+}
+
+static void
+fail(const struct run *run, const char *why, const char *text, size_t len)
+{
+
+	size_t i;
+
+	fprintf(stderr, "%s differs from the scalar csvn_parse: %s\ninput: \"", run->engine, why);
+	for (i = 0; i < len; i++) {
+		if (text[i] == '\n') {
+			fputs("\\n", stderr);
+		} else if (text[i] == '\r') {
+			fputs("\\r", stderr);
+		} else if (text[i] == '"' || text[i] == '\\') {
+			fprintf(stderr, "\\%c", text[i]);
+		} else {
+			fputc(text[i], stderr);
+		}
+	}
+	fputs("\"\n", stderr);
+
+	abort();
+
+}
+
+static void
+compare(const struct run *ref, const struct run *run, const char *text, size_t len)
+{
+
+	const struct csv_t *a, *b;
+	int i;
+
+	if ((ref->res < 0 || run->res < 0) && ref->res != run->res) {
+		fail(run, "result", text, len);
+	}
+
+	if (ref->res < 0) {
+		return;
+	}
+
+	if (run->count != ref->count) {
+		fail(run, "number of tokens", text, len);
+	}
+
+	for (i = 0; i < ref->count; i++) {
+
+		a = &ref->tokens[i];
+		b = &run->tokens[i];
+
+		if (CSVN_TOK_START(*a) != CSVN_TOK_START(*b) ||
+		    CSVN_TOK_SIZE(*a) != CSVN_TOK_SIZE(*b) ||
+		    CSVN_TOK_KIND(*a) != CSVN_TOK_KIND(*b) ||
+		    CSVN_TOK_ESCAPED(*a) != CSVN_TOK_ESCAPED(*b)) {
+			fail(run, "token", text, len);
+		}
+#ifndef CSVN_PACKED
+		if (a->line != b->line) {
+			fail(run, "line of a token", text, len);
+		}
+#endif
+
+	}
+
+}
+
+static int
+on_field(void *sink, csvn_off start, csvn_off len, enum csv_tok kind)
+{
+
+	(void)sink;
+
+	pushed = (struct field *)realloc(pushed, (size_t)(num_pushed + 1) * sizeof(struct field));
+	if (pushed == NULL) {
+		abort();
+	}
+
+	pushed[num_pushed].start = start;
+	pushed[num_pushed].end = start + len;
+	pushed[num_pushed].kind = kind;
+	num_pushed++;
+
+	return 0;
+
+}
+
+static void
+run_reference(struct run *run, const char *text, size_t len, const struct csvn_dialect *d)
+{
+
+	struct csv_t *tokens;
+	int count;
+
+	run->engine = "scalar csvn_parse";
+	run->res = fuzz_ref(text, len, d, &tokens, &count);
+	keep(run, tokens, count, 0);
+
+	free(tokens);
+
+}
+
+static void
+run_parse(struct run *run, const char *text, size_t len, const struct csvn_dialect *d)
+{
+
+	struct csv_p parser;
+
+	csvn_init(&parser);
+	parser.dialect = d;
+	parser.grow = grow;
+
+	run->engine = "csvn_parse";
+	run->res = csvn_parse(text, len, &parser, NULL, 0);
+	if (run->res >= 0) {
+		keep(run, parser.tokens, parser.toknext, 0);
+	}
+
+	free(parser.tokens);
+
+}
+
+/* the text is handed over a few characters more at a time */
+static void
+run_stream(struct run *run, const char *text, size_t len, const struct csvn_dialect *d)
+{
+
+	struct csv_p parser;
+	size_t end = 0;
+	int res;
+
+	csvn_init(&parser);
+	parser.dialect = d;
+	parser.grow = grow;
+
+	run->engine = "csvn_parse_stream";
+	run->res = 0;
+
+	do {
+
+		end += 1 + next_random() % 16;
+		if (end > len) {
+			end = len;
+		}
+
+		res = csvn_parse_stream(text, end, &parser, NULL, 0, end == len);
+		if (res < 0) {
+			run->res = res;
+			break;
+		}
+		run->res += res;
+
+	} while (end < len);
+
+	keep(run, parser.tokens, parser.toknext, 0);
+	free(parser.tokens);
+
+}
+
+/* the text is streamed through a buffer which the parsed part is dropped from */
+static void
+run_discard(struct run *run, const char *text, size_t len, const struct csvn_dialect *d)
+{
+
+	struct csv_p parser;
+	char *buf = (char *)malloc(len + 1);
+	size_t have = 0, fed = 0, step, n;
+	csvn_off base = 0;
+	int res;
+
+	csvn_init(&parser);
+	parser.dialect = d;
+	parser.grow = grow;
+
+	run->engine = "csvn_discard";
+	run->res = 0;
+
+	do {
+
+		step = 1 + next_random() % 16;
+		if (fed + step > len) {
+			step = len - fed;
+		}
+		memcpy(buf + have, text + fed, step);
+		have += step;
+		fed += step;
+
+		res = csvn_parse_stream(buf, have, &parser, NULL, 0, fed == len);
+		if (res < 0) {
+			run->res = res;
+			break;
+		}
+		run->res += res;
+		keep(run, parser.tokens, parser.toknext, base);
+
+		n = csvn_discardable(&parser);
+		memmove(buf, buf + n, have - n);
+		have -= n;
+		base += (csvn_off)n;
+		csvn_discard(&parser, n);
+
+	} while (fed < len);
+
+	free(parser.tokens);
+	free(buf);
+
+}
+
+static void
+run_index(struct run *run, const char *text, size_t len, const struct csvn_dialect *d)
+{
+
+	struct csv_p parser;
+	struct csvn_idx idx;
+	size_t *offsets = (size_t *)malloc((len + 1) * sizeof(size_t));
+
+	csvn_init(&parser);
+	parser.dialect = d;
+	parser.grow = grow;
+	csvn_index_init(&idx);
+	idx.dialect = d;
+
+	run->engine = "csvn_parse_index";
+	run->res = csvn_index(text, len, &idx, offsets, len + 1);
+	if (run->res >= 0) {
+		run->res = csvn_parse_index(text, len, &idx, offsets, &parser, NULL, 0);
+	}
+	if (run->res >= 0) {
+		keep(run, parser.tokens, parser.toknext, 0);
+	}
+
+	free(parser.tokens);
+	free(offsets);
+
+}
+
+static void
+run_parallel(struct run *run, const char *text, size_t len, const struct csvn_dialect *d)
+{
+
+	struct csv_p parser;
+
+	csvn_init(&parser);
+	parser.dialect = d;
+	parser.grow = grow;
+
+	run->engine = "csvn_parse_parallel";
+	run->res = csvn_parse_parallel(text, len, 1 + (int)(next_random() % 4), &parser, NULL, 0);
+	if (run->res >= 0) {
+		keep(run, parser.tokens, parser.toknext, 0);
+	}
+
+	free(parser.tokens);
+
+}
+
+/* the pushed fields become tokens again, an empty one lies at the end of its token */
+static void
+run_callbacks(struct run *run, const char *text, size_t len, const struct csvn_dialect *d)
+{
+
+	struct csv_p parser;
+	struct csv_t tok;
+	int i;
+
+	csvn_init(&parser);
+	parser.dialect = d;
+	parser.grow = grow;
+	parser.on_field = on_field;
+	num_pushed = 0;
+
+	run->engine = "on_field";
+	run->res = csvn_parse(text, len, &parser, NULL, 0);
+	if (run->res >= 0) {
+
+		keep(run, parser.tokens, parser.toknext, 0);
+
+		for (i = 0; i < num_pushed && i < run->count; i++) {
+			tok = run->tokens[i];
+			if (pushed[i].kind != CSVN_TOK_KIND(tok) ||
+			    (pushed[i].kind == EMPTY ?
+			     pushed[i].start != CSVN_TOK_END(tok) || pushed[i].end != pushed[i].start :
+			     pushed[i].start != CSVN_TOK_START(tok) || pushed[i].end != CSVN_TOK_END(tok) + 1)) {
+				fail(run, "pushed field", text, len);
+			}
+		}
+		if (num_pushed != run->count) {
+			fail(run, "number of pushed fields", text, len);
+		}
+
+	}
+
+	free(parser.tokens);
+
+}
+
+static int
+check_input(const unsigned char *data, size_t size)
+{
+
+	static void (*engines[])(struct run *, const char *, size_t, const struct csvn_dialect *) = {
+		run_parse, run_stream, run_discard, run_index, run_parallel, run_callbacks
+	};
+	struct csvn_dialect d, strict;
+	struct run ref, run;
+	char *text;
+	size_t len, i;
+	int rfc;
+
+	if (size == 0) {
+		return 0;
+	}
+
+	csvn_dialect_init(&d);
+	d.flags = data[0] & (CSVN_DIALECT_STRICT | CSVN_DIALECT_CONSIDER_NL |
+			     CSVN_DIALECT_SKIP_WHITESPACE | CSVN_DIALECT_NO_EMPTY_FIELD |
+			     CSVN_DIALECT_IGNORE_EMPTY_FIELD | CSVN_DIALECT_CRLF);
+	if (data[0] & 0x80) {
+		d.delim = ';';
+	}
+	strict = d;
+	strict.flags |= CSVN_DIALECT_STRICT;
+
+	/* the text ends at its first '\0' for every engine */
+	len = size - 1;
+#ifndef CSVN_LENGTH_ONLY
+	for (i = 0; i < len; i++) {
+		if (data[1 + i] == '\0') {
+			len = i;
+			break;
+		}
+	}
+#endif
+	text = (char *)malloc(len + 1);
+	memcpy(text, data + 1, len);
+	text[len] = '\0';
+
+	memset(&ref, 0, sizeof(ref));
+	run_reference(&ref, text, len, &strict);
+	free(ref.tokens);
+
+	/* the two-stage parser only gives the same tokens for text following RFC 4180 */
+	rfc = (ref.res >= 0);
+
+	memset(&ref, 0, sizeof(ref));
+	run_reference(&ref, text, len, &d);
+
+	for (i = 0; i < sizeof(engines) / sizeof(engines[0]); i++) {
+
+		if (engines[i] == run_index && !rfc && !(d.flags & CSVN_DIALECT_STRICT)) {
+			continue;
+		}
+
+		memset(&run, 0, sizeof(run));
+		seed = len + i;
+		engines[i](&run, text, len, &d);
+		compare(&ref, &run, text, len);
+		free(run.tokens);
+
+	}
+
+	free(ref.tokens);
+	free(text);
+
+	return 0;
+
+}
+
+int
+LLVMFuzzerTestOneInput(const unsigned char *data, size_t size)
+{
+
+	return check_input(data, size);
+
+}
+
+#ifndef CSVN_LIBFUZZER
+int
+main(int argc, char **argv)
+{
+
+	static const char alphabet[] = "ab ,;\"\n\r";
+	unsigned char data[256];
+	unsigned long iters = 100000, it;
+	size_t size;
+	FILE *file;
+	int i, files = 0;
+
+	for (i = 1; i < argc; i++) {
+
+		if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+			iters = strtoul(argv[++i], NULL, 10);
+			continue;
+		}
+
+		file = fopen(argv[i], "rb");
+		if (file == NULL) {
+			fprintf(stderr, "can not open %s\n", argv[i]);
+			return 1;
+		}
+		size = fread(data, 1, sizeof(data), file);
+		fclose(file);
+
+		check_input(data, size);
+		files++;
+
+	}
+
+	if (files > 0) {
+		return 0;
+	}
+
+	for (it = 0; it < iters; it++) {
+
+		seed = it + 1;
+		size = 1 + next_random() % (sizeof(data) - 1);
+		data[0] = (unsigned char)next_random();
+		for (i = 1; i < (int)size; i++) {
+			data[i] = (unsigned char)alphabet[next_random() % (sizeof(alphabet) - 1)];
+		}
+
+		check_input(data, size);
+
+	}
+
+	printf("%lu inputs parsed alike by every engine\n", iters);
+
+	return 0;
+
+}
+#endif
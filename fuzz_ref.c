@@ -0,0 +1,47 @@
+#include <stdlib.h>
+
+#define CSVN_ESCAPED
+#include "csvn.h"
+
+/*
+	Reference of fuzz.c: csvn_parse built without CSVN_SIMD, so that the
+	vectorised scanner is checked against the scalar state machine. It
+	is a translation unit of its own, whose object keeps only fuzz_ref
+	global (the Makefile localises the rest with objcopy), since the
+	header defines its functions in every file including it.
+*/
+
+int fuzz_ref(const char *text, size_t len, const struct csvn_dialect *d,
+	     struct csv_t **tokens, int *count);
+
+static void *
+ref_grow(void *ctx, void *ptr, size_t size)
+{
+
+	(void)ctx;
+
+	return realloc(ptr, size);
+
+}
+
+/* the tokens are left in *tokens, which the caller frees */
+int
+fuzz_ref(const char *text, size_t len, const struct csvn_dialect *d,
+	 struct csv_t **tokens, int *count)
+{
+
+	struct csv_p parser;
+	int res;
+
+	csvn_init(&parser);
+	parser.dialect = d;
+	parser.grow = ref_grow;
+
+	res = csvn_parse(text, len, &parser, NULL, 0);
+
+	*tokens = parser.tokens;
+	*count = res >= 0 ? parser.toknext : 0;
+
+	return res;
+
+}
@@ -1,8 +1,27 @@
+#define _DEFAULT_SOURCE
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
 
 #define CSVN_STRICT
+#define CSVN_ESCAPED
+#define CSVN_SIMD
+#define CSVN_INDEX
+#define CSVN_PARALLEL
+#define CSVN_PARALLEL_MIN 64
+#define CSVN_MMAP
+#define CSVN_COLUMNS
+#define CSVN_PROJECTION
+#define CSVN_FILTER
+#define CSVN_CALLBACKS
+#define CSVN_HEADER
+#define CSVN_SIDECAR
+#define CSVN_STATS
+#define CSVN_PIPELINE
+#define CSVN_GZIP
+#define CSVN_BATCH
+#define CSVN_ARENA
+#define CSVN_INFER
 #include "csvn.h"
 
 #define fail() return __LINE__
@@ -15,14 +34,54 @@
 		}			\
 	} while (0)
 
+/* packed tokens have no line, so every check of one passes under CSVN_PACKED */
+#ifdef CSVN_PACKED
+#define token_line(t) 0
+#define on_line(t, l) 1
+#else
+#define token_line(t) CSVN_TOK_LINE(t)
+#define on_line(t, l) (CSVN_TOK_LINE(t) == (l))
+#endif
+
 static int passed_tests = 0;
 static int failed_tests = 0;
 
 static char *get_parsed(struct csv_t *token, char *text);
+static int same_tokens(const struct csv_t *a, const struct csv_t *b, int n);
 
 static int test_normal();
 static int test_quoted();
 static int test_newlines();
+static int test_long_fields();
+static int test_index();
+static int test_validate();
+static int test_stream();
+static int test_parallel();
+static int test_grow();
+static int test_rows();
+static int test_mmap();
+static int test_dialect();
+static int test_crlf();
+static int test_unescape();
+static int test_convert();
+static int test_columns();
+static int test_projection();
+static int test_filter();
+static int test_callbacks();
+static int test_header();
+static int test_sidecar();
+static int test_stats();
+static int test_pipeline();
+static int test_decoder();
+static size_t gzip_rows(unsigned char *out, size_t outlen, int rows);
+static int decode_fields(int fd, int *codec);
+static int test_batch();
+static int test_arena();
+static int test_infer();
+static void batch_done(void *ctx, struct csvn_job *job);
+static void *grow_tokens(void *ctx, void *ptr, size_t size);
+static int count_field(void *sink, csvn_off start, csvn_off len, enum csv_tok kind);
+static void count_row(void *sink);
 
 static void test(int (*testf)(void), char *msg);
 
@@ -47,15 +106,41 @@ get_parsed(struct csv_t *token, char *text)
 {
 
 	char *parsed;
-        parsed = malloc(sizeof(char *) * (token->size + 1));
-	parsed[token->size] = '\0';
+        parsed = malloc(CSVN_TOK_SIZE(*token) + 2);
+	parsed[CSVN_TOK_SIZE(*token) + 1] = '\0';
 
-	strncpy(parsed, text + token->start, token->size + 1);
+	strncpy(parsed, text + CSVN_TOK_START(*token), CSVN_TOK_SIZE(*token) + 1);
 
 	return parsed;
 
 }
 
+/* csv_t has padding (under CSVN_LARGE), so tokens are compared field by field */
+static int
+same_tokens(const struct csv_t *a, const struct csv_t *b, int n)
+{
+
+	int i;
+
+	for (i = 0; i < n; i++) {
+
+		if (CSVN_TOK_START(a[i]) != CSVN_TOK_START(b[i]) || 
+		    CSVN_TOK_SIZE(a[i]) != CSVN_TOK_SIZE(b[i]) || 
+		    CSVN_TOK_KIND(a[i]) != CSVN_TOK_KIND(b[i]) || 
+		    CSVN_TOK_ESCAPED(a[i]) != CSVN_TOK_ESCAPED(b[i])) {
+			return 0;
+		}
+
+		if (!on_line(a[i], token_line(b[i]))) {
+			return 0;
+		}
+
+	}
+
+	return 1;
+
+}
+
 static int
 test_normal()
 {
@@ -70,7 +155,7 @@ test_normal()
 	char *test_text;
 	test_text = "parse, this, text\nthen,this";
 
-	int parsed;
+	int parsed, i;
 
 	parsed = csvn_parse(test_text, strlen(test_text), &parser, tokens, 0);
 	printf("Parsed %d normal tokens\n", parsed);
@@ -82,10 +167,10 @@ test_normal()
 	printf("Parsed %d normal tokens\n", parsed);
 	check(parsed == 5);
 
-	for (int i = 0; i < parsed; i++) {
+	for (i = 0; i < parsed; i++) {
 	
 		char *parsed = get_parsed(&tokens[i], test_text);
-		printf("Parsed token: %s at line %d\n", parsed, tokens[i].line);
+		printf("Parsed token: %s at line %d\n", parsed, token_line(tokens[i]));
 		free(parsed);		
 
 	}
@@ -108,14 +193,16 @@ test_quoted()
 	char *test_text = "\"parse, this\"\" text\"\n\"then parse this text\"";
 	
 	int parsed = csvn_parse(test_text, strlen(test_text), &parser, tokens, 6);
+	int i;
 
 	printf("Parsed %d quoted tokens\n", parsed);
 	check(parsed == 2);
 
-	for (int i = 0; i < parsed; i++) {
+	for (i = 0; i < parsed; i++) {
 		
 		char *parsed = get_parsed(&tokens[i], test_text);
-		printf("Parsed token: %s (start: %d, end: %d)\n", parsed, tokens[i].start, tokens[i].end);
+		printf("Parsed token: %s (start: %ld, end: %ld)\n", parsed, 
+		       (long)CSVN_TOK_START(tokens[i]), (long)CSVN_TOK_END(tokens[i]));
 		free(parsed);
 
 	}
@@ -142,13 +229,15 @@ test_newlines()
 	char *test_text = "parse,this,text\nthen,this\nthen,finally,this\nand,then\nthis";
 
 	int parsed = csvn_parse(test_text, strlen(test_text), &parser, tokens, 11);
+	int i;
 	printf("Parsed %d newline tokens\n", parsed);
 	check(parsed == 11);
 	
-	for (int i = 0; i < parsed; i++) {
+	for (i = 0; i < parsed; i++) {
 		
 		char *parsed = get_parsed(&tokens[i], test_text);
-		printf("Parsed token: %s (start: %d, end: %d, line: %d)\n", parsed, tokens[i].start, tokens[i].end, tokens[i].line);
+		printf("Parsed token: %s (start: %ld, end: %ld, line: %d)\n", parsed, 
+		       (long)CSVN_TOK_START(tokens[i]), (long)CSVN_TOK_END(tokens[i]), token_line(tokens[i]));
 		free(parsed);
 
 	}
@@ -157,30 +246,1615 @@ test_newlines()
 
 }
 
-int 
-main(int argc, char **argv) 
+static int
+test_long_fields()
+{
+
+	struct csv_t tokens[4];
+	struct csv_p parser;
+	csvn_init(&parser);
+
+	/*
+		fields long enough to span several vector widths, with an
+		escaped quote and a newline inside the quoted one
+	*/
+	char *test_text = "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa,"
+			  "\"bbbbbbbbbbbbbbbbbbbb\"\"bbbbbbbbbbbbbbbb\nbbbb\",c\n"
+			  "dddddddddddddddddddddddddddddddddd";
+
+	int parsed = csvn_parse(test_text, strlen(test_text), &parser, tokens, 4);
+	printf("Parsed %d long tokens\n", parsed);
+	check(parsed == 4);
+
+	check(CSVN_TOK_START(tokens[0]) == 0 && CSVN_TOK_END(tokens[0]) == 39 && on_line(tokens[0], 1));
+	check(CSVN_TOK_START(tokens[1]) == 42 && CSVN_TOK_END(tokens[1]) == 84 && on_line(tokens[1], 1));
+	check(CSVN_TOK_START(tokens[2]) == 87 && CSVN_TOK_END(tokens[2]) == 87 && on_line(tokens[2], 2));
+	check(CSVN_TOK_START(tokens[3]) == 89 && on_line(tokens[3], 3));
+
+	done();
+
+}
+
+static int
+test_index()
+{
+
+	struct csv_t tokens[8], expected[8];
+	struct csv_p parser;
+	struct csvn_idx idx;
+	struct csvn_dialect consider;
+	size_t offsets[8];
+	char long_text[70];
+	int parsed, i;
+
+	/*
+		a,"b,c",d
+		"e
+		f",g
+	*/
+	char *test_text = "a,\"b,c\",d\n\"e\nf\",g";
+
+	csvn_index_init(&idx);
+	check(csvn_index(test_text, strlen(test_text), &idx, offsets, 8) == 4);
+	check(offsets[0] == 1 && offsets[1] == 7 && offsets[2] == 9 && offsets[3] == 15);
+	check(idx.quoted == 0);
+
+	csvn_init(&parser);
+	parsed = csvn_parse_index(test_text, strlen(test_text), &idx, offsets, 
+				  &parser, tokens, 8);
+	printf("Parsed %d indexed tokens\n", parsed);
+	check(parsed == 5);
+
+	csvn_init(&parser);
+	check(csvn_parse(test_text, strlen(test_text), &parser, expected, 8) == parsed);
+
+	for (i = 0; i < parsed; i++) {
+		check(CSVN_TOK_START(tokens[i]) == CSVN_TOK_START(expected[i]));
+		check(CSVN_TOK_END(tokens[i]) == CSVN_TOK_END(expected[i]));
+		check(on_line(tokens[i], token_line(expected[i])));
+		check(CSVN_TOK_KIND(tokens[i]) == CSVN_TOK_KIND(expected[i]));
+	}
+
+	/* too small index has to be resumable */
+	csvn_index_init(&idx);
+	check(csvn_index(test_text, strlen(test_text), &idx, offsets, 2) == NOT_ENOUGH_MEM);
+	check(csvn_index(test_text, strlen(test_text), &idx, offsets, 8) == 4);
+
+	/* a resumed call given fewer offsets than were already found can not store any */
+	memset(long_text, 'x', 70);
+	long_text[10] = long_text[20] = long_text[30] = ',';
+	long_text[66] = long_text[68] = ',';
+	csvn_index_init(&idx);
+	check(csvn_index(long_text, 70, &idx, offsets, 4) == NOT_ENOUGH_MEM);
+	check(idx.count == 3 && idx.pos == 64);
+	check(csvn_index(long_text, 70, &idx, offsets, 2) == NOT_ENOUGH_MEM);
+	check(csvn_index(long_text, 70, &idx, offsets, 8) == 5 && offsets[4] == 68);
+
+	/* a quoted field is numbered by the line it ends in just like csvn_parse does */
+	csvn_dialect_init(&consider);
+	consider.flags |= CSVN_DIALECT_CONSIDER_NL;
+	csvn_index_init(&idx);
+	idx.dialect = &consider;
+	check(csvn_index(test_text, strlen(test_text), &idx, offsets, 8) == 4);
+	csvn_init(&parser);
+	parser.dialect = &consider;
+	parsed = csvn_parse_index(test_text, strlen(test_text), &idx, offsets, 
+				  &parser, tokens, 8);
+	check(parsed == 5 && on_line(tokens[3], 3) && on_line(tokens[4], 3));
+	csvn_init(&parser);
+	parser.dialect = &consider;
+	check(csvn_parse(test_text, strlen(test_text), &parser, expected, 8) == parsed);
+	for (i = 0; i < parsed; i++) {
+		check(on_line(tokens[i], token_line(expected[i])));
+	}
+
+	/* more positions than an int holds are still counted */
+	csvn_index_init(&idx);
+	idx.count = 0x7fffffff;
+	check(csvn_index(test_text, strlen(test_text), &idx, NULL, 0) == OUT_OF_RANGE);
+	check(idx.count == (size_t)0x7fffffff + 4);
+
+	done();
+
+}
+
+static int
+test_validate()
+{
+
+	struct csvn_dialect loose;
+	struct csvn_shape shape;
+	char text[256];
+	int i, len = 0;
+
+	/* rows of 3 fields, quoted ones crossing the blocks of 64 characters */
+	for (i = 0; i < 9; i++) {
+		len += sprintf(text + len, "%d,\"x,\n\"\"y\",z%s\n", i, (i == 4) ? "\n" : "");
+	}
+
+	memset(&shape, 0, sizeof(shape));
+	check(csvn_validate(text, len, NULL, &shape) == 0);
+	check(shape.rows == 9 && shape.max_fields == 3);
+
+	shape.fields = 3;
+	check(csvn_validate(text, len, NULL, &shape) == 0);
+	check(csvn_validate(text, len - 1, NULL, &shape) == 0 && shape.rows == 9);
+	printf("Validated %d rows of %d fields\n", (int)shape.rows, shape.max_fields);
+
+	/* the closing quote right at the end of a block has to be followed by a delimiter */
+	memset(text, 'a', 63);
+	text[0] = '\"';
+	text[62] = '\"';
+	text[63] = 'b';
+	text[64] = '\0';
+	check(csvn_validate(text, 64, NULL, &shape) == INVALID_CHARACTER);
+	check(shape.bad_row == 0 && shape.bad_offset == 0);
+	text[63] = ',';
+	check(csvn_validate(text, 64, NULL, &shape) == WRONG_FIELD_COUNT);
+	shape.fields = 2;
+	check(csvn_validate(text, 64, NULL, &shape) == 0 && shape.rows == 1);
+
+	/* the first malformed row is reported */
+	shape.fields = 2;
+	strcpy(text, "a,b\n\nc,\"d\"\"\"\nc,d,e\n");
+	check(csvn_validate(text, strlen(text), NULL, &shape) == WRONG_FIELD_COUNT);
+	check(shape.rows == 2 && shape.bad_row == 2 && shape.bad_offset == 13);
+
+	strcpy(text, "a,b\nc,d\"\ne,\"f");
+	check(csvn_validate(text, strlen(text), NULL, &shape) == INVALID_CHARACTER);
+	check(shape.bad_row == 1 && shape.bad_offset == 4);
+
+	/* a loose dialect only counts, even the rows quoted improperly */
+	csvn_dialect_init(&loose);
+	loose.flags &= ~CSVN_DIALECT_STRICT;
+	loose.flags |= CSVN_DIALECT_CRLF;
+	strcpy(text, "a,\"b\"c\r\nd\r\n\r\n");
+	shape.fields = 0;
+	check(csvn_validate(text, strlen(text), &loose, &shape) == 0);
+	check(shape.rows == 2 && shape.max_fields == 2);
+
+	done();
+
+}
+
+static int
+test_stream()
 {
+
+	struct csv_t tokens[4], expected[16];
+	struct csv_p parser;
+	char buffer[16];
+	size_t buflen = 0, fed = 0, base = 0, discard;
+	int parsed, total = 0, count, i;
+
 	/*
-	test(test_normal, "parsing of normal line");
-	test(test_quoted, "parsing of quoted lines");
-	test(test_newlines, "parsing of newlines");
+		fields split at every possible position, including right
+		after a quote and within an escaped one
 	*/
+	char *test_text = "ab,\"c\"\"d\",,\"e\nf\"\ngh,\"\"\"\"";
+	size_t textlen = strlen(test_text);
+
+	csvn_init(&parser);
+	count = csvn_parse(test_text, textlen, &parser, expected, 16);
+	check(count == 6);
+
+	csvn_init(&parser);
+
+	while (fed < textlen) {
+
+		/* feed at most 3 new characters at a time */
+		for (i = 0; i < 3 && fed < textlen; i++) {
+			buffer[buflen++] = test_text[fed++];
+		}
+
+		parsed = csvn_parse_stream(buffer, buflen, &parser, tokens, 4, fed == textlen);
+		check(parsed >= 0);
+
+		for (i = 0; i < parsed; i++, total++) {
+			check(total < count);
+			check(CSVN_TOK_START(tokens[i]) + (int)base == CSVN_TOK_START(expected[total]));
+			check(CSVN_TOK_END(tokens[i]) + (int)base == CSVN_TOK_END(expected[total]));
+			check(on_line(tokens[i], token_line(expected[total])));
+			check(CSVN_TOK_KIND(tokens[i]) == CSVN_TOK_KIND(expected[total]));
+		}
+
+		discard = csvn_discardable(&parser);
+		check(discard <= buflen);
+
+		memmove(buffer, buffer + discard, buflen - discard);
+		buflen -= discard;
+		base += discard;
+		csvn_discard(&parser, discard);
+
+	}
+
+	printf("Parsed %d streamed tokens\n", total);
+	check(total == count);
+
+	done();
+
+}
+
+static int
+test_parallel()
+{
+
+	static struct csv_t tokens[1000], expected[1000];
+	struct csv_p parser;
+	char test_text[8192];
+	size_t textlen = 0;
+	int parsed, count, i;
+
+	/* quoted fields with newlines and delimeters cross the chunk boundaries */
+	for (i = 0; i < 200; i++) {
+		strcpy(test_text + textlen, i % 3 ? "ab,\"c\"\",\nd\",e\n" : "fgh,,i\n");
+		textlen += strlen(test_text + textlen);
+	}
+
+	csvn_init(&parser);
+	count = csvn_parse(test_text, textlen, &parser, expected, 1000);
+
+	csvn_init(&parser);
+	parsed = csvn_parse_parallel(test_text, textlen, 4, &parser, tokens, 1000);
+	printf("Parsed %d tokens in parallel\n", parsed);
+	check(parsed == count);
+	check(parser.line == 334);
+
+	for (i = 0; i < parsed; i++) {
+		check(CSVN_TOK_START(tokens[i]) == CSVN_TOK_START(expected[i]));
+		check(CSVN_TOK_END(tokens[i]) == CSVN_TOK_END(expected[i]));
+		check(on_line(tokens[i], token_line(expected[i])));
+		check(CSVN_TOK_KIND(tokens[i]) == CSVN_TOK_KIND(expected[i]));
+	}
+
+	csvn_init(&parser);
+	check(csvn_parse_parallel(test_text, textlen, 4, &parser, NULL, 0) == count);
+
+	csvn_init(&parser);
+	check(csvn_parse_parallel(test_text, textlen, 4, &parser, tokens, 10) == NOT_ENOUGH_MEM);
+	check(parser.pos == 0 && parser.toknext == 0);
+
+	done();
+
+}
+
+static int
+test_pipeline()
+{
+
+	struct csv_t tokens[8], expected[64];
+	struct csvn_pipeline pl;
+	struct csv_p parser;
+	char buffer[3 * 24];
+	size_t base = 0, discard;
+	int fds[2], parsed, total = 0, count, windows = 0, res, i;
+
+	/* every read gets at most 12 new characters */
+	char *test_text = "ab,\"c\"\"d\",,\"e\nf\"\ngh,\"\"\"\"\n"
+			  "0123456789,x\r\nlast,row,\"without\",end";
+	size_t textlen = strlen(test_text);
+
+	csvn_init(&parser);
+	count = csvn_parse(test_text, textlen, &parser, expected, 64);
+	check(count == 12);
+
+	check(pipe(fds) == 0);
+	check(write(fds[1], test_text, textlen) == (ssize_t)textlen);
+	close(fds[1]);
+
+	check(csvn_start_pipeline(&pl, fds[0], buffer, sizeof(buffer), 1) == OUT_OF_RANGE);
+	check(csvn_start_pipeline(&pl, fds[0], buffer, sizeof(buffer), 3) == 0);
+	csvn_init(&parser);
+
+	for (;;) {
+
+		/* the tokens of a window start where the parser discarded */
+		discard = (windows > 0) ? csvn_discardable(&parser) : 0;
+		res = csvn_next_window(&pl, &parser);
+		if (res <= 0) {
+			break;
+		}
+
+		base += discard;
+		parsed = csvn_parse_stream(pl.text, pl.textlen, &parser, tokens, 8, pl.last);
+		check(parsed >= 0);
+
+		for (i = 0; i < parsed; i++, total++) {
+			check(total < count);
+			check(CSVN_TOK_START(tokens[i]) + (int)base == CSVN_TOK_START(expected[total]));
+			check(CSVN_TOK_END(tokens[i]) + (int)base == CSVN_TOK_END(expected[total]));
+			check(on_line(tokens[i], token_line(expected[total])));
+			check(CSVN_TOK_KIND(tokens[i]) == CSVN_TOK_KIND(expected[total]));
+		}
+		windows++;
+
+	}
+
+	/* the end is returned again, without waiting for the thread which has exited */
+	check(csvn_next_window(&pl, &parser) == 0);
+	check(csvn_notify_window(&pl, NULL, NULL) == 1);
+
+	csvn_stop_pipeline(&pl);
+	close(fds[0]);
+
+	printf("Parsed %d tokens in %d pipelined windows\n", total, windows);
+	check(res == 0 && total == count && windows > 3);
+
+	/* fields have to fit into half of a buffer */
+	check(pipe(fds) == 0);
+	check(write(fds[1], "a,0123456789abcdefghijklmnopqrstuvwxyz\n", 39) == 39);
+	close(fds[1]);
+
+	check(csvn_start_pipeline(&pl, fds[0], buffer, sizeof(buffer), 3) == 0);
+	csvn_init(&parser);
+
+	while ((res = csvn_next_window(&pl, &parser)) > 0) {
+		check(csvn_parse_stream(pl.text, pl.textlen, &parser, tokens, 8, pl.last) >= 0);
+	}
+	check(res == FIELD_TOO_LONG);
+
+	csvn_stop_pipeline(&pl);
+	close(fds[0]);
+
+	done();
+
+}
+
+/* compresses rows of 3 fields into a single gzip member */
+static size_t
+gzip_rows(unsigned char *out, size_t outlen, int rows)
+{
+
+	z_stream zs;
+	char text[13 * 256];
+	int i;
+
+	for (i = 0; i < rows && i < 256; i++) {
+		memcpy(text + 13 * i, "12,\"a,b\",xyz\n", 13);
+	}
+
+	memset(&zs, 0, sizeof(zs));
+	if (deflateInit2(&zs, 9, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+		return 0;
+	}
+
+	zs.next_in = (Bytef *)text;
+	zs.avail_in = (uInt)(13 * i);
+	zs.next_out = out;
+	zs.avail_out = (uInt)outlen;
+	if (deflate(&zs, Z_FINISH) != Z_STREAM_END) {
+		outlen = 0;
+	}
+	deflateEnd(&zs);
+
+	return (outlen == 0) ? 0 : outlen - zs.avail_out;
+
+}
+
+/* counts the fields of the decompressed stream, or returns its error */
+static int
+decode_fields(int fd, int *codec)
+{
+
+	struct csv_t tokens[32];
+	struct csvn_pipeline pl;
+	struct csv_p parser;
+	char buffer[4 * 64];
+	int fields = 0, parsed, res;
+
+	if (csvn_start_decoder(&pl, fd, buffer, sizeof(buffer), 3) != 0) {
+		return OUT_OF_RANGE;
+	}
+	csvn_init(&parser);
+
+	while ((res = csvn_next_window(&pl, &parser)) > 0) {
+
+		parsed = csvn_parse_stream(pl.text, pl.textlen, &parser, tokens, 32, pl.last);
+		if (parsed < 0) {
+			res = parsed;
+			break;
+		}
+		fields += parsed;
+
+	}
+
+	*codec = pl.codec;
+	csvn_stop_pipeline(&pl);
+	close(fd);
+
+	return (res < 0) ? res : fields;
+
+}
+
+static int
+test_decoder()
+{
+
+	struct csvn_pipeline pl;
+	unsigned char member[2][256];
+	size_t size[2];
+	char buffer[8];
+	int fds[2], codec, fields;
+
+	size[0] = gzip_rows(member[0], sizeof(member[0]), 200);
+	size[1] = gzip_rows(member[1], sizeof(member[1]), 150);
+	check(size[0] > 0 && size[1] > 0);
+
+	/* concatenated members make a single stream, decompressed through 64 characters at a time */
+	check(pipe(fds) == 0);
+	check(write(fds[1], member[0], size[0]) == (ssize_t)size[0]);
+	check(write(fds[1], member[1], size[1]) == (ssize_t)size[1]);
+	close(fds[1]);
+
+	fields = decode_fields(fds[0], &codec);
+	printf("Decompressed %d fields from %d bytes\n", fields, (int)(size[0] + size[1]));
+	check(fields == 3 * 350 && codec == CSVN_CODEC_GZIP);
+
+	/* other streams are passed through */
+	check(pipe(fds) == 0);
+	check(write(fds[1], "a,\"b\"\nc\n", 8) == 8);
+	close(fds[1]);
+	check(decode_fields(fds[0], &codec) == 3 && codec == CSVN_CODEC_PLAIN);
+
+	/* a stream cut within a member is an error, just like a corrupt one */
+	check(pipe(fds) == 0);
+	check(write(fds[1], member[0], size[0] - 4) == (ssize_t)size[0] - 4);
+	close(fds[1]);
+	check(decode_fields(fds[0], &codec) == IO_ERROR);
+
+	member[0][size[0] / 2] ^= 0x55;
+	check(pipe(fds) == 0);
+	check(write(fds[1], member[0], size[0]) == (ssize_t)size[0]);
+	close(fds[1]);
+	check(decode_fields(fds[0], &codec) == IO_ERROR);
+
+#ifdef CSVN_ZSTD
+	/* a zstd frame of the same rows (make test-zstd) */
+	{
+		unsigned char frame[256];
+		char text[13 * 40];
+		int i;
+
+		for (i = 0; i < 40; i++) {
+			memcpy(text + 13 * i, "12,\"a,b\",xyz\n", 13);
+		}
+		size[0] = ZSTD_compress(frame, sizeof(frame), text, sizeof(text), 3);
+		check(!ZSTD_isError(size[0]));
+
+		check(pipe(fds) == 0);
+		check(write(fds[1], frame, size[0]) == (ssize_t)size[0]);
+		close(fds[1]);
+		check(decode_fields(fds[0], &codec) == 3 * 40 && codec == CSVN_CODEC_ZSTD);
+	}
+#endif
+
+	/* the magic number has to fit into the input */
+	check(csvn_start_decoder(&pl, 0, buffer, sizeof(buffer), 3) == OUT_OF_RANGE);
+
+	done();
+
+}
+
+static void
+batch_done(void *ctx, struct csvn_job *job)
+{
+
+	int *order = (int *)ctx;
+
+	/* the jobs are handed over in order, with their own result */
+	if (job->res >= 0 && job->parser.grow != NULL) {
+		order[0] += (job->parser.toknext == job->res);
+	}
+	order[1]++;
+
+}
+
+static int
+test_batch()
+{
+
+	struct csvn_job jobs[41];
+	struct csv_t expected[4096];
+	struct csv_p parser;
+	char *texts[40];
+	int grown[40];
+	int order[2] = {0, 0};
+	size_t len;
+	int i, j, count;
+
+	char *row = "batch,\"of, \"\"texts\"\"\",\"with\nrows\"\n";
+	size_t rowlen = strlen(row);
+
+	/* small texts and a large one, which is split */
+	for (i = 0; i < 40; i++) {
+
+		len = (i == 0) ? 1000 : (size_t)(i % 7) * 4;
+		texts[i] = malloc(len * rowlen + 1);
+		check(texts[i] != NULL);
+		for (j = 0; j < (int)len; j++) {
+			memcpy(texts[i] + j * rowlen, row, rowlen);
+		}
+
+		memset(&jobs[i], 0, sizeof(struct csvn_job));
+		jobs[i].text = texts[i];
+		jobs[i].textlen = len * rowlen;
+		csvn_init(&jobs[i].parser);
+		jobs[i].parser.grow = grow_tokens;
+		jobs[i].parser.ctx = &grown[i];
+		grown[i] = 0;
+
+	}
+
+	memset(&jobs[40], 0, sizeof(struct csvn_job));
+	jobs[40].path = "csvn_missing.csv";
+	csvn_init(&jobs[40].parser);
+
+	check(csvn_parse_batch(jobs, 41, 4, batch_done, order) == 0);
+	check(order[0] == 40 && order[1] == 41);
+	check(jobs[40].res == IO_ERROR);
+
+	/* only the large text is split, among the threads the others leave idle */
+	for (i = 0; i < 40; i++) {
+		check(jobs[i].split >= 1 && jobs[i].split <= 4);
+		check(jobs[i].split == 1 || i == 0);
+	}
+
+	/* on its own, it gets all of them */
+	free(jobs[0].parser.tokens);
+	csvn_init(&jobs[0].parser);
+	jobs[0].parser.grow = grow_tokens;
+	jobs[0].parser.ctx = &grown[0];
+	check(csvn_parse_batch(jobs, 1, 4, NULL, NULL) == 0);
+	check(jobs[0].split == 4);
+
+	for (i = 0; i < 40; i++) {
+
+		csvn_init(&parser);
+		count = csvn_parse(jobs[i].text, jobs[i].textlen, &parser, expected, 4096);
+		check(jobs[i].res == count);
+
+		for (j = 0; j < count; j++) {
+			check(CSVN_TOK_START(jobs[i].parser.tokens[j]) == CSVN_TOK_START(expected[j]));
+			check(CSVN_TOK_END(jobs[i].parser.tokens[j]) == CSVN_TOK_END(expected[j]));
+			check(on_line(jobs[i].parser.tokens[j], token_line(expected[j])));
+		}
+
+		free(jobs[i].parser.tokens);
+		free(texts[i]);
+
+	}
+
+	done();
+
+}
+
+static int
+test_arena()
+{
+
+	static struct csv_t expected[1000];
+	struct csvn_arena arena;
+	struct csv_p parser;
+	struct csv_r rows[400];
+	char test_text[8192], *first, *copy;
+	size_t textlen = 0;
+	int count, i;
+
+	for (i = 0; i < 200; i++) {
+		strcpy(test_text + textlen, i % 3 ? "ab,\"c\"\",\nd\",e\n" : "fgh,,i\n");
+		textlen += strlen(test_text + textlen);
+	}
+
+	csvn_init(&parser);
+	parser.rows = rows;
+	parser.num_row = 400;
+	count = csvn_parse(test_text, textlen, &parser, expected, 1000);
+	check(count == 600);
+
+	/* blocks of 64, 128, 256... characters, every allocation aligned */
+	csvn_arena_init(&arena, 64);
+	first = (char *)csvn_arena_alloc(&arena, 1);
+	check(first != NULL && ((size_t)first & 15) == 0);
+	for (i = 0; i < 100; i++) {
+		check(((size_t)csvn_arena_alloc(&arena, (size_t)i) & 15) == 0);
+	}
+	check(arena.first != NULL && arena.first->size == 64 && arena.first->next != NULL);
+
+	copy = csvn_copy_field(&arena, test_text, &expected[4], NULL, 0);
+	check(copy != NULL && strcmp(copy, "c\",\nd") == 0);
+	copy = csvn_copy_field(&arena, test_text, &expected[1], NULL, 0);
+	check(copy != NULL && copy[0] == '\0');
+	copy = csvn_copy_field(&arena, test_text, &expected[0], NULL, 0);
+	check(copy != NULL && strcmp(copy, "fgh") == 0);
+
+	/* a reset gives out the same blocks again */
+	csvn_arena_reset(&arena);
+	check(arena.allocated == 0);
+	check(csvn_arena_alloc(&arena, 1) == first);
+
+	/* the pools of the parser grow from the arena (in place while they can) */
+	csvn_arena_reset(&arena);
+	csvn_init(&parser);
+	parser.grow = csvn_arena_grow;
+	parser.ctx = &arena;
+	check(csvn_parse(test_text, textlen, &parser, NULL, 0) == count);
+	for (i = 0; i < count; i++) {
+		check(CSVN_TOK_START(parser.tokens[i]) == CSVN_TOK_START(expected[i]));
+		check(on_line(parser.tokens[i], token_line(expected[i])));
+	}
+
+	/* so do the ones of the threads, from arenas of their own */
+	csvn_arena_reset(&arena);
+	csvn_init(&parser);
+	parser.grow = csvn_arena_grow;
+	parser.ctx = &arena;
+	parser.rows = (struct csv_r *)csvn_arena_grow(&arena, NULL, 4 * sizeof(struct csv_r));
+	parser.num_row = 4;
+	check(csvn_parse_parallel(test_text, textlen, 4, &parser, NULL, 0) == count);
+	check(parser.rownext == 200);
+	for (i = 0; i < count; i++) {
+		check(CSVN_TOK_START(parser.tokens[i]) == CSVN_TOK_START(expected[i]));
+		check(CSVN_TOK_END(parser.tokens[i]) == CSVN_TOK_END(expected[i]));
+	}
+	for (i = 0; i < 200; i++) {
+		check(parser.rows[i].token == rows[i].token && parser.rows[i].line == rows[i].line);
+	}
+
+	/* pools of the caller are copied into the arena, which never sees them */
+	csvn_arena_reset(&arena);
+	csvn_init(&parser);
+	parser.grow = csvn_arena_grow;
+	parser.ctx = &arena;
+	parser.rows = rows;
+	parser.num_row = 8;
+	check(csvn_parse(test_text, textlen, &parser, expected + 900, 16) == count);
+	check(parser.tokens != expected + 900 && parser.rows != rows && parser.rownext == 200);
+	for (i = 0; i < count; i++) {
+		check(CSVN_TOK_START(parser.tokens[i]) == CSVN_TOK_START(expected[i]));
+	}
+	check(parser.rows[199].token == rows[199].token);
+
+	csvn_arena_free(&arena);
+	check(arena.first == NULL);
+
+	done();
+
+}
+
+static void *
+grow_tokens(void *ctx, void *ptr, size_t size)
+{
+
+	(*(int *)ctx)++;
+
+	return realloc(ptr, size);
+
+}
+
+static int
+test_grow()
+{
+
+	struct csv_t tokens[4], *pool;
+	struct csv_r rows[2];
+	struct csv_p parser;
+	int grown = 0;
+	int parsed, i;
+
+	char *test_text = "parse,this,text\nthen,this\nthen,finally,this\nand,then\nthis";
+
+	csvn_init(&parser);
+	parser.grow = grow_tokens;
+	parser.ctx = &grown;
+
+	/* nothing is allocated upfront, the parser does it in a single pass */
+	parsed = csvn_parse(test_text, strlen(test_text), &parser, NULL, 0);
+	printf("Parsed %d tokens into a grown pool\n", parsed);
+	check(parsed == 11);
+	check(grown == 1);
+	check(parser.tokens != NULL && parser.num_tok >= 11);
+
+	for (i = 0; i < parsed; i++) {
+		check(CSVN_TOK_KIND(parser.tokens[i]) == TEXT);
+	}
+	check(CSVN_TOK_START(parser.tokens[10]) == 53 && CSVN_TOK_END(parser.tokens[10]) == 56);
+
+	free(parser.tokens);
+
+	/* a token or row pool of the caller is copied into the first grown one, not handed to grow */
+	csvn_init(&parser);
+	parser.grow = grow_tokens;
+	parser.ctx = &grown;
+	parser.rows = rows;
+	parser.num_row = 2;
+
+	parsed = csvn_parse(test_text, strlen(test_text), &parser, tokens, 4);
+	check(parsed == 11 && parser.tokens != tokens && parser.rows != rows);
+	check(parser.ownrows && parser.rownext == 5 && parser.rows[4].token == 10);
+	check(same_tokens(parser.tokens, tokens, 4));
+	check(rows[1].count == 2 && parser.rows[1].count == 2);
+	pool = parser.tokens;
+
+	/* a reset parser keeps the pools it has grown */
+	csvn_reset(&parser);
+	parsed = csvn_parse(test_text, 15, &parser, tokens, 4);
+	check(parsed == 3 && parser.tokens == pool && parser.rownext == 1);
+	check(CSVN_TOK_START(parser.tokens[2]) == 11 && CSVN_TOK_END(parser.tokens[2]) == 14);
+
+	free(parser.tokens);
+	free(parser.rows);
+
+	done();
+
+}
+
+static int
+test_rows()
+{
+
+	struct csv_t tokens[8];
+	struct csv_r rows[4];
+	struct csv_p parser;
+	int parsed;
+
+	/* the quoted field spans two lines but opens a single row */
+	char *test_text = "a,b\n\"x\ny\",c\n\nd";
+
+	csvn_init(&parser);
+	parser.rows = rows;
+	parser.num_row = 4;
+
+	parsed = csvn_parse(test_text, strlen(test_text), &parser, tokens, 8);
+	printf("Parsed %d tokens in %d rows\n", parsed, parser.rownext);
+	check(parsed == 5);
+	check(parser.rownext == 3);
+
+	check(rows[0].token == 0 && rows[0].count == 2 && rows[0].offset == 0);
+	check(rows[1].token == 2 && rows[1].count == 2 && rows[1].offset == 4);
+	check(rows[2].token == 4 && rows[2].count == 1 && rows[2].offset == 13);
+	check(CSVN_TOK_START(tokens[rows[1].token + 1]) == 10);
+	check(on_line(tokens[rows[2].token], rows[2].line));
+	check(CSVN_TOK_END(tokens[rows[1].token + 1]) == 10);
+
+	/* not enough rows and no grow hook */
+	csvn_init(&parser);
+	parser.rows = rows;
+	parser.num_row = 2;
+
+	parsed = csvn_parse(test_text, strlen(test_text), &parser, tokens, 8);
+	check(parsed == NOT_ENOUGH_MEM);
+
+	done();
+
+}
+
+static int
+test_mmap()
+{
+
+	struct csv_t tokens[4096], streamed[4096];
+	struct csvn_mmap map;
+	struct csv_p parser;
+	size_t end, pos = 0;
+	int parsed, res, i;
+	FILE *file;
+
+	char *path = "csvn_test.csv";
+	char *row = "mapped,\"file, which has\",no,terminator\n";
+
+	file = fopen(path, "wb");
+	check(file != NULL);
+	for (i = 0; i < 1000; i++) {
+		fputs(row, file);
+	}
+	fclose(file);
+
+	check(csvn_open_mmap(path, &map) == 0);
+	check(map.textlen == 1000 * strlen(row));
+	
+	csvn_init(&parser);
+	parsed = csvn_parse(map.text, map.textlen, &parser, tokens, 4096);
+	printf("Parsed %d tokens from a mapped file\n", parsed);
+	check(parsed == 4000);
+	check(CSVN_TOK_START(tokens[3999]) == (int)map.textlen - 11 && CSVN_TOK_SIZE(tokens[3999]) == 9);
+
+	/* parse it again in windows, releasing what has been parsed */
+	csvn_init(&parser);
+	for (end = 0, parsed = 0; end < map.textlen; ) {
+
+		end = (map.textlen - end > 10000) ? end + 10000 : map.textlen;
+		res = csvn_parse_stream(map.text, end, &parser, streamed + parsed, 
+					4096 - (size_t)parsed, end == map.textlen);
+		check(res >= 0);
+
+		parsed += res;
+		parser.toknext = 0;
+
+		check(csvn_discardable(&parser) >= pos);
+		pos = csvn_discardable(&parser);
+		csvn_release_mmap(&map, pos);
+		check(map.released <= pos && map.released % 4096 == 0);
+
+	}
+
+	check(parsed == 4000);
+	check(same_tokens(tokens, streamed, 4000));
+	check(map.released > 0);
+
+	csvn_close_mmap(&map);
+	remove(path);
+
+	/* nothing to map */
+	check(csvn_open_mmap(path, &map) == IO_ERROR);
+
+	done();
+
+}
+
+static int
+test_dialect()
+{
+
+	struct csv_t tokens[8];
+	struct csv_p parser;
+	struct csvn_dialect tsv, custom;
+	struct csvn_idx idx;
+	size_t offsets[8];
+	int parsed;
+
+	char *tsv_text = "a\t\"b\tc\"\t\td\ne,f";
+	char *custom_text = "a:'b:''c':d;e,f:'g;h'";
+
+	/* a common dialect, parsed by a specialized copy of the parser */
+	csvn_dialect_init(&tsv);
+	tsv.delim = '\t';
+
+	csvn_init(&parser);
+	parser.dialect = &tsv;
+	parsed = csvn_parse(tsv_text, strlen(tsv_text), &parser, tokens, 8);
+	printf("Parsed %d tab separated tokens\n", parsed);
+	check(parsed == 5);
+	check(CSVN_TOK_KIND(tokens[1]) == DQUOTE && CSVN_TOK_START(tokens[1]) == 3 && CSVN_TOK_END(tokens[1]) == 5);
+	check(CSVN_TOK_KIND(tokens[2]) == EMPTY);
+	check(CSVN_TOK_KIND(tokens[4]) == TEXT && CSVN_TOK_SIZE(tokens[4]) == 2);
+
+	/* any other dialect */
+	csvn_dialect_init(&custom);
+	custom.delim = ':';
+	custom.newline = ';';
+	custom.quote = '\'';
+	custom.flags = CSVN_DIALECT_STRICT;
+
+	csvn_init(&parser);
+	parser.dialect = &custom;
+	parsed = csvn_parse(custom_text, strlen(custom_text), &parser, tokens, 8);
+	printf("Parsed %d tokens of a custom dialect\n", parsed);
+	check(parsed == 5);
+	check(CSVN_TOK_KIND(tokens[1]) == DQUOTE && CSVN_TOK_SIZE(tokens[1]) == 4);
+	check(on_line(tokens[3], 2) && CSVN_TOK_SIZE(tokens[3]) == 2);
+	check(CSVN_TOK_KIND(tokens[4]) == DQUOTE && CSVN_TOK_START(tokens[4]) == 17);
+
+	/* the index has to be built in the same dialect */
+	csvn_index_init(&idx);
+	idx.dialect = &custom;
+	check(csvn_index(custom_text, strlen(custom_text), &idx, offsets, 8) == 4);
+
+	csvn_init(&parser);
+	parser.dialect = &custom;
+	parsed = csvn_parse_index(custom_text, strlen(custom_text), &idx, offsets, 
+				  &parser, tokens, 8);
+	check(parsed == 5 && CSVN_TOK_START(tokens[4]) == 17 && on_line(tokens[4], 2));
+
+	/* strictness is part of the dialect as well */
+	custom.flags = CSVN_DIALECT_STRICT;
+	csvn_init(&parser);
+	parser.dialect = &custom;
+	check(csvn_parse("a'b", 3, &parser, tokens, 8) == INVALID_CHARACTER);
+	custom.flags = 0;
+	csvn_init(&parser);
+	parser.dialect = &custom;
+	check(csvn_parse("a'b", 3, &parser, tokens, 8) == 1);
+
+	done();
+
+}
+
+static int
+test_crlf()
+{
+
+	struct csv_t tokens[8];
+	struct csv_p parser;
+	struct csvn_dialect crlf;
+	struct csvn_idx idx;
+	size_t offsets[8], fed;
+	int parsed, res;
+
+	char *crlf_text = "a,\"b\r\nc\"\r\nd,e\rf\r\n";
+
+	csvn_dialect_init(&crlf);
+	crlf.flags |= CSVN_DIALECT_CRLF;
+
+	csvn_init(&parser);
+	parser.dialect = &crlf;
+	parsed = csvn_parse(crlf_text, strlen(crlf_text), &parser, tokens, 8);
+	printf("Parsed %d CRLF tokens\n", parsed);
+	check(parsed == 5);
+	check(CSVN_TOK_KIND(tokens[1]) == DQUOTE && CSVN_TOK_SIZE(tokens[1]) == 3);
+	check(on_line(tokens[2], 3) && CSVN_TOK_START(tokens[2]) == 10);
+	check(CSVN_TOK_SIZE(tokens[3]) == 0 && on_line(tokens[3], 3));
+	check(CSVN_TOK_SIZE(tokens[4]) == 0 && on_line(tokens[4], 4));
+	check(parser.line == 5);
+
+	/* "\r\n" split between two parts of a stream is still one terminator */
+	csvn_init(&parser);
+	parser.dialect = &crlf;
+	parsed = 0;
+	for (fed = 1; fed <= strlen(crlf_text); fed++) {
+		res = csvn_parse_stream(crlf_text, fed, &parser, tokens, 8, 
+					fed == strlen(crlf_text));
+		check(res >= 0);
+		parsed += res;
+	}
+	check(parsed == 5 && on_line(tokens[4], 4) && parser.line == 5);
+
+	csvn_index_init(&idx);
+	idx.dialect = &crlf;
+	check(csvn_index(crlf_text, strlen(crlf_text), &idx, offsets, 8) == 7);
+
+	csvn_init(&parser);
+	parser.dialect = &crlf;
+	parsed = csvn_parse_index(crlf_text, strlen(crlf_text), &idx, offsets, 
+				  &parser, tokens, 8);
+	check(parsed == 5 && on_line(tokens[4], 4) && CSVN_TOK_SIZE(tokens[4]) == 0);
+
+	/* without the flag, '\r' is part of the last field of a row */
+	csvn_init(&parser);
+	parsed = csvn_parse("d,e\r\n", 5, &parser, tokens, 8);
+	check(parsed == 2 && CSVN_TOK_SIZE(tokens[1]) == 1);
+
+	done();
+
+}
+
+static int
+test_unescape()
+{
+
+	struct csv_t tokens[8];
+	struct csv_p parser;
+	int parsed;
+
+	char text[] = "\"a \"\"b\"\" c\",\"d\",\"\"\"\"\ne";
+
+	/* the flag is set without touching the text */
+	csvn_init(&parser);
+	parsed = csvn_parse(text, strlen(text), &parser, tokens, 8);
+	check(parsed == 4);
+	check(CSVN_TOK_ESCAPED(tokens[0]) && CSVN_TOK_SIZE(tokens[0]) == 8);
+	check(!CSVN_TOK_ESCAPED(tokens[1]) && !CSVN_TOK_ESCAPED(tokens[3]));
+	check(CSVN_TOK_ESCAPED(tokens[2]) && CSVN_TOK_SIZE(tokens[2]) == 1);
+	check(CSVN_TOK_KIND(tokens[0]) == DQUOTE && CSVN_TOK_KIND(tokens[3]) == TEXT);
+
+	csvn_init(&parser);
+	parsed = csvn_parse_unescape(text, strlen(text), &parser, tokens, 8);
+	printf("Parsed %d unescaped tokens\n", parsed);
+	check(parsed == 4);
+	check(CSVN_TOK_ESCAPED(tokens[0]) && CSVN_TOK_SIZE(tokens[0]) == 6);
+	check(strncmp(text + CSVN_TOK_START(tokens[0]), "a \"b\" c", 7) == 0);
+	check(text[CSVN_TOK_START(tokens[1])] == 'd' && CSVN_TOK_SIZE(tokens[1]) == 0);
+	check(CSVN_TOK_SIZE(tokens[2]) == 0 && text[CSVN_TOK_START(tokens[2])] == '\"');
+	check(on_line(tokens[3], 2) && text[CSVN_TOK_START(tokens[3])] == 'e');
+
+	done();
+
+}
+
+static int
+test_convert()
+{
+
+	struct csv_t tokens[16];
+	struct csv_p parser;
+	int64_t i;
+	double f;
+	int parsed;
+
+	char *test_text = "42,-9223372036854775808,12345678901234567,9223372036854775808,4x,"
+			  "3.25,-1e-3,\"0.1\",1.,.,"
+			  "2024-02-29,2000-01-01T00:00:01.5Z,1970-01-01 02:00+02:00,2023-02-29,,";
+
+	csvn_init(&parser);
+	parsed = csvn_parse(test_text, strlen(test_text), &parser, tokens, 16);
+	printf("Parsed %d tokens to convert\n", parsed);
+	check(parsed == 15);
+
+	check(csvn_to_i64(test_text, &tokens[0], &i) == 0 && i == 42);
+	check(csvn_to_i64(test_text, &tokens[1], &i) == 0 && i == -9223372036854775807LL - 1);
+	check(csvn_to_i64(test_text, &tokens[2], &i) == 0 && i == 12345678901234567LL);
+	check(csvn_to_i64(test_text, &tokens[3], &i) == OUT_OF_RANGE);
+	check(csvn_to_i64(test_text, &tokens[4], &i) == INVALID_CHARACTER);
+
+	check(csvn_to_f64(test_text, &tokens[5], &f) == 0 && f == 3.25);
+	check(csvn_to_f64(test_text, &tokens[6], &f) == 0 && f == -1e-3);
+	check(csvn_to_f64(test_text, &tokens[7], &f) == 0 && f == 0.1);
+	check(csvn_to_f64(test_text, &tokens[8], &f) == 0 && f == 1.0);
+	check(csvn_to_f64(test_text, &tokens[9], &f) == INVALID_CHARACTER);
+
+	check(csvn_to_time(test_text, &tokens[10], &i) == 0 && i == 1709164800LL * 1000000);
+	check(csvn_to_time(test_text, &tokens[11], &i) == 0 && i == 946684801500000LL);
+	check(csvn_to_time(test_text, &tokens[12], &i) == 0 && i == 0);
+	check(csvn_to_time(test_text, &tokens[13], &i) == INVALID_CHARACTER);
+
+	/* empty fields hold no value */
+	check(csvn_to_i64(test_text, &tokens[14], &i) == INVALID_CHARACTER);
+
+	done();
+
+}
+
+static int
+test_columns()
+{
+
+	struct csvn_col columns[3];
+	struct csv_p parser;
+	int parsed, i, grown = 0;
+
+	char *test_text = "1,one,1.5\n2,\"two\"\n\n,three,3e2,extra\n4,four,-4";
+
+	memset(columns, 0, sizeof(columns));
+	columns[0].type = CSVN_COL_I64;
+	columns[1].type = CSVN_COL_SPAN;
+	columns[2].type = CSVN_COL_F64;
+
+	/* 
+	   no tokens are stored, only the columns are grown, and fields stay 
+	   in their column even if an empty one before them has no token
+	*/
+	csvn_init(&parser);
+	parser.grow = grow_tokens;
+	parser.ctx = &grown;
+	parser.columns = columns;
+	parser.num_col = 3;
+
+	parsed = csvn_parse(test_text, strlen(test_text), &parser, NULL, 0);
+	printf("Parsed %d fields into %d rows\n", parsed, (int)parser.colnext);
+	check(parsed == 11 && parser.colnext == 4 && parser.tokens == NULL && grown == 7);
+
+	check(columns[0].valid[0] == 0xB && columns[1].valid[0] == 0xF);
+	check(columns[2].valid[0] == 0xD);
+	check(((int64_t *)columns[0].values)[3] == 4);
+	check(((csvn_off *)columns[1].values)[1] == 13 && columns[1].sizes[1] == 2);
+	check(((double *)columns[2].values)[2] == 300.0);
+	check(((double *)columns[2].values)[3] == -4.0);
+
+	/* typed columns report fields which do not convert (reset, so the grown columns are kept) */
+	csvn_reset(&parser);
+	check(csvn_parse("x,y,z", 5, &parser, NULL, 0) == INVALID_CHARACTER);
+
+	for (i = 0; i < 3; i++) {
+		free(columns[i].values);
+		free(columns[i].sizes);
+		free(columns[i].valid);
+	}
+
+	done();
+
+}
+
+static int
+test_projection()
+{
+
+	struct csv_t tokens[8];
+	struct csv_p parser;
+	struct csvn_idx idx;
+	size_t offsets[32];
+	unsigned char projection = 0x5;
+	int parsed, i;
+
+	char *test_text = "a,b,c,d\n1,,3,4444\n\"x\",y,\"z\",w";
+	static const int starts[] = {0, 4, 8, 11, 19, 25};
+
+	/* only the first and third column are kept, the fourth one is past the projection */
+	csvn_init(&parser);
+	parser.projection = &projection;
+	parser.num_proj = 3;
+
+	parsed = csvn_parse(test_text, strlen(test_text), &parser, tokens, 6);
+	printf("Parsed %d projected fields\n", parsed);
+	check(parsed == 6 && (size_t)parser.pos == strlen(test_text));
+
+	for (i = 0; i < 6; i++) {
+		check(CSVN_TOK_START(tokens[i]) == starts[i] && CSVN_TOK_SIZE(tokens[i]) == 0);
+	}
+
+	/* so does the two-stage parser */
+	csvn_init(&parser);
+	parser.projection = &projection;
+	parser.num_proj = 3;
+	csvn_index_init(&idx);
+
+	check(csvn_index(test_text, strlen(test_text), &idx, offsets, 32) == 11);
+	parsed = csvn_parse_index(test_text, strlen(test_text), &idx, offsets, &parser, tokens, 6);
+	check(parsed == 6);
+
+	for (i = 0; i < 6; i++) {
+		check(CSVN_TOK_START(tokens[i]) == starts[i]);
+	}
+
+	done();
+
+}
+
+static int
+test_filter()
+{
+
+	struct csvn_col columns[3];
+	struct csvn_pred preds[2];
+	struct csv_t tokens[8];
+	struct csv_r rows[4];
+	struct csv_p parser;
+	int parsed, i, grown = 0, counts[4];
+
+	char *test_text = "level,msg,ms\nINFO,ok,5\nERROR,disk full,120\n"
+			  "WARN,slow,800\nERROR,\"timeout\",950\nERROR\n";
+
+	memset(preds, 0, sizeof(preds));
+	preds[0].column = 0;
+	preds[0].type = CSVN_PRED_EQUALS;
+	preds[0].text = "ERROR";
+	preds[0].len = 5;
+	preds[1].column = 2;
+	preds[1].type = CSVN_PRED_RANGE;
+	preds[1].min = 100;
+	preds[1].max = 1000;
+
+	/* the last row lacks the third field, so it is dropped as well */
+	csvn_init(&parser);
+	parser.preds = preds;
+	parser.num_pred = 2;
+	parser.rows = rows;
+	parser.num_row = 4;
+
+	parsed = csvn_parse(test_text, strlen(test_text), &parser, tokens, 8);
+	printf("Parsed %d fields of %d rows\n", parsed, parser.rownext);
+	check(parsed == 6 && parser.toknext == 6 && parser.rownext == 2);
+	check(rows[1].token == 3 && rows[1].count == 3 && rows[1].line == 5);
+	check(CSVN_TOK_START(tokens[0]) == 23 && CSVN_TOK_START(tokens[4]) == 64 && CSVN_TOK_KIND(tokens[4]) == DQUOTE);
+
+	/* dropped rows take no values of the columns either */
+	memset(columns, 0, sizeof(columns));
+	columns[2].type = CSVN_COL_I64;
+	preds[0].type = CSVN_PRED_PREFIX;
+	preds[0].text = "ERR";
+	preds[0].len = 3;
+
+	csvn_init(&parser);
+	parser.grow = grow_tokens;
+	parser.ctx = &grown;
+	parser.columns = columns;
+	parser.num_col = 3;
+	parser.preds = preds;
+	parser.num_pred = 2;
+
+	parsed = csvn_parse(test_text, strlen(test_text), &parser, NULL, 0);
+	check(parsed == 6 && parser.colnext == 2 && columns[2].valid[0] == 0x3);
+	check(((int64_t *)columns[2].values)[0] == 120 && ((int64_t *)columns[2].values)[1] == 950);
+
+	for (i = 0; i < 3; i++) {
+		free(columns[i].values);
+		free(columns[i].sizes);
+		free(columns[i].valid);
+	}
+
+	/* the fields of a row are handed out before it can be dropped, so callbacks are refused */
+	memset(counts, 0, sizeof(counts));
+	csvn_init(&parser);
+	parser.preds = preds;
+	parser.num_pred = 2;
+	parser.on_field = count_field;
+	parser.on_row_end = count_row;
+	parser.sink = counts;
+	check(csvn_parse(test_text, strlen(test_text), &parser, tokens, 8) == INVALID_SETTINGS);
+	check(counts[0] == 0 && counts[3] == 0 && parser.pos == 0);
+
+	done();
+
+}
+
+static int 
+count_field(void *sink, csvn_off start, csvn_off len, enum csv_tok kind)
+{
+
+	int *counts = (int *)sink;
+
+	(void)start;
+	counts[0]++;
+	counts[1] += (int)len;
+	counts[2] += (kind == EMPTY);
+
+	/* stop after the fourth field */
+	return counts[0] == 4;
+
+}
+
+static void 
+count_row(void *sink)
+{
+
+	((int *)sink)[3]++;
+
+}
+
+static int
+test_callbacks()
+{
+
+	struct csvn_iter it;
+	struct csv_t tok;
+	struct csv_p parser;
+	int counts[4] = {0, 0, 0, 0};
+	int parsed, res;
+
+	char *test_text = "ab,c,,\"de\"\n\nf,gh";
+
+	/* no token pool at all, the parser stops when asked to and goes on */
+	csvn_init(&parser);
+	parser.on_field = count_field;
+	parser.on_row_end = count_row;
+	parser.sink = counts;
+
+	parsed = csvn_parse(test_text, strlen(test_text), &parser, NULL, 0);
+	check(parsed == 4 && counts[0] == 4 && counts[2] == 1 && counts[3] == 0);
+
+	parsed = csvn_parse(test_text, strlen(test_text), &parser, NULL, 0);
+	printf("Got %d fields of %d characters in %d rows\n", counts[0], counts[1], counts[3]);
+	check(parsed == 2 && counts[0] == 6 && counts[1] == 8 && counts[3] == 2);
+	check(parser.toknext == 0 && parser.tokens == NULL);
+
+	/* the iterator pulls one field at a time into the same token */
+	csvn_iter_init(&it, test_text, strlen(test_text));
+	parsed = 0;
+
+	while ((res = csvn_next_field(&it, &tok)) > 0) {
+
+		if (parsed == 3) {
+			check(CSVN_TOK_KIND(tok) == DQUOTE && CSVN_TOK_START(tok) == 7 && it.row == 0);
+		}
+		if (parsed == 5) {
+			check(CSVN_TOK_START(tok) == 14 && CSVN_TOK_SIZE(tok) == 1 && it.row == 1);
+		}
+		parsed++;
+
+	}
+	check(res == 0 && parsed == 6 && it.row == 2);
+
+	done();
+
+}
+
+static int
+test_header()
+{
+
+	struct csv_t tokens[4];
+	struct csv_p parser;
+	struct csvn_dialect loose;
+	struct csvn_hdr hdr;
+	unsigned char projection;
+	int grown = 0;
+	int parsed, col;
+
+	char *test_text = ",\"a\"\"b\",id,id\n1,2,3,4\n5,6,7,8";
+
+	csvn_init(&parser);
+	parser.grow = grow_tokens;
+	parser.ctx = &grown;
+	csvn_header_init(&hdr);
+
+	/* the empty first column has a name of its own, the parser is left at the second row */
+	check(csvn_parse_header(test_text, strlen(test_text), &parser, &hdr) == 4);
+	check(parser.pos == 14 && parser.line == 2 && parser.toknext == 0);
+
+	check(csvn_column_index(&hdr, "", 0) == 0);
+	check(csvn_column_index(&hdr, "a\"b", 3) == 1);
+	check(csvn_column_index(&hdr, "id", 2) == 2);
+	check(csvn_column_index(&hdr, "i", 1) == -1);
+
+	/* the columns looked up by name make the projection */
+	col = csvn_column_index(&hdr, "id", 2);
+	projection = (unsigned char)(1 << col);
+	parser.projection = &projection;
+	parser.num_proj = hdr.num_col;
+
+	parsed = csvn_parse(test_text, strlen(test_text), &parser, tokens, 4);
+	printf("Parsed %d fields of column %d\n", parsed, col);
+	check(parsed == 2);
+	check(CSVN_TOK_START(tokens[0]) == 18 && CSVN_TOK_START(tokens[1]) == 26);
+
+	/* only quoted names are unescaped */
+	csvn_dialect_init(&loose);
+	loose.flags &= ~CSVN_DIALECT_STRICT;
+	csvn_init(&parser);
+	parser.grow = grow_tokens;
+	parser.ctx = &grown;
+	parser.dialect = &loose;
+	check(csvn_parse_header("a\"\"b,\"c\"\"d\"\n", 12, &parser, &hdr) == 2);
+	check(csvn_column_index(&hdr, "a\"\"b", 4) == 0);
+	check(csvn_column_index(&hdr, "c\"d", 3) == 1);
+
+	free(hdr.names);
+	free(hdr.ends);
+	free(hdr.slots);
+
+	done();
+
+}
+
+static int
+test_sidecar()
+{
+
+	struct csv_t tokens[32];
+	struct csv_p parser;
+	int grown = 0;
+	int parsed, row;
+
+	char *path = "csvn_test.marks";
+	char *test_text = "r0,a\nr1,b\n\nr2,\"x\ny\"\nr3,d\nr4,e\nr5,f\nr6,g\nr7,h\nr8,i\nr9,j";
+
+	/* the blank line is not a row, the quoted newline does not end one */
+	csvn_init(&parser);
+	parser.grow = grow_tokens;
+	parser.ctx = &grown;
+	parser.every = 3;
+
+	parsed = csvn_parse(test_text, strlen(test_text), &parser, tokens, 32);
+	printf("Parsed %d fields into %d marks\n", parsed, parser.marknext);
+	check(parsed == 20 && parser.rowcount == 9 && parser.marknext == 3);
+	check(parser.marks[0].offset == 20 && parser.marks[0].line == 6);
+	check(parser.marks[2].line == 12);
+	check(csvn_save_marks(path, test_text, strlen(test_text), &parser) == 0);
+	free(parser.marks);
+
+	/* a later parser starts right at the mark before the row */
+	csvn_init(&parser);
+	parser.grow = grow_tokens;
+	parser.ctx = &grown;
+	check(csvn_load_marks(path, test_text, strlen(test_text), &parser) == 3);
+	check(parser.every == 3);
+
+	row = csvn_seek_row(test_text, strlen(test_text), &parser, 7);
+	check(row == 6 && parser.pos == 35 && parser.line == 9);
+
+	parsed = csvn_parse(test_text, strlen(test_text), &parser, tokens, 32);
+	check(parsed == 8 && CSVN_TOK_START(tokens[0]) == 35 && on_line(tokens[0], 9));
+	check(parser.marknext == 3 && parser.rowcount == 9);
+
+	/* seeking again starts over from the mark, with no tokens left from before */
+	row = csvn_seek_row(test_text, strlen(test_text), &parser, 4);
+	check(row == 3 && parser.pos == 20 && parser.toknext == 0);
+	parsed = csvn_parse(test_text, strlen(test_text), &parser, tokens, 32);
+	check(parsed == 14 && CSVN_TOK_START(tokens[0]) == 20 && on_line(tokens[0], 6));
+
+	/* the marks count the discarded characters, which can not be gone back to */
+	csvn_seek_row(test_text, strlen(test_text), &parser, 3);
+	csvn_discard(&parser, 20);
+	row = csvn_seek_row(test_text + 20, strlen(test_text) - 20, &parser, 7);
+	check(row == 6 && parser.pos == 15 && parser.line == 9);
+	row = csvn_seek_row(test_text + 20, strlen(test_text) - 20, &parser, 3);
+	check(row == 3 && parser.pos == 0);
+	check(csvn_seek_row(test_text + 20, strlen(test_text) - 20, &parser, 2) == DISCARDED);
+	free(parser.marks);
+
+	/* the marks of another text are refused */
+	csvn_init(&parser);
+	parser.grow = grow_tokens;
+	parser.ctx = &grown;
+	check(csvn_load_marks(path, "r0,a\nr1,b", 10, &parser) == IO_ERROR);
+	check(parser.marknext == 0);
+	free(parser.marks);
+
+	/* the row count is an int */
+	csvn_init(&parser);
+	parser.every = 1;
+	parser.rowcount = 0x7ffffffe;
+	check(csvn_parse("a\nb\nc", 5, &parser, tokens, 32) == OUT_OF_RANGE);
+	check(parser.rowcount == 0x7fffffff);
+
+	remove(path);
+
+	done();
+
+}
+
+static int
+test_stats()
+{
+
+	struct csv_t tokens[2];
+	struct csv_p parser;
+	struct csvn_stats stats;
+	int grown = 0;
+
+	char *test_text = "a,\"b\"\"c\",,\"x\ny\"\nd";
+
+	csvn_init(&parser);
+	parser.grow = grow_tokens;
+	parser.ctx = &grown;
+	parser.stats = &stats;
+	csvn_stats_init(&stats);
+
+	check(csvn_parse(test_text, strlen(test_text), &parser, NULL, 0) == 5);
+	printf("Counted %lu quoted, %lu unquoted and %lu empty fields\n", 
+	       (unsigned long)stats.fields[DQUOTE], (unsigned long)stats.fields[TEXT], 
+	       (unsigned long)stats.fields[EMPTY]);
+	check(stats.fields[DQUOTE] == 2 && stats.fields[TEXT] == 2 && stats.fields[EMPTY] == 1);
+	check(stats.escapes == 1 && stats.multiline == 1);
+	check(stats.bytes == strlen(test_text) && stats.calls == 1);
+	check(stats.grown == 1 && stats.exhausted == 0);
+	free(parser.tokens);
+
+	/* a pool which can not grow runs out */
+	csvn_init(&parser);
+	parser.stats = &stats;
+	csvn_stats_init(&stats);
+
+	check(csvn_parse(test_text, strlen(test_text), &parser, tokens, 2) == NOT_ENOUGH_MEM);
+	check(stats.exhausted == 1 && stats.fields[TEXT] + stats.fields[DQUOTE] == 2);
+
+	done();
+
+}
+
+static int
+test_infer()
+{
+
+	struct csvn_col schema[6];
+	struct csv_p parser;
+	struct csvn_hdr hdr;
+	int grown = 0;
+
+	char *path = "csvn_test.marks";
+	char *test_text = "id,price,ok,day,name\n"
+			  "1,2,TRUE,2024-01-31,x\n"
+			  "-2,,false,2024-02-01T10:00:00Z,\"y\"\n"
+			  "3,4.5,true,2024-02-02,7\n"
+			  "12345678901234567890,5,no,2024-02-03,z\n";
+
+	csvn_init(&parser);
+	parser.grow = grow_tokens;
+	parser.ctx = &grown;
+	csvn_header_init(&hdr);
+	check(csvn_parse_header(test_text, strlen(test_text), &parser, &hdr) == 5);
+
+	/* the first rows only, the empty price fits any type */
+	check(csvn_infer_schema(test_text, strlen(test_text), &parser, 2, schema, 6) == 5);
+	check(schema[0].type == CSVN_COL_I64 && schema[1].type == CSVN_COL_I64);
+	check(schema[2].type == CSVN_COL_BOOL && schema[3].type == CSVN_COL_TIME);
+	check(schema[4].type == CSVN_COL_SPAN && schema[5].type == CSVN_COL_SPAN);
+	check(schema[0].values == NULL && schema[0].valid == NULL);
+
+	/* every row: integers within floats and too long ones become floats */
+	check(csvn_infer_schema(test_text, strlen(test_text), &parser, 0, schema, 5) == 5);
+	check(schema[0].type == CSVN_COL_F64 && schema[1].type == CSVN_COL_F64);
+	check(schema[2].type == CSVN_COL_SPAN && schema[3].type == CSVN_COL_TIME);
+	check(schema[4].type == CSVN_COL_SPAN);
+	check(parser.pos == 21 && parser.line == 2);
+
+	/* the guess is the schema of the columns */
+	check(csvn_infer_schema(test_text, strlen(test_text), &parser, 3, schema, 4) == 5);
+	check(schema[0].type == CSVN_COL_I64 && schema[1].type == CSVN_COL_F64);
+	parser.columns = schema;
+	parser.num_col = 3;
+	check(csvn_parse(test_text, 102, &parser, NULL, 0) == 15 && parser.colnext == 3);
+	check(schema[2].valid[0] == 0x7 && ((int64_t *)schema[2].values)[2] == 1);
+	check(((int64_t *)schema[0].values)[1] == -2 && ((double *)schema[1].values)[2] == 4.5);
+
+	free(schema[0].values);
+	free(schema[1].values);
+	free(schema[2].values);
+	free(schema[0].valid);
+	free(schema[1].valid);
+	free(schema[2].valid);
+
+	/* with marks, the sample is spread over the whole text */
+	csvn_init(&parser);
+	parser.grow = grow_tokens;
+	parser.ctx = &grown;
+	parser.every = 2;
+	check(csvn_parse(test_text, strlen(test_text), &parser, NULL, 0) == 25);
+	check(parser.marknext == 2);
+	check(csvn_save_marks(path, test_text, strlen(test_text), &parser) == 0);
+	free(parser.tokens);
+	free(parser.marks);
+
+	csvn_init(&parser);
+	parser.grow = grow_tokens;
+	parser.ctx = &grown;
+	check(csvn_load_marks(path, test_text, strlen(test_text), &parser) == 2);
+	check(csvn_parse_header(test_text, strlen(test_text), &parser, &hdr) == 5);
+	check(csvn_infer_schema(test_text, strlen(test_text), &parser, 3, schema, 1) == 5);
+	check(schema[0].type == CSVN_COL_F64);
+
+	/* fewer rows than marks take every few marks: the first row alone, then the last mark too */
+	check(csvn_infer_schema(test_text, strlen(test_text), &parser, 1, schema, 1) == 5);
+	check(schema[0].type == CSVN_COL_I64);
+	check(csvn_infer_schema(test_text, strlen(test_text), &parser, 2, schema, 1) == 5);
+	check(schema[0].type == CSVN_COL_F64);
+	free(parser.marks);
+	remove(path);
+
+	free(hdr.names);
+	free(hdr.ends);
+	free(hdr.slots);
+
+	done();
+
+}
+
+int 
+main(int argc, char **argv) 
+{
+
+	if (argc < 2) {
+
+		test(test_normal, "parsing of normal line");
+		test(test_quoted, "parsing of quoted lines");
+		test(test_newlines, "parsing of newlines");
+		test(test_long_fields, "parsing of long fields");
+		test(test_index, "two-stage parsing");
+		test(test_validate, "validation of rows");
+		test(test_stream, "streamed parsing");
+		test(test_parallel, "parallel parsing");
+		test(test_grow, "growing of token pool");
+		test(test_rows, "row index");
+		test(test_mmap, "parsing of mapped file");
+		test(test_dialect, "parsing of runtime dialects");
+		test(test_crlf, "parsing of CRLF rows");
+		test(test_unescape, "unescaping of quoted fields");
+		test(test_convert, "conversion of fields");
+		test(test_columns, "columnar parsing");
+		test(test_projection, "projection of columns");
+		test(test_filter, "filtering of rows");
+		test(test_callbacks, "callbacks and iterator");
+		test(test_header, "header row lookup");
+		test(test_sidecar, "sidecar row index");
+		test(test_stats, "parser statistics");
+		test(test_pipeline, "pipelined reading");
+		test(test_decoder, "decompression of streams");
+		test(test_batch, "batch parsing");
+		test(test_arena, "arena allocation");
+		test(test_infer, "schema inference");
+
+		printf("\nPassed %d, failed %d tests\n", passed_tests, failed_tests);
+		return failed_tests != 0;
+
+	}
+
 	printf("Parsing whole file:\n\n");
 	struct csv_t tokens[1000];
 	struct csv_p parser;
+	int i;
 	csvn_init(&parser);
 	
-	char *text = strdup(argv[1]);
+	char *text = malloc(strlen(argv[1]) + 1);
+	strcpy(text, argv[1]);
 
 	printf("Got input %s\n", text);
 
 	int parsed = csvn_parse(text, strlen(text), &parser, tokens, 10);
 	printf("Parsed %d tokens from the file.", parsed);
 
-	for (int i = 0; i < parsed; i++) {
+	for (i = 0; i < parsed; i++) {
 		
 		char *parsed = get_parsed(&tokens[i], text);
-		printf("Parsed token: %s (start: %d, end: %d, line: %d)\n", parsed, tokens[i].start, tokens[i].end, tokens[i].line);
+		printf("Parsed token: %s (start: %ld, end: %ld, line: %d)\n", parsed, 
+		       (long)CSVN_TOK_START(tokens[i]), (long)CSVN_TOK_END(tokens[i]), token_line(tokens[i]));
 		free(parsed);
 
 	}
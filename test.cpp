@@ -0,0 +1,374 @@
+#include <cstdio>
+#include <cstring>
+#include <string_view>
+#include <utility>
+#include <unistd.h>
+
+#define CSVN_PIPELINE
+#include "csvn.hpp"
+
+#ifdef CSVN_COROUTINES
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#endif
+
+#define fail() return __LINE__
+
+#define check(cond) 			\
+	do {				\
+		if (!(cond)) {		\
+			fail();		\
+		}			\
+	} while (0)
+
+static int passed_tests = 0;
+static int failed_tests = 0;
+
+static int test_fields();
+static int test_ranges();
+static int test_getters();
+static int test_dialects();
+static int test_move();
+static int test_pipeline();
+#ifdef CSVN_COROUTINES
+static int test_coroutine();
+#endif
+
+static void
+test(int (*testf)(), const char *msg)
+{
+
+	int res;
+	res = testf();
+
+	if (res == 0) {
+		passed_tests++;
+	} else {
+		failed_tests++;
+		std::printf("Failed test %s at line %d\n", msg, res);
+	}
+
+}
+
+static int
+test_fields()
+{
+
+	std::string_view text = "ab,\"c,\"\"d\"\"\",,e\nx\n";
+	csvn::csv parser(text);
+	csvn::field f;
+
+	check(parser.next(f));
+	check(f.text == "ab" && f.kind == TEXT && f.line == 1);
+	check(f.text.data() == text.data());
+
+	check(parser.next(f));
+	check(f.text == "c,\"\"d\"\"" && f.kind == DQUOTE && f.escaped);
+
+	check(parser.next(f));
+	check(f.empty() && f.kind == EMPTY);
+	check(f.text.data() == text.data() + 13);
+
+	check(parser.next(f));
+	check(f.text == "e");
+
+	check(parser.row_index() == 1);
+	check(parser.next(f));
+	check(f.text == "x" && f.line == 2);
+
+	check(!parser.next(f));
+	check(parser.done() && parser.error() == 0);
+
+	/* a field is on the line it starts in, in either token layout */
+	csvn::csv multiline("\"x\ny\",z\nq\n");
+	check(multiline.next(f) && f.text == "x\ny" && f.line == 1);
+	check(multiline.next(f) && f.text == "z" && f.line == 2);
+	check(multiline.next(f) && f.text == "q" && f.line == 3);
+
+	csvn::parser<',', '\"', false, CSVN_DIALECT_STRICT> broken("a\"b\n");
+	while (broken.next(f));
+	check(broken.error() == INVALID_CHARACTER);
+
+	return 0;
+
+}
+
+static int
+test_ranges()
+{
+
+	csvn::csv parser("a,b,c\nd\ne,f\n");
+	int fields[3] = {0, 0, 0};
+	int rows = 0;
+
+	for (auto row : parser) {
+		check(row.index() == rows);
+		for (const csvn::field &f : row) {
+			check(f.line == rows + 1);
+			fields[rows]++;
+		}
+		rows++;
+	}
+
+	check(rows == 3);
+	check(fields[0] == 3 && fields[1] == 1 && fields[2] == 2);
+
+	/* the fields left unread are skipped with their row */
+	csvn::csv skipped("a,b,c\nd,e\n");
+	rows = 0;
+
+	for (auto row : skipped) {
+		auto it = row.begin();
+		check(it != row.end());
+		check(it->text == ((rows == 0) ? "a" : "d"));
+		rows++;
+	}
+
+	check(rows == 2);
+
+	return 0;
+
+}
+
+static int
+test_getters()
+{
+
+	csvn::csv parser("42,-7,2.5,1e400,12ab,,0\n");
+	csvn::field f;
+	long i = 0;
+	double d = 0;
+
+	check(parser.next(f) && f.get(i) == std::errc() && i == 42);
+	check(parser.next(f) && f.as<int>() == -7);
+	check(parser.next(f) && f.get(d) == std::errc() && d == 2.5);
+	check(parser.next(f) && f.get(d) == std::errc::result_out_of_range);
+	check(parser.next(f) && f.get(i) == std::errc::invalid_argument);
+	check(f.as<int>(-1) == -1);
+	check(parser.next(f) && f.get(i) == std::errc::invalid_argument);
+
+	return 0;
+
+}
+
+static int
+test_dialects()
+{
+
+	csvn::parser<';', '\''> ssv("'a;b';c\n");
+	csvn::parser<'\t', '\"', true> tsv("x\ty\r\nz\r\n");
+	csvn::field f;
+
+	check(ssv.dialect.delim == ';' && ssv.dialect.quote == '\'');
+	check(ssv.next(f) && f.text == "a;b" && f.kind == DQUOTE);
+	check(ssv.next(f) && f.text == "c");
+	check(!ssv.next(f) && ssv.error() == 0);
+
+	check(tsv.dialect.flags & CSVN_DIALECT_CRLF);
+	check(tsv.next(f) && f.text == "x");
+	check(tsv.next(f) && f.text == "y");
+	check(tsv.next(f) && f.text == "z" && f.line == 2);
+	check(!tsv.next(f) && tsv.error() == 0);
+
+	return 0;
+
+}
+
+static int
+test_move()
+{
+
+	csvn::csv first("a,b\nc\n");
+	csvn::field f;
+
+	check(first.next(f) && f.text == "a");
+
+	csvn::csv second(std::move(first));
+	check(second.next(f) && f.text == "b");
+
+	csvn::csv third("");
+	check(!third.next(f));
+	third = std::move(second);
+	check(third.next(f) && f.text == "c" && third.row_index() == 1);
+	check(!third.next(f) && third.error() == 0);
+
+	return 0;
+
+}
+
+/* fills a pipe with rows of 3 fields, returning its read end */
+static int
+fill_pipe(int rows)
+{
+
+	int fds[2], i;
+
+	if (pipe(fds) != 0) {
+		return -1;
+	}
+
+	for (i = 0; i < rows; i++) {
+		if (write(fds[1], "12,\"a,b\",xyz\n", 13) != 13) {
+			return -1;
+		}
+	}
+	close(fds[1]);
+
+	return fds[0];
+
+}
+
+static int
+test_pipeline()
+{
+
+	char buffer[3 * 64];
+	struct csv_t tokens[64];
+	struct csv_p parser;
+	int fd = fill_pipe(100), fields = 0, res, i;
+	long sum = 0;
+
+	check(fd >= 0);
+	csvn_init(&parser);
+
+	{
+		csvn::pipeline pl(fd, buffer, sizeof(buffer));
+
+		check(pl.error() == 0);
+		while ((res = pl.next(parser)) > 0) {
+
+			std::string_view text = pl.window();
+			int parsed = csvn_parse_stream(text.data(), text.size(), &parser,
+						       tokens, 64, pl.last());
+
+			check(parsed >= 0);
+			for (i = 0; i < parsed; i++) {
+				if (CSVN_TOK_START(tokens[i]) < (int)text.size() && text[CSVN_TOK_START(tokens[i])] == '1') {
+					sum += 12;
+				}
+			}
+			fields += parsed;
+
+		}
+
+		check(res == 0 && pl.error() == 0);
+	}
+
+	check(fields == 300 && sum == 1200);
+	close(fd);
+
+	csvn::pipeline none(0, buffer, sizeof(buffer), 1);
+	check(none.error() == OUT_OF_RANGE && none.next(parser) == OUT_OF_RANGE);
+
+	return 0;
+
+}
+
+#ifdef CSVN_COROUTINES
+struct task {
+
+	struct promise_type {
+
+		task get_return_object() { return task(); }
+
+		std::suspend_never initial_suspend() noexcept { return {}; }
+
+		std::suspend_never final_suspend() noexcept { return {}; }
+
+		void return_void() {}
+
+		void unhandled_exception() {}
+
+	};
+
+};
+
+/* coroutines handed over by the reading thread, resumed by the test */
+struct loop {
+
+	std::mutex lock;
+
+	std::condition_variable cond;
+
+	std::deque<std::coroutine_handle<> > queue;
+
+	void post(std::coroutine_handle<> handle)
+	{
+
+		std::lock_guard<std::mutex> guard(lock);
+		queue.push_back(handle);
+		cond.notify_one();
+
+	}
+
+};
+
+static task
+ingest(csvn::pipeline &pl, struct csv_p &parser, loop &ev, int &fields, int &res)
+{
+
+	struct csv_t tokens[64];
+
+	while ((res = co_await pl.next_async(parser, [&ev](std::coroutine_handle<> h) { ev.post(h); })) > 0) {
+		fields += csvn_parse_stream(pl.window().data(), pl.window().size(), &parser,
+					    tokens, 64, pl.last());
+	}
+
+}
+
+static int
+test_coroutine()
+{
+
+	char buffer[2 * 64];
+	struct csv_p parser;
+	int fd = fill_pipe(1000), fields = 0, res = 1;
+	loop ev;
+
+	check(fd >= 0);
+	csvn_init(&parser);
+
+	{
+		csvn::pipeline pl(fd, buffer, sizeof(buffer), 2);
+
+		ingest(pl, parser, ev, fields, res);
+		while (res > 0) {
+
+			std::unique_lock<std::mutex> guard(ev.lock);
+			ev.cond.wait(guard, [&ev] { return !ev.queue.empty(); });
+			std::coroutine_handle<> handle = ev.queue.front();
+			ev.queue.pop_front();
+			guard.unlock();
+
+			handle.resume();
+
+		}
+	}
+
+	check(res == 0 && fields == 3000);
+	close(fd);
+
+	return 0;
+
+}
+#endif
+
+int
+main()
+{
+
+	test(test_fields, "string_view fields");
+	test(test_ranges, "row and field ranges");
+	test(test_getters, "typed getters");
+	test(test_dialects, "compile-time dialects");
+	test(test_move, "moving of parsers");
+	test(test_pipeline, "pipelined reading");
+#ifdef CSVN_COROUTINES
+	test(test_coroutine, "awaiting of windows");
+#endif
+
+	std::printf("\nPassed %d, failed %d tests\n", passed_tests, failed_tests);
+	return failed_tests != 0;
+
+}